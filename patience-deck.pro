@@ -1,5 +1,7 @@
 TEMPLATE = subdirs
-SUBDIRS = src translations data
+SUBDIRS = engine src translations data
+engine.subdir = src/engine
+src.depends = engine
 TARGET=$$(NAME)
 
 CONFIG += sailfishapp
@@ -38,4 +38,6 @@ Q_LOGGING_CATEGORY(lcMouse, "site.tomin.patience.mouse", QtWarningMsg);
 Q_LOGGING_CATEGORY(lcEngine, "site.tomin.patience.engine", QtWarningMsg);
 Q_LOGGING_CATEGORY(lcRecorder, "site.tomin.patience.engine.recorder", QtWarningMsg);
 Q_LOGGING_CATEGORY(lcOptions, "site.tomin.patience.engine.options", QtWarningMsg);
+Q_LOGGING_CATEGORY(lcJournal, "site.tomin.patience.engine.journal", QtWarningMsg);
 Q_LOGGING_CATEGORY(lcScheme, "site.tomin.patience.scheme", QtWarningMsg);
+Q_LOGGING_CATEGORY(lcSchemeAlloc, "site.tomin.patience.scheme.allocations", QtWarningMsg);
@@ -40,6 +40,8 @@ Q_DECLARE_LOGGING_CATEGORY(lcMouse);
 Q_DECLARE_LOGGING_CATEGORY(lcEngine);
 Q_DECLARE_LOGGING_CATEGORY(lcRecorder);
 Q_DECLARE_LOGGING_CATEGORY(lcOptions);
+Q_DECLARE_LOGGING_CATEGORY(lcJournal);
 Q_DECLARE_LOGGING_CATEGORY(lcScheme);
+Q_DECLARE_LOGGING_CATEGORY(lcSchemeAlloc);
 
 #endif // LOGGING_H
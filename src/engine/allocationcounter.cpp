@@ -0,0 +1,121 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtGlobal>
+
+#ifndef QT_NO_DEBUG
+
+#include <cstdlib>
+#include <new>
+#include "allocationcounter.h"
+#include "logging.h"
+
+namespace {
+
+thread_local size_t s_allocations = 0;
+thread_local int s_depth = 0;
+
+void *allocate(size_t size)
+{
+    if (s_depth > 0)
+        s_allocations++;
+    return malloc(size ? size : 1);
+}
+
+} // namespace
+
+// Replacements for the global allocation functions, these see every
+// allocation made with new in the process but count only inside scopes
+void *operator new(size_t size)
+{
+    void *ptr = allocate(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new[](size_t size)
+{
+    void *ptr = allocate(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+    free(ptr);
+}
+
+AllocationCounter::Scope::Scope(const char *name)
+    : m_name(name)
+    , m_start(s_allocations)
+{
+    s_depth++;
+}
+
+AllocationCounter::Scope::~Scope()
+{
+    size_t allocations = s_allocations - m_start;
+    int depth = s_depth;
+    s_depth = 0; // Don't count logging
+    if (allocations > 0)
+        qCDebug(lcSchemeAlloc) << m_name << "allocated" << allocations << "times";
+    s_depth = depth - 1;
+}
+
+size_t AllocationCounter::count()
+{
+    return s_allocations;
+}
+
+#endif // QT_NO_DEBUG
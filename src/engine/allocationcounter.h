@@ -0,0 +1,57 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <cstddef>
+#include <QtGlobal>
+
+/*
+ * Counts operator new calls on the current thread while a Scope is alive
+ * and logs them to site.tomin.patience.scheme.allocations when the scope
+ * ends. Debug builds only, in release builds Scope does nothing.
+ */
+namespace AllocationCounter {
+
+#ifdef QT_NO_DEBUG
+class Scope
+{
+public:
+    explicit Scope(const char *name) { Q_UNUSED(name) }
+};
+#else
+class Scope
+{
+public:
+    explicit Scope(const char *name);
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    const char *m_name;
+    size_t m_start;
+};
+
+size_t count();
+#endif // QT_NO_DEBUG
+
+} // AllocationCounter
+
+#endif // ALLOCATIONCOUNTER_H
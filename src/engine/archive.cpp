@@ -0,0 +1,183 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QList>
+#include "archive.h"
+#include "logging.h"
+
+namespace {
+const QByteArray Header = QByteArrayLiteral("# patience-deck archive 1\n");
+const QByteArray Unescaped = QByteArrayLiteral("/;:+=,");
+const int FieldCount = 6;
+
+const QList<QByteArray> ResultNames = {
+    QByteArrayLiteral("unfinished"),
+    QByteArrayLiteral("won"),
+    QByteArrayLiteral("lost"),
+};
+
+QByteArray encode(const QString &value)
+{
+    return value.toUtf8().toPercentEncoding(Unescaped);
+}
+
+QString decode(const QByteArray &value)
+{
+    return QString::fromUtf8(QByteArray::fromPercentEncoding(value));
+}
+} // namespace
+
+ArchiveEntry::ArchiveEntry()
+    : seed(0)
+    , time(0)
+    , result(Unfinished)
+{
+}
+
+QStringList ArchiveEntry::arguments() const
+{
+    QStringList arguments = {
+        QStringLiteral("--game"), gameFile,
+        QStringLiteral("--seed"), QString::number(seed),
+        QStringLiteral("--time"), QString::number(time),
+    };
+    if (!moves.isEmpty())
+        arguments << QStringLiteral("--moves") << moves;
+    if (!options.isEmpty())
+        arguments << QStringLiteral("--options") << options;
+    return arguments;
+}
+
+QByteArray ArchiveEntry::toLine() const
+{
+    QByteArray line;
+    line.append(encode(gameFile));
+    line.append('\t');
+    line.append(QByteArray::number(seed));
+    line.append('\t');
+    line.append(encode(options));
+    line.append('\t');
+    line.append(QByteArray::number(time));
+    line.append('\t');
+    line.append(ResultNames.at(result));
+    line.append('\t');
+    line.append(encode(moves));
+    line.append('\n');
+    return line;
+}
+
+bool ArchiveEntry::fromLine(const QByteArray &line, ArchiveEntry &entry)
+{
+    QList<QByteArray> fields = line.split('\t');
+    if (fields.count() != FieldCount)
+        return false;
+
+    bool seedOk = false;
+    bool timeOk = false;
+    int result = ResultNames.indexOf(fields.at(4));
+    entry.gameFile = decode(fields.at(0));
+    entry.seed = fields.at(1).toUInt(&seedOk);
+    entry.options = decode(fields.at(2));
+    entry.time = fields.at(3).toLongLong(&timeOk);
+    entry.result = static_cast<Result>(result);
+    entry.moves = decode(fields.at(5));
+    return seedOk && timeOk && result >= 0 && !entry.gameFile.isEmpty();
+}
+
+ArchiveReader::ArchiveReader(const QString &path, qint64 begin, qint64 end)
+    : m_file(path)
+    , m_end(end)
+    , m_position(-1)
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qCWarning(lcRecorder) << "Can not open archive" << path << m_file.errorString();
+        return;
+    }
+    if (m_end < 0 || m_end > m_file.size())
+        m_end = m_file.size();
+    if (begin > 0) {
+        // A game that starts before begin belongs to the previous split
+        m_file.seek(begin - 1);
+        m_file.readLine();
+    }
+}
+
+bool ArchiveReader::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+// Reads the next game that starts before the end of the split
+bool ArchiveReader::next(ArchiveEntry &entry)
+{
+    while (m_file.isOpen() && m_file.pos() < m_end) {
+        qint64 position = m_file.pos();
+        QByteArray line = m_file.readLine();
+        if (!line.endsWith('\n')) {
+            qCWarning(lcRecorder) << "Incomplete game at" << position << "in" << m_file.fileName();
+            return false;
+        }
+        line.chop(1);
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+        if (!ArchiveEntry::fromLine(line, entry)) {
+            qCWarning(lcRecorder) << "Invalid game at" << position << "in" << m_file.fileName();
+            continue;
+        }
+        m_position = position;
+        return true;
+    }
+    return false;
+}
+
+// Offset of the game that was read last, identifies it within the archive
+qint64 ArchiveReader::position() const
+{
+    return m_position;
+}
+
+qint64 ArchiveReader::size() const
+{
+    return m_file.size();
+}
+
+ArchiveWriter::ArchiveWriter(const QString &path)
+    : m_file(path)
+{
+    // Unbuffered so that every game is appended with a single write
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) {
+        qCWarning(lcRecorder) << "Can not open archive" << path << m_file.errorString();
+        return;
+    }
+    if (m_file.size() == 0)
+        m_file.write(Header);
+}
+
+bool ArchiveWriter::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+bool ArchiveWriter::write(const ArchiveEntry &entry)
+{
+    QByteArray line = entry.toLine();
+    if (m_file.write(line) != line.size()) {
+        qCWarning(lcRecorder) << "Can not write to archive" << m_file.fileName() << m_file.errorString();
+        return false;
+    }
+    return true;
+}
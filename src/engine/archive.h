@@ -0,0 +1,86 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <QFile>
+#include <QString>
+#include <QStringList>
+
+/*
+ * Archive of played games for offline analysis.
+ *
+ * An archive is a text file with one game per line: game file, seed,
+ * options, elapsed time, result and moves separated by tabs. Moves are in
+ * the same form as --moves takes them. Lines starting with '#' are comments.
+ * Games are only ever appended, and an archive can be split at any byte
+ * offset since every reader starts from the next full line.
+ */
+class ArchiveEntry
+{
+public:
+    enum Result {
+        Unfinished,
+        Won,
+        Lost,
+    };
+
+    QString gameFile;
+    quint32 seed;
+    QString options;
+    qint64 time;
+    Result result;
+    QString moves;
+
+    ArchiveEntry();
+
+    QStringList arguments() const;
+
+    QByteArray toLine() const;
+    static bool fromLine(const QByteArray &line, ArchiveEntry &entry);
+};
+
+class ArchiveReader
+{
+public:
+    explicit ArchiveReader(const QString &path, qint64 begin = 0, qint64 end = -1);
+
+    bool isOpen() const;
+    bool next(ArchiveEntry &entry);
+    qint64 position() const;
+    qint64 size() const;
+
+private:
+    QFile m_file;
+    qint64 m_end;
+    qint64 m_position;
+};
+
+class ArchiveWriter
+{
+public:
+    explicit ArchiveWriter(const QString &path);
+
+    bool isOpen() const;
+    bool write(const ArchiveEntry &entry);
+
+private:
+    QFile m_file;
+};
+
+#endif // ARCHIVE_H
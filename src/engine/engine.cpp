@@ -15,14 +15,19 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <sstream>
 #include <QCommandLineParser>
 #include <QDebug>
 #include "constants.h"
 #include "engine.h"
 #include "engineinternals.h"
-#include "gameoptionmodel.h"
 #include "interface.h"
+#include "journalstorage.h"
 #include "logging.h"
+#include "statistics.h"
+#include "storage.h"
+#include "trace.h"
 
 namespace {
 const int MaxRetries = 10;
@@ -30,6 +35,15 @@ const int DelayedCallDelayDefault = 50;
 const int DelayedCallDelayOnReplay = 0;
 const QString DelayConf = QStringLiteral("/delayedCallDelay");
 const CardData none = CardData();
+
+// Variable of api.scm that holds undo history or the move being recorded
+SCM apiVariable(const char *name)
+{
+    SCM variable = scm_module_local_variable(scm_c_resolve_module("aisleriot api"), scm_from_utf8_symbol(name));
+    if (scm_is_false(variable))
+        qCCritical(lcEngine) << "No" << name << "in api";
+    return variable;
+}
 } // namespace
 const QString Constants::GameDirectory = QStringLiteral(QUOTE(DATADIR) "/games");
 
@@ -101,10 +115,15 @@ EngineInternals::EngineInternals(Engine *engine)
     : QObject(engine)
     , m_delayedCallTimer(nullptr)
     , m_delayedCallDelay(DelayedCallDelayDefault)
+    , m_slotCache(SCM_BOOL_F)
+    , m_slotConversions(0)
     , m_features(NoFeatures)
     , m_state(UninitializedState)
     , m_timeout(0)
+    , m_score(-1)
     , m_seed(std::mt19937::default_seed)
+    , m_snapshot(std::make_shared<const TableSnapshot>())
+    , m_generation(0)
     , m_recordingMove(false)
     , m_recorder(engine)
     , m_makeFirstMove(false)
@@ -141,9 +160,7 @@ Engine::Engine(QObject *parent)
     : QObject(parent)
     , d_ptr(new EngineInternals(this))
     , m_action(0)
-#ifndef ENGINE_EXERCISER
-    , m_delayConf(Constants::ConfPath + DelayConf)
-#endif // ENGINE_EXERCISER
+    , m_storage(nullptr)
 {
     qRegisterMetaType<CardData>();
     qRegisterMetaType<CardList>();
@@ -158,13 +175,75 @@ Engine::Engine(QObject *parent)
             d_ptr, &EngineInternals::handleReplayGame, Qt::DirectConnection);
     connect(&d_ptr->m_recorder, &Recorder::replayCompleted,
             d_ptr, &EngineInternals::handleReplayCompleted, Qt::DirectConnection);
-#ifndef ENGINE_EXERCISER
-    connect(&m_delayConf, &MGConfItem::valueChanged, this, [&]() {
-        d_ptr->m_delayedCallDelay = readDelayedCallDelay();
+    connect(this, &Engine::action, this, [](ActionTypeFlags action, int slotId, int index) {
+        Trace::record(Trace::SignalEmitted, Trace::ActionSignal, static_cast<int>(action), slotId, index);
+    }, Qt::DirectConnection);
+    connect(this, &Engine::moveEnded, this, [this] {
+        Trace::record(Trace::SignalEmitted, Trace::MoveEndedSignal);
+        d_ptr->publishSnapshot();
+    }, Qt::DirectConnection);
+    connect(this, &Engine::gameLoaded, this, [] {
+        Trace::record(Trace::SignalEmitted, Trace::GameLoadedSignal);
+    }, Qt::DirectConnection);
+    connect(this, &Engine::gameStarted, this, [this] {
+        Trace::record(Trace::SignalEmitted, Trace::GameStartedSignal);
+        d_ptr->publishSnapshot();
+    }, Qt::DirectConnection);
+    connect(this, &Engine::gameOver, this, [](bool won) {
+        Trace::record(Trace::SignalEmitted, Trace::GameOverSignal, won);
+    }, Qt::DirectConnection);
+    connect(this, &Engine::clearData, this, [this] {
+        Trace::record(Trace::SignalEmitted, Trace::ClearDataSignal);
+        d_ptr->publishSnapshot();
+    }, Qt::DirectConnection);
+    connect(this, &Engine::engineFailure, this, [] {
+        Trace::record(Trace::SignalEmitted, Trace::EngineFailureSignal);
+        Trace::dump();
+    }, Qt::DirectConnection);
+    setStorage(new MemoryStorage());
+    qCDebug(lcEngine) << "Patience Engine created";
+}
+
+Storage *Engine::storage() const
+{
+    return m_storage;
+}
+
+void Engine::setStorage(Storage *storage)
+{
+    // Call before moving the engine to its thread, storage becomes a child of engine
+    if (m_storage == storage)
+        return;
+    delete m_storage;
+    m_storage = storage;
+    m_storage->setParent(this);
+    m_storage->watch(DelayConf);
+    connect(m_storage, &Storage::valueChanged, this, [this](const QString &key) {
+        if (key == DelayConf)
+            d_ptr->m_delayedCallDelay = readDelayedCallDelay();
     });
-#endif // ENGINE_EXERCISER
     d_ptr->m_delayedCallDelay = readDelayedCallDelay();
-    qCDebug(lcEngine) << "Patience Engine created";
+}
+
+Statistics *Engine::statistics() const
+{
+    return m_statistics.data();
+}
+
+void Engine::setStatistics(Statistics *statistics)
+{
+    // Takes ownership, without statistics finished games are not recorded
+    m_statistics.reset(statistics);
+}
+
+qint64 Engine::elapsedTime() const
+{
+    return m_timeSource ? m_timeSource() : 0;
+}
+
+void Engine::setTimeSource(std::function<qint64()> source)
+{
+    m_timeSource = source;
 }
 
 void Engine::init()
@@ -180,6 +259,7 @@ void Engine::initWithDirectory(const QString &gameDirectory)
 
 Engine::~Engine()
 {
+    Trace::finish();
     s_engine = nullptr;
 }
 
@@ -205,15 +285,20 @@ Engine::ActionType Engine::actionType(ActionTypeFlags actionFlags)
 void Engine::addArguments(QCommandLineParser *parser)
 {
     Recorder::addArguments(parser);
+    JournalStorage::addArguments(parser);
+    Trace::addArguments(parser);
 }
 
 void Engine::setArguments(QCommandLineParser *parser)
 {
-    Recorder::setArguments(parser);
+    Recorder::setArguments(parser, instance()->storage());
+    Trace::setArguments(parser);
 }
 
 void Engine::load(const QString &gameFile)
 {
+    if (d_ptr->m_state == EngineInternals::RunningState && d_ptr->m_gameFile != gameFile)
+        d_ptr->m_recorder.parkSession();
     loadGame(gameFile, false);
 }
 
@@ -231,22 +316,32 @@ void Engine::loadGame(const QString &gameFile, bool restored)
         qCDebug(lcEngine) << "Loaded" << gameFile;
         d_ptr->m_state = restored ? EngineInternals::RestoredState : EngineInternals::LoadedState;
         d_ptr->m_gameFile = gameFile;
-#ifndef ENGINE_EXERCISER
         GameOptionList options = d_ptr->getGameOptions();
-        if (!options.isEmpty() && GameOptionModel::loadOptions(gameFile, options) && !setGameOptions(options)) {
+        if (!options.isEmpty() && m_storage->loadOptions(gameFile, options) && !setGameOptions(options)) {
             qCWarning(lcEngine) << "Stored game options don't apply, clearing stored game options";
-            GameOptionModel::clearOptions(gameFile);
+            m_storage->clearOptions(gameFile);
             // Reload to reset options
             loadGame(gameFile, restored);
             return;
         }
-#endif // ENGINE_EXERCISER
         emit gameLoaded(gameFile);
         d_ptr->m_recorder.invalidateState();
     }
 }
 
 void Engine::start() {
+    if (d_ptr->m_state == EngineInternals::LoadedState) {
+        quint32 seed;
+        qint64 time;
+        if (d_ptr->m_recorder.resumeSession(d_ptr->m_gameFile, seed, time)) {
+            // Continue the game that was left when switching to another game
+            d_ptr->m_seed = seed;
+            d_ptr->m_makeFirstMove = true;
+            emit restoreStarted(time);
+            startEngine(false);
+            return;
+        }
+    }
     startEngine(d_ptr->m_state != EngineInternals::RestoredState);
 }
 
@@ -367,7 +462,6 @@ void Engine::getHint()
         return;
     }
 
-    scm_dynwind_begin((scm_t_dynwind_flags)0);
     if (!scm_is_false(data)) {
         int type = scm_to_int(SCM_CAR(data));
         if (type == 0) {
@@ -387,7 +481,6 @@ void Engine::getHint()
                 message = QStringLiteral("Move %1 onto %2").arg(msg1).arg(msg2);
         }
     }
-    scm_dynwind_end();
     emit hint(message);
 }
 
@@ -429,6 +522,7 @@ bool Engine::drag(quint32 id, int slotId, const CardList &cards)
             auto data = d_ptr->m_cardSlots[slotId].takeLast();
             emit action(actionFlags, slotId, d_ptr->m_cardSlots[slotId].count(), data);
         }
+        d_ptr->invalidateSlot(slotId);
     }
 
     could = scm_is_true(rv);
@@ -450,10 +544,12 @@ void Engine::cancelDrag(quint32 id, int slotId, const CardList &cards)
     qCDebug(lcEngine) << "Canceling move, putting back" << cards.count() << "cards to slot" << slotId;
     // Put the cards back
     auto actionFlags = d_ptr->flags(Engine::InsertionAction, true);
-    int base = d_ptr->m_cardSlots[slotId].count();
-    for (int i = 0; i < cards.count(); i++)
-        emit action(actionFlags, slotId, base + i, cards.at(i));
-    d_ptr->m_cardSlots[slotId].append(cards);
+    CardBuffer &slot = d_ptr->m_cardSlots[slotId];
+    for (const CardData &card : cards) {
+        emit action(actionFlags, slotId, slot.count(), card);
+        slot.append(card);
+    }
+    d_ptr->invalidateSlot(slotId);
     d_ptr->discardMove();
     m_action = 0;
 }
@@ -788,15 +884,50 @@ void Engine::forgetPreviousGame()
     d_ptr->m_recorder.dropOldState();
 }
 
+void Engine::seek(int move)
+{
+    if (m_action || d_ptr->hasDelayedCall() || d_ptr->m_recordingMove) {
+        qCWarning(lcEngine) << "Can not seek while an action or a delayed call is ongoing";
+        return;
+    }
+
+    if (d_ptr->m_state < EngineInternals::RunningState || d_ptr->replaying()) {
+        qCWarning(lcEngine) << "Can not seek before the game has started";
+        return;
+    }
+
+    if (d_ptr->m_state == EngineInternals::GameOverState) {
+        d_ptr->m_state = EngineInternals::RunningState;
+        emit gameContinued();
+    }
+
+    if (!d_ptr->m_recorder.seek(move))
+        d_ptr->testGameOver();
+}
+
+void Engine::reset()
+{
+    // Forget the current game, e.g. to restore another saved state
+    d_ptr->m_makeFirstMove = false;
+    d_ptr->m_recordingMove = false;
+    d_ptr->m_recorder.clear();
+    d_ptr->clear(true);
+}
+
 CardList Engine::cards(int slotId, int count) const
 {
-    const CardList &slot = d_ptr->getSlot(slotId);
-    return slot.mid(count > 0 ? slot.count() - count : 0);
+    const CardBuffer &slot = d_ptr->getSlot(slotId);
+    return CardList::fromVector(slot.mid(count > 0 ? slot.count() - count : 0));
+}
+
+TableSnapshotPointer Engine::snapshot() const
+{
+    return std::atomic_load(&d_ptr->m_snapshot);
 }
 
 uint_fast32_t Engine::seed() const
 {
-    return d_ptr->m_seed;
+    return snapshot()->seed();
 }
 
 void EngineInternals::handleReplayGame(const QString &gameFile, bool hasSeed, uint_fast32_t seed, qint64 time)
@@ -829,6 +960,11 @@ void EngineInternals::handleReplayCompleted(Recorder::CompletionStatus status)
         emit engine()->restoreCompleted(false, false);
         qCDebug(lcEngine) << "Replay failed";
         break;
+    case Recorder::SeekCompleted:
+        qCDebug(lcEngine) << "Seek succeeded";
+        emit engine()->seekCompleted(m_recorder.position());
+        QTimer::singleShot(0, this, [this]() { testGameOver(); });
+        break;
     }
 }
 
@@ -845,8 +981,7 @@ Engine::ActionTypeFlags EngineInternals::flags(Engine::ActionType action, bool e
 int Engine::readDelayedCallDelay() const
 {
     int delay = DelayedCallDelayDefault;
-#ifndef ENGINE_EXERCISER
-    auto value = m_delayConf.value();
+    auto value = m_storage->value(DelayConf);
     if (value.isValid()) {
         bool ok = false;
         int tmp = value.toInt(&ok);
@@ -855,7 +990,6 @@ int Engine::readDelayedCallDelay() const
         else
             qCWarning(lcEngine) << "Invalid delayedCallDelay value:" << value;
     }
-#endif // ENGINE_EXERCISER
     return delay;
 }
 
@@ -881,7 +1015,7 @@ void EngineInternals::recordMove(int slotId)
 
     SCM args[2];
     args[0] = scm_from_int(slotId);
-    args[1] = Scheme::slotToSCM(m_cardSlots.value(slotId));
+    args[1] = SCM_CADR(getSlotSCM(slotId));
 
     if (!makeSCMCall(QStringLiteral("record-move"), args, 2, nullptr))
         die("Can not record move");
@@ -897,6 +1031,10 @@ void EngineInternals::endMove(bool fromDelayedCall)
     else
         emit engine()->action(flags(Engine::MoveEndedAction), -1, -1, none);
 
+    // Only conversions allocate, cached lookups return the same list
+    qCDebug(lcScheme) << "Converted" << m_slotConversions << "slots to Scheme lists during move";
+    m_slotConversions = 0;
+
     if (!fromDelayedCall) {
         if (!m_recordingMove)
             qCWarning(lcEngine) << "There was no move ongoing when ending move";
@@ -956,6 +1094,11 @@ void EngineInternals::clear(bool resetData)
     setCanRedo(false);
     setCanDeal(false);
     m_cardSlots.clear();
+    // The next deal must report its score even if it equals the last one
+    m_score = -1;
+    dropCheckpoints();
+    if (scm_is_true(m_slotCache))
+        scm_vector_fill_x(m_slotCache, SCM_BOOL_F);
     clearDelayedCall();
     emit engine()->clearData();
 }
@@ -990,6 +1133,10 @@ void EngineInternals::setCanDeal(bool canDeal)
 
 void EngineInternals::setScore(int score)
 {
+    // Games update score after every move, skip signals that would change nothing
+    if (score == m_score)
+        return;
+    m_score = score;
     qCDebug(lcEngine) << "Score updated to" << score;
     emit engine()->score(score);
 }
@@ -1012,7 +1159,7 @@ void EngineInternals::setHeight(double height)
     emit engine()->heightChanged(height);
 }
 
-void EngineInternals::addSlot(int id, const CardList &cards, SlotType type,
+void EngineInternals::addSlot(int id, const CardBuffer &cards, SlotType type,
                             double x, double y, int expansionDepth,
                             bool expandedDown, bool expandedRight)
 {
@@ -1027,58 +1174,125 @@ void EngineInternals::addSlot(int id, const CardList &cards, SlotType type,
     if (id >= m_cardSlots.size())
         m_cardSlots.resize(id + 1);
     m_cardSlots[id] = cards;
-    emit engine()->newSlot(id, cards, type, x, y, expansionDepth, expandedDown, expandedRight);
+
+    if (scm_is_false(m_slotCache) || SCM_SIMPLE_VECTOR_LENGTH(m_slotCache) < size_t(m_cardSlots.size())) {
+        // Slots are added only while loading, grow to the final size in a few steps
+        SCM cache = scm_c_make_vector(qMax(m_cardSlots.size(), 16) * 2, SCM_BOOL_F);
+        if (scm_is_true(m_slotCache))
+            scm_gc_unprotect_object(m_slotCache);
+        m_slotCache = scm_gc_protect_object(cache);
+    } else {
+        invalidateSlot(id);
+    }
+    emit engine()->newSlot(id, CardList::fromVector(cards), type, x, y, expansionDepth, expandedDown, expandedRight);
 }
 
-const CardList &EngineInternals::getSlot(int slot) const
+const CardBuffer &EngineInternals::getSlot(int slot) const
 {
-    static CardList empty;
+    static CardBuffer empty;
     if (slot < 0 || slot >= m_cardSlots.size())
         return empty;
     return m_cardSlots.at(slot);
 }
 
-void EngineInternals::setCards(int id, const CardList &cards)
+SCM EngineInternals::getSlotSCM(int slot)
+{
+    /*
+     * The (id cards) list is converted once until the slot changes and every
+     * caller gets the same list. get-slot, get-cards and record-move only read
+     * it or keep it for later, they must not modify it with e.g. reverse! or
+     * sort!
+     */
+    if (slot < 0 || slot >= m_cardSlots.size())
+        return scm_list_2(scm_from_int(slot), SCM_EOL);
+    SCM list = SCM_SIMPLE_VECTOR_REF(m_slotCache, slot);
+    if (scm_is_false(list)) {
+        list = scm_list_2(scm_from_int(slot), Scheme::slotToSCM(m_cardSlots.at(slot)));
+        SCM_SIMPLE_VECTOR_SET(m_slotCache, slot, list);
+        m_slotConversions++;
+    }
+    return list;
+}
+
+void EngineInternals::invalidateSlot(int slot)
 {
+    if (scm_is_true(m_slotCache) && slot >= 0 && size_t(slot) < SCM_SIMPLE_VECTOR_LENGTH(m_slotCache))
+        SCM_SIMPLE_VECTOR_SET(m_slotCache, slot, SCM_BOOL_F);
+}
+
+CardBuffer &EngineInternals::cardBuffer()
+{
+    return m_cardBuffer;
+}
+
+void EngineInternals::setCards(int id, const CardBuffer &cards)
+{
+    CardBuffer &slot = m_cardSlots[id];
     if (cards.isEmpty()) {
-        if (!m_cardSlots.at(id).isEmpty()) {
+        Trace::record(Trace::CardsSet, id, slot.count());
+        if (!slot.isEmpty()) {
             qCDebug(lcEngine) << "Clearing slot" << id;
             emit engine()->action(flags(Engine::ClearingAction), id, -1, none);
-            m_cardSlots[id].clear();
+            slot.clear();
+            invalidateSlot(id);
         }
         return;
     }
 
-    auto it = cards.constEnd();
-    int i = m_cardSlots.at(id).count() - 1;
-    while (it-- != cards.constBegin() && i >= 0) {
-        auto card = m_cardSlots.at(id).at(i);
-        if (card.equalValue(*it)) {
-            if ((*it).show != card.show) {
-                qCDebug(lcEngine) << "Flipping" << *it << "in slot" << id << "at index" << i;
-                emit engine()->action(flags(Engine::FlippingAction), id, i, *it);
-                m_cardSlots[id][i].show = (*it).show;
-            }
-            i--;
-        } else {
-            qCDebug(lcEngine) << "Removing" << card << "from slot" << id << "from index" << i;
-            emit engine()->action(flags(Engine::RemovalAction), id, i, m_cardSlots[id].takeAt(i));
-            i--; ++it;
+    // Keep cards that match at the bottom and at the top, replace everything between them
+    int oldCount = slot.count();
+    int newCount = cards.count();
+    int limit = qMin(oldCount, newCount);
+    int prefix = 0;
+    while (prefix < limit && slot.at(prefix).equalValue(cards.at(prefix)))
+        prefix++;
+    int suffix = 0;
+    while (suffix < limit - prefix
+           && slot.at(oldCount - 1 - suffix).equalValue(cards.at(newCount - 1 - suffix)))
+        suffix++;
+    int removed = oldCount - prefix - suffix;
+    int inserted = newCount - prefix - suffix;
+    int flipped = 0;
+
+    auto flip = [&](int i) {
+        if (slot.at(i).show != cards.at(i).show) {
+            qCDebug(lcEngine) << "Flipping" << cards.at(i) << "in slot" << id << "at index" << i;
+            emit engine()->action(flags(Engine::FlippingAction), id, i, cards.at(i));
+            slot[i].show = cards.at(i).show;
+            flipped++;
         }
+    };
+
+    for (int i = 0; i < prefix; i++)
+        flip(i);
+
+    for (int i = prefix + removed - 1; i >= prefix; i--) {
+        qCDebug(lcEngine) << "Removing" << slot.at(i) << "from slot" << id << "from index" << i;
+        emit engine()->action(flags(Engine::RemovalAction), id, i, slot.at(i));
     }
-    for (; i >= 0; i--) {
-        qCDebug(lcEngine) << "Remove" << m_cardSlots.at(id).at(i) << "from slot" << id << "from index" << i;
-        emit engine()->action(flags(Engine::RemovalAction), id, i, m_cardSlots[id].takeAt(i));
-    }
-    ++it;
-    while (it-- != cards.constBegin()) {
-        qCDebug(lcEngine) << "Appending" << *it << "to slot" << id << "to index 0";
-        emit engine()->action(flags(Engine::InsertionAction), id, 0, *it);
-        m_cardSlots[id].insert(0, *it);
+    if (removed > 0)
+        slot.remove(prefix, removed);
+
+    if (inserted > 0) {
+        slot.insert(prefix, inserted, none);
+        for (int i = prefix; i < prefix + inserted; i++) {
+            qCDebug(lcEngine) << "Inserting" << cards.at(i) << "to slot" << id << "to index" << i;
+            emit engine()->action(flags(Engine::InsertionAction), id, i, cards.at(i));
+            slot[i] = cards.at(i);
+        }
     }
 
-    if (m_cardSlots.at(id) != cards)
+    for (int i = newCount - suffix; i < newCount; i++)
+        flip(i);
+
+    Trace::record(Trace::CardsSet, id, removed, inserted, flipped);
+    if (removed || inserted || flipped)
+        invalidateSlot(id);
+
+#ifndef QT_NO_DEBUG
+    if (slot != cards)
         die("Cards don't match!");
+#endif
 }
 
 void EngineInternals::setExpansionToDown(int id, double expansion)
@@ -1143,6 +1357,7 @@ bool EngineInternals::setupDelayedCall(std::function<void()> callback, std::func
 
     m_delayedCallTimer = new QTimer();
     QObject::connect(m_delayedCallTimer, &QTimer::timeout, this, [this, callback] {
+        Trace::record(Trace::DelayedCallFired, 0);
         // The callback may setup another delayed call, set the current one to null already
         m_delayedCallTimer->deleteLater();
         m_delayedCallTimer = nullptr;
@@ -1156,7 +1371,9 @@ bool EngineInternals::setupDelayedCall(std::function<void()> callback, std::func
 
     QObject::connect(m_delayedCallTimer, &QObject::destroyed, this, destructCallback);
 
-    m_delayedCallTimer->start(replaying() ? DelayedCallDelayOnReplay : m_delayedCallDelay);
+    int delay = replaying() ? DelayedCallDelayOnReplay : m_delayedCallDelay;
+    Trace::record(Trace::DelayedCallQueued, 0, delay);
+    m_delayedCallTimer->start(delay);
     return true;
 }
 
@@ -1183,6 +1400,163 @@ void EngineInternals::resetGenerator(bool generateNewSeed)
     m_recorder.setSeed(m_seed);
 }
 
+void EngineInternals::publishSnapshot()
+{
+    auto snapshot = std::make_shared<const TableSnapshot>(m_cardSlots, m_seed, ++m_generation);
+    std::atomic_store(&m_snapshot, TableSnapshotPointer(snapshot));
+}
+
+bool EngineInternals::storeCheckpoint(int move)
+{
+    // Positions are captured like undo does it, only between moves
+    if (m_recordingMove || hasDelayedCall() || m_state < RunningState)
+        return false;
+
+    auto it = std::lower_bound(m_checkpoints.begin(), m_checkpoints.end(), move,
+                               [](const Checkpoint &checkpoint, int move) { return checkpoint.move < move; });
+    if (it != m_checkpoints.end() && it->move == move)
+        return true;
+
+    Checkpoint checkpoint;
+    if (!capturePosition(&checkpoint.position, &checkpoint.history)) {
+        qCWarning(lcEngine) << "Can not store checkpoint at move" << move;
+        return false;
+    }
+    checkpoint.move = move;
+    checkpoint.position = scm_gc_protect_object(checkpoint.position);
+    checkpoint.history = scm_gc_protect_object(checkpoint.history);
+    checkpoint.generator = m_generator;
+    m_checkpoints.insert(it, checkpoint);
+    qCDebug(lcEngine) << "Stored checkpoint at move" << move;
+    return true;
+}
+
+int EngineInternals::restoreCheckpoint(int move)
+{
+    auto it = std::upper_bound(m_checkpoints.constBegin(), m_checkpoints.constEnd(), move,
+                               [](int move, const Checkpoint &checkpoint) { return move < checkpoint.move; });
+    if (it == m_checkpoints.constBegin())
+        return -1;
+    const Checkpoint &checkpoint = *--it;
+
+    if (!restorePosition(checkpoint.position, checkpoint.history, checkpoint.generator))
+        return -1;
+    qCDebug(lcEngine) << "Restored checkpoint at move" << checkpoint.move;
+    return checkpoint.move;
+}
+
+void EngineInternals::dropCheckpoints(int after)
+{
+    auto it = std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(), after,
+                               [](int move, const Checkpoint &checkpoint) { return move < checkpoint.move; });
+    for (auto checkpoint = it; checkpoint != m_checkpoints.end(); ++checkpoint) {
+        scm_gc_unprotect_object(checkpoint->position);
+        scm_gc_unprotect_object(checkpoint->history);
+    }
+    m_checkpoints.erase(it, m_checkpoints.end());
+}
+
+/*
+ * Store the current position as text, see resumeSession() in Recorder.
+ *
+ * The position is the same one as in checkpoints preceded by the state of the
+ * random number generator. Returns an empty array if the position can not be
+ * written out, e.g. when a game keeps procedures in its variables.
+ */
+QByteArray EngineInternals::storeState()
+{
+    if (m_recordingMove || hasDelayedCall() || m_state < RunningState)
+        return QByteArray();
+
+    SCM position, history;
+    if (!capturePosition(&position, &history))
+        return QByteArray();
+
+    SCM state = scm_cons(position, history);
+    SCM text = scm_object_to_string(state, SCM_UNDEFINED);
+    SCM value;
+    if (!readSCM(text, &value) || scm_is_false(scm_equal_p(value, state))) {
+        qCDebug(lcEngine) << "Position can not be stored as text";
+        return QByteArray();
+    }
+
+    std::ostringstream generator;
+    generator << m_generator;
+    QByteArray result = QByteArray::fromStdString(generator.str());
+    result.append('\n');
+    result.append(Scheme::getUtf8String(text).toUtf8());
+    return result;
+}
+
+bool EngineInternals::restoreState(const QByteArray &state)
+{
+    int separator = state.indexOf('\n');
+    if (separator < 0)
+        return false;
+
+    std::mt19937 generator;
+    std::istringstream stream(state.left(separator).toStdString());
+    if (!(stream >> generator))
+        return false;
+
+    SCM text = scm_from_utf8_stringn(state.constData() + separator + 1, state.size() - separator - 1);
+    SCM value;
+    if (!readSCM(text, &value) || !scm_is_pair(value))
+        return false;
+
+    return restorePosition(scm_car(value), scm_cdr(value), generator);
+}
+
+bool EngineInternals::capturePosition(SCM *position, SCM *history)
+{
+    SCM moveVariable = apiVariable("MOVE");
+    SCM historyVariable = apiVariable("HISTORY");
+    if (scm_is_false(moveVariable) || scm_is_false(historyVariable))
+        return false;
+
+    SCM args[2];
+    args[0] = scm_from_int(-1);
+    args[1] = SCM_EOL;
+    if (!makeSCMCall(QStringLiteral("record-move"), args, 2, nullptr))
+        return false;
+    *position = scm_variable_ref(moveVariable);
+    *history = scm_variable_ref(historyVariable);
+    scm_variable_set_x(moveVariable, SCM_EOL);
+    return true;
+}
+
+bool EngineInternals::restorePosition(SCM position, SCM history, const std::mt19937 &generator)
+{
+    SCM historyVariable = apiVariable("HISTORY");
+    SCM futureVariable = apiVariable("FUTURE");
+    if (scm_is_false(historyVariable) || scm_is_false(futureVariable))
+        return false;
+
+    if (!makeSCMCall(QStringLiteral("eval-move"), &position, 1, nullptr)) {
+        die("Can not restore position");
+        return false;
+    }
+    scm_variable_set_x(historyVariable, history);
+    scm_variable_set_x(futureVariable, SCM_EOL);
+    m_generator = generator;
+
+    setCanUndo(!scm_is_null(history));
+    setCanRedo(false);
+    emit engine()->action(flags(Engine::MoveEndedAction), -1, -1, none);
+    updateDealable();
+    return true;
+}
+
+bool EngineInternals::readSCM(SCM text, SCM *value)
+{
+    // Reading fails for anything that was not written out as plain data
+    SCM reader = scm_c_eval_string("(lambda (text) (call-with-input-string text read))");
+    if (!makeSCMCall(reader, &text, 1, value))
+        return false;
+    scm_remember_upto_here_1(reader);
+    return true;
+}
+
 void EngineInternals::die(const char *message)
 {
     emit engine()->engineFailure(QString(message));
@@ -1190,11 +1564,17 @@ void EngineInternals::die(const char *message)
 
 bool EngineInternals::makeSCMCall(Lambda lambda, SCM *args, size_t n, SCM *retval)
 {
-    return makeSCMCall(m_lambdas[lambda], args, n, retval);
+    return callSCM(lambda, m_lambdas[lambda], args, n, retval);
 }
 
 bool EngineInternals::makeSCMCall(SCM lambda, SCM *args, size_t n, SCM *retval)
 {
+    return callSCM(Trace::AnonymousCall, lambda, args, n, retval);
+}
+
+bool EngineInternals::callSCM(quint16 traceId, SCM lambda, SCM *args, size_t n, SCM *retval)
+{
+    Trace::CallScope trace(traceId);
     Interface::Call call = { lambda, args, n };
     bool error = false;
 
@@ -1207,13 +1587,14 @@ bool EngineInternals::makeSCMCall(SCM lambda, SCM *args, size_t n, SCM *retval)
 
     if (retval)
         *retval = r;
+    trace.succeeded();
     return true;
 }
 
 bool EngineInternals::makeSCMCall(QString name, SCM *args, size_t n, SCM *retval)
 {
     SCM lambda = scm_c_eval_string(name.toUtf8().data());
-    if (!makeSCMCall(lambda, args, n, retval))
+    if (!callSCM(Trace::callId(name), lambda, args, n, retval))
         return false;
     scm_remember_upto_here_1(lambda);
     return true;
@@ -18,17 +18,19 @@
 #ifndef ENGINE_H
 #define ENGINE_H
 
-#ifndef ENGINE_EXERCISER
-#include <MGConfItem>
-#endif // ENGINE_EXERCISER
+#include <functional>
 #include <QObject>
+#include <QScopedPointer>
 #include <QString>
 #include "enginedata.h"
+#include "snapshot.h"
 
 class QCommandLineParser;
 
 class EngineHelper;
 class EngineInternals;
+class Statistics;
+class Storage;
 class Engine : public QObject
 {
     Q_OBJECT
@@ -56,10 +58,22 @@ public:
 
     static ActionType actionType(ActionTypeFlags action);
 
+    // Live state, only call these from the engine thread
     CardList cards(int slotId, int count) const;
 
+    // Safe to call from any thread, see TableSnapshot
+    TableSnapshotPointer snapshot() const;
     uint_fast32_t seed() const;
 
+    Storage *storage() const;
+    void setStorage(Storage *storage);
+
+    Statistics *statistics() const;
+    void setStatistics(Statistics *statistics);
+
+    qint64 elapsedTime() const;
+    void setTimeSource(std::function<qint64()> source);
+
 public slots:
     void init();
     void initWithDirectory(const QString &gameDirectory);
@@ -83,6 +97,8 @@ public slots:
     void saveState();
     void restorePreviousGame();
     void forgetPreviousGame();
+    void reset();
+    void seek(int move);
 
 signals:
     void canUndo(bool canUndo);
@@ -99,6 +115,7 @@ signals:
     void gameContinued();
     void restoreStarted(qint64 time);
     void restoreCompleted(bool restored, bool success);
+    void seekCompleted(int move);
     void gameOver(bool won);
     void gameOptions(GameOptionList options);
 
@@ -124,10 +141,7 @@ signals:
 
 private:
     friend EngineInternals;
-
-#ifdef ENGINE_EXERCISER
     friend EngineHelper;
-#endif // ENGINE_EXERCISER
 
     void loadGame(const QString &gameFile, bool restored);
     void startEngine(bool newSeed);
@@ -137,9 +151,9 @@ private:
     static Engine *s_engine;
     EngineInternals *d_ptr;
     quint32 m_action;
-#ifndef ENGINE_EXERCISER
-    MGConfItem m_delayConf;
-#endif // ENGINE_EXERCISER
+    Storage *m_storage;
+    QScopedPointer<Statistics> m_statistics;
+    std::function<qint64()> m_timeSource;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(Engine::ActionTypeFlags);
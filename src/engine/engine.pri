@@ -0,0 +1,12 @@
+# Link against libpatience-engine built from engine.pro
+ENGINE_LIBDIR = $$shadowed($$PWD)
+
+INCLUDEPATH += \
+    $$PWD \
+    $$PWD/../common \
+    $$PWD/../manager
+
+LIBS += -L$$ENGINE_LIBDIR -lpatience-engine
+PRE_TARGETDEPS += $$ENGINE_LIBDIR/libpatience-engine.a
+
+include(guile.pri)
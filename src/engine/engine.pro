@@ -0,0 +1,50 @@
+TEMPLATE = lib
+TARGET = patience-engine
+CONFIG += staticlib
+QT = core
+
+include(guile.pri)
+
+NAME = $$(NAME)
+isEmpty(NAME): NAME = patience-deck
+DEFINES += DATADIR=/usr/share/$$NAME
+
+SOURCES += \
+    allocationcounter.cpp \
+    archive.cpp \
+    engine.cpp \
+    interface.cpp \
+    journalstorage.cpp \
+    recorder.cpp \
+    sessionstore.cpp \
+    statistics.cpp \
+    snapshot.cpp \
+    storage.cpp \
+    trace.cpp \
+    ../common/itertools.cpp \
+    ../common/logging.cpp \
+    ../manager/queue.cpp
+
+HEADERS += \
+    allocationcounter.h \
+    archive.h \
+    enginedata.h \
+    engine.h \
+    engineinternals.h \
+    interface.h \
+    journalstorage.h \
+    recorder.h \
+    sessionstore.h \
+    statistics.h \
+    snapshot.h \
+    storage.h \
+    trace.h \
+    ../common/constants.h \
+    ../common/itertools.h \
+    ../common/logging.h \
+    ../manager/queue.h
+
+INCLUDEPATH += \
+    . \
+    ../common \
+    ../manager
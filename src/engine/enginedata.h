@@ -21,6 +21,7 @@
 #include <QList>
 #include <QMetaEnum>
 #include <QMetaType>
+#include <QVector>
 
 enum Rank : int {
     RankJoker = 0,
@@ -89,8 +90,13 @@ struct CardData {
     friend QDebug operator<<(QDebug debug, const CardData *data);
 };
 
+Q_DECLARE_TYPEINFO(CardData, Q_MOVABLE_TYPE);
+
 typedef QList<CardData> CardList;
 
+// Contiguous storage for converting cards from Scheme without per card allocations
+typedef QVector<CardData> CardBuffer;
+
 Q_DECLARE_METATYPE(struct CardData)
 
 Q_DECLARE_METATYPE(CardList)
@@ -29,6 +29,7 @@
 #include "enginedata.h"
 #include "recorder.h"
 
+class EngineChecker;
 class EngineHelper;
 class EngineInternals : public QObject
 {
@@ -96,11 +97,14 @@ public:
     void setWidth(double width);
     void setHeight(double height);
 
-    void addSlot(int id, const CardList &cards, SlotType type,
+    void addSlot(int id, const CardBuffer &cards, SlotType type,
                  double x, double y, int expansionDepth,
                  bool expandedDown, bool expandedRight);
-    const CardList &getSlot(int slot) const;
-    void setCards(int id, const CardList &cards);
+    const CardBuffer &getSlot(int slot) const;
+    SCM getSlotSCM(int slot);
+    void invalidateSlot(int slot);
+    void setCards(int id, const CardBuffer &cards);
+    CardBuffer &cardBuffer();
     void setExpansionToDown(int id, double expansion);
     void setExpansionToRight(int id, double expansion);
     void setLambda(Lambda lambda, SCM func);
@@ -116,6 +120,13 @@ public:
     quint32 getRandomValue(quint32 first, quint32 last);
     void resetGenerator(bool generateNewSeed);
     void die(const char *message);
+    void publishSnapshot();
+
+    bool storeCheckpoint(int move);
+    int restoreCheckpoint(int move);
+    void dropCheckpoints(int after = -1);
+    QByteArray storeState();
+    bool restoreState(const QByteArray &state);
 
     bool makeSCMCall(Lambda lambda, SCM *args, size_t n, SCM *retval);
     bool makeSCMCall(SCM lambda, SCM *args, size_t n, SCM *retval);
@@ -127,22 +138,40 @@ private slots:
 
 private:
     friend Engine;
-#ifdef ENGINE_EXERCISER
+    friend EngineChecker;
     friend EngineHelper;
-#endif
+
+    // Position after a number of recorded moves, see storeCheckpoint()
+    struct Checkpoint {
+        int move;
+        SCM position;
+        SCM history;
+        std::mt19937 generator;
+    };
 
     Engine::ActionTypeFlags flags(Engine::ActionType action, bool engineAction = false) const;
     bool replaying() const;
+    bool capturePosition(SCM *position, SCM *history);
+    bool restorePosition(SCM position, SCM history, const std::mt19937 &generator);
+    bool readSCM(SCM text, SCM *value);
+    bool callSCM(quint16 traceId, SCM lambda, SCM *args, size_t n, SCM *retval);
 
     QTimer *m_delayedCallTimer;
     int m_delayedCallDelay;
-    QVector<CardList> m_cardSlots;
+    QVector<CardBuffer> m_cardSlots;
+    CardBuffer m_cardBuffer;
+    SCM m_slotCache;
+    int m_slotConversions;
     SCM m_lambdas[LambdaCount];
     GameFeatures m_features;
     GameState m_state;
     int m_timeout;
+    int m_score;
     QString m_gameFile;
     uint_fast32_t m_seed;
+    TableSnapshotPointer m_snapshot;
+    quint64 m_generation;
+    QVector<Checkpoint> m_checkpoints;
     std::mt19937 m_generator;
     bool m_recordingMove;
     quint32 m_action;
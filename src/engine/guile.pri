@@ -0,0 +1,9 @@
+CONFIG += link_pkgconfig
+NAME = $$(NAME)
+equals(NAME, "harbour-patience-deck") {
+    INCLUDEPATH += $(CACHE)/built/usr/share/harbour-patience-deck/include
+    INCLUDEPATH += $(CACHE)/built/usr/share/harbour-patience-deck/include/guile/2.2
+    LIBS += -L$(CACHE)/built/usr/share/harbour-patience-deck/lib -lguile-2.2 -lgc
+} else {
+    PKGCONFIG += guile-2.2
+}
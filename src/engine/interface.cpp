@@ -15,7 +15,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <QRegularExpression>
+#include <algorithm>
+#include <climits>
+#include "allocationcounter.h"
 #include "enginedata.h"
 #include "engineinternals.h"
 #include "interface.h"
@@ -44,6 +46,15 @@ void Interface::init_module(void* data)
     scm_c_define_gsubr("undo-set-sensitive", 1, 0, 0, (void *)&undoSetSensitive);
     scm_c_define_gsubr("redo-set-sensitive", 1, 0, 0, (void *)&redoSetSensitive);
     scm_c_define_gsubr("dealable-set-sensitive", 1, 0, 0, (void *)&dealableSetSensitive);
+    scm_c_define_gsubr("get-cards-c", 1, 0, 0, (void *)&getCards);
+    scm_c_define_gsubr("empty-slot-c?", 1, 0, 0, (void *)&emptySlotP);
+    scm_c_define_gsubr("get-top-card-c", 1, 0, 0, (void *)&getTopCard);
+    scm_c_define_gsubr("is-red-c?", 1, 0, 0, (void *)&isRedP);
+    scm_c_define_gsubr("is-black-c?", 1, 0, 0, (void *)&isBlackP);
+    scm_c_define_gsubr("check-same-suit-list-c", 1, 0, 0, (void *)&checkSameSuitList);
+    scm_c_define_gsubr("check-same-color-list-c", 1, 0, 0, (void *)&checkSameColorList);
+    scm_c_define_gsubr("check-alternating-color-list-c", 1, 0, 0, (void *)&checkAlternatingColorList);
+    scm_c_define_gsubr("check-straight-descending-list-c", 1, 0, 0, (void *)&checkStraightDescendingList);
 
     scm_c_export("set-feature-word!", "get-feature-word", "set-statusbar-message-c",
                  "reset-surface", "add-slot", "get-slot", "set-cards-c!",
@@ -51,7 +62,11 @@ void Interface::init_module(void* data)
                  "set-lambda", "set-lambda!", "aisleriot-random",
                  "click-to-move?", "update-score", "get-timeout",
                  "set-timeout!", "delayed-call", "undo-set-sensitive",
-                 "redo-set-sensitive", "dealable-set-sensitive", nullptr);
+                 "redo-set-sensitive", "dealable-set-sensitive",
+                 "get-cards-c", "empty-slot-c?", "get-top-card-c",
+                 "is-red-c?", "is-black-c?", "check-same-suit-list-c",
+                 "check-same-color-list-c", "check-alternating-color-list-c",
+                 "check-straight-descending-list-c", nullptr);
 
     qCInfo(lcScheme) << "Initialized aisleriot interface";
 }
@@ -109,11 +124,52 @@ inline QString Scheme::getMessage(SCM message)
 
 QString Scheme::getUtf8String(SCM string)
 {
+    // Copy characters straight to QString instead of going through a malloc'd UTF-8 buffer
     if (!scm_is_string(string))
         return QString();
-    char *utf8 = scm_to_utf8_string(string);
-    scm_dynwind_free(utf8);
-    return utf8 ? QString(utf8) : QString();
+    size_t length = scm_c_string_length(string);
+    QString result;
+    result.reserve(static_cast<int>(length));
+    for (size_t i = 0; i < length; i++) {
+        uint c = SCM_CHAR(scm_c_string_ref(string, i));
+        if (QChar::requiresSurrogates(c)) {
+            result.append(QChar(QChar::highSurrogate(c)));
+            result.append(QChar(QChar::lowSurrogate(c)));
+        } else {
+            result.append(QChar(c));
+        }
+    }
+    return result;
+}
+
+bool Scheme::getScore(SCM score, int *value)
+{
+    if (scm_is_integer(score)) {
+        if (!scm_is_signed_integer(score, 0, INT_MAX))
+            return false;
+        *value = scm_to_int(score);
+        return true;
+    }
+
+    if (!scm_is_string(score))
+        return false;
+
+    // Games send scores as strings, read the digits and skip everything else
+    qint64 result = 0;
+    bool digits = false;
+    size_t length = scm_c_string_length(score);
+    for (size_t i = 0; i < length; i++) {
+        scm_t_wchar c = SCM_CHAR(scm_c_string_ref(score, i));
+        if (c >= '0' && c <= '9') {
+            result = result * 10 + (c - '0');
+            if (result > INT_MAX)
+                return false;
+            digits = true;
+        }
+    }
+    if (digits)
+        *value = static_cast<int>(result);
+    return digits;
 }
 
 const CardData Scheme::createCard(SCM data)
@@ -125,30 +181,22 @@ const CardData Scheme::createCard(SCM data)
     };
 }
 
-CardList Scheme::cardsFromSlot(SCM cards)
+void Scheme::cardsFromSlot(SCM cards, CardBuffer &buffer)
 {
     // mimics aisleriot/src/game.c:cscmi_slot_set_cards
-    CardList newCards;
+    // Top card comes first, append and reverse to keep buffer's capacity
+    buffer.resize(0);
     if (scm_is_true(scm_list_p(cards))) {
         for (SCM it = cards; it != SCM_EOL; it = SCM_CDR(it)) {
-            newCards.insert(0, createCard(SCM_CAR(it)));
+            buffer.append(createCard(SCM_CAR(it)));
         }
+        std::reverse(buffer.begin(), buffer.end());
     }
-    return newCards;
 }
 
 SCM Scheme::cardToSCM(const CardData &card)
 {
-    return scm_cons(
-        scm_from_uint(card.rank),
-        scm_cons(
-            scm_from_uint(card.suit),
-            scm_cons(
-                SCM_BOOL(card.show),
-                SCM_EOL
-            )
-        )
-    );
+    return scm_list_3(scm_from_uint(card.rank), scm_from_uint(card.suit), SCM_BOOL(card.show));
 }
 
 SCM Scheme::slotToSCM(const CardList &slot)
@@ -160,6 +208,15 @@ SCM Scheme::slotToSCM(const CardList &slot)
     return cards;
 }
 
+SCM Scheme::slotToSCM(const CardBuffer &slot)
+{
+    SCM cards = SCM_EOL;
+    for (const CardData &card : slot) {
+        cards = scm_cons(cardToSCM(card), cards);
+    }
+    return cards;
+}
+
 SCM Scheme::startNewGame(void *data)
 {
     EngineInternals *engine = static_cast<EngineInternals *>(data);
@@ -182,6 +239,7 @@ SCM Scheme::loadGameFromFile(void *data)
     scm_dynwind_begin((scm_t_dynwind_flags)0);
     QByteArray file(static_cast<const QString *>(data)->toUtf8());
     scm_primitive_load_path(scm_from_utf8_string(file.constData()));
+    Interface::installNativeApi();
     // TODO: Test all lambdas
     scm_dynwind_end();
     return SCM_BOOL_T;
@@ -229,14 +287,7 @@ SCM Interface::setStatusbarMessage(SCM newMessage)
         return SCM_EOL;
     }
 
-    scm_dynwind_begin((scm_t_dynwind_flags)0);
-
-    char *message = scm_to_utf8_string(newMessage);
-    scm_dynwind_free(message);
-
-    engine->setMessage(QString::fromUtf8(message));
-
-    scm_dynwind_end();
+    engine->setMessage(Scheme::getUtf8String(newMessage));
     return SCM_EOL;
 }
 
@@ -299,7 +350,8 @@ SCM Interface::addCardSlot(SCM slotData)
     int id = scm_to_int(SCM_CAR(slotData));
     double x = scm_to_double(SCM_CAR(SCM_CADR(SCM_CADDR(slotData))));
     double y = scm_to_double(SCM_CADR(SCM_CADR(SCM_CADDR(slotData))));
-    auto cards = Scheme::cardsFromSlot(SCM_CADR(slotData));
+    CardBuffer &cards = engine->cardBuffer();
+    Scheme::cardsFromSlot(SCM_CADR(slotData), cards);
     engine->addSlot(id, cards, type, x, y, expansionDepth, expandedDown, expandedRight);
 
     return SCM_EOL;
@@ -308,14 +360,16 @@ SCM Interface::addCardSlot(SCM slotData)
 SCM Interface::getCardSlot(SCM slotId)
 {
     auto *engine = EngineInternals::instance();
-    const CardList &slot = engine->getSlot(scm_to_int(slotId));
-    return scm_cons(slotId, scm_cons(Scheme::slotToSCM(slot), SCM_EOL));
+    return engine->getSlotSCM(scm_to_int(slotId));
 }
 
 SCM Interface::setCards(SCM slotId, SCM newCards)
 {
+    AllocationCounter::Scope counter("set-cards-c!");
     auto *engine = EngineInternals::instance();
-    engine->setCards(scm_to_int(slotId), Scheme::cardsFromSlot(newCards));
+    CardBuffer &cards = engine->cardBuffer();
+    Scheme::cardsFromSlot(newCards, cards);
+    engine->setCards(scm_to_int(slotId), cards);
     return SCM_BOOL_T;
 }
 
@@ -407,17 +461,15 @@ SCM Interface::clickToMoveP(void)
 
 SCM Interface::updateScore(SCM newScore)
 {
+    AllocationCounter::Scope counter("update-score");
     auto *engine = EngineInternals::instance();
-    char *score = scm_to_utf8_string(newScore);
-    bool ok;
-    int value = QString::fromUtf8(score).remove(QRegularExpression("[^0-9]")).toInt(&ok);
-    if (ok) {
+    int value = 0;
+    if (Scheme::getScore(newScore, &value)) {
         engine->setScore(value);
         qCDebug(lcScheme) << "Set score to" << value;
     } else {
-        qCWarning(lcScheme) << "Game sent invalid score:" << score;
+        qCWarning(lcScheme) << "Game sent invalid score:" << Scheme::getUtf8String(newScore);
     }
-    free(score);
     return newScore;
 }
 
@@ -472,3 +524,119 @@ SCM Interface::dealableSetSensitive(SCM state)
     engine->setCanDeal(scm_is_true(state));
     return SCM_EOL;
 }
+
+namespace {
+
+// Checked accessors, scripts pass '() for missing cards and expect a wrong-type-arg error
+inline int cardValue(SCM card)
+{
+    return scm_to_int(scm_car(card));
+}
+
+inline int cardSuit(SCM card)
+{
+    return scm_to_int(scm_cadr(card));
+}
+
+// get-color in api.scm returns neither red nor black for unknown suits
+inline bool isRed(SCM card)
+{
+    int suit = cardSuit(card);
+    return suit == SuitDiamonds || suit == SuitHeart;
+}
+
+inline bool isBlack(SCM card)
+{
+    int suit = cardSuit(card);
+    return suit == SuitClubs || suit == SuitSpade;
+}
+
+// Walks pairs of adjacent cards like the recursive checks in api.scm
+template<typename Check>
+SCM checkList(SCM cards, Check check)
+{
+    for (SCM it = cards; scm_is_pair(it) && scm_is_pair(SCM_CDR(it)); it = SCM_CDR(it)) {
+        if (!check(SCM_CAR(it), SCM_CADR(it)))
+            return SCM_BOOL_F;
+    }
+    return SCM_BOOL_T;
+}
+
+} // namespace
+
+SCM Interface::getCards(SCM slotId)
+{
+    auto *engine = EngineInternals::instance();
+    return SCM_CADR(engine->getSlotSCM(scm_to_int(slotId)));
+}
+
+SCM Interface::emptySlotP(SCM slotId)
+{
+    auto *engine = EngineInternals::instance();
+    return scm_from_bool(engine->getSlot(scm_to_int(slotId)).isEmpty());
+}
+
+SCM Interface::getTopCard(SCM slotId)
+{
+    auto *engine = EngineInternals::instance();
+    const CardBuffer &slot = engine->getSlot(scm_to_int(slotId));
+    return slot.isEmpty() ? SCM_EOL : Scheme::cardToSCM(slot.last());
+}
+
+SCM Interface::isRedP(SCM card)
+{
+    return scm_from_bool(isRed(card));
+}
+
+SCM Interface::isBlackP(SCM card)
+{
+    return scm_from_bool(isBlack(card));
+}
+
+SCM Interface::checkSameSuitList(SCM cards)
+{
+    return checkList(cards, [](SCM first, SCM second) {
+        return cardSuit(first) == cardSuit(second);
+    });
+}
+
+SCM Interface::checkSameColorList(SCM cards)
+{
+    return checkList(cards, [](SCM first, SCM second) {
+        return isRed(first) == isRed(second);
+    });
+}
+
+SCM Interface::checkAlternatingColorList(SCM cards)
+{
+    return checkList(cards, [](SCM first, SCM second) {
+        return isBlack(first) == isRed(second);
+    });
+}
+
+SCM Interface::checkStraightDescendingList(SCM cards)
+{
+    return checkList(cards, [](SCM first, SCM second) {
+        return cardValue(first) == cardValue(second) - 1;
+    });
+}
+
+void Interface::installNativeApi()
+{
+    // Opt-in until games.test gives the same results with both sets of helpers
+    if (qgetenv("PATIENCE_DECK_SCHEME_API") != "native")
+        return;
+
+    // Replace values of the variables so that games and api.scm itself call native versions
+    SCM api = scm_c_resolve_module("aisleriot api");
+    SCM interface = scm_c_resolve_module("aisleriot interface");
+    for (const auto &names : NativeApi) {
+        SCM variable = scm_module_local_variable(api, scm_from_utf8_symbol(names[0]));
+        if (scm_is_false(variable) || scm_is_false(scm_variable_bound_p(variable))) {
+            qCWarning(lcScheme) << "No" << names[0] << "in api to replace";
+            continue;
+        }
+        scm_variable_set_x(variable, scm_variable_ref(scm_c_module_lookup(interface, names[1])));
+    }
+    qCDebug(lcScheme) << "Installed native api helpers";
+}
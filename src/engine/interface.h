@@ -48,6 +48,18 @@ SCM undoSetSensitive(SCM state);
 SCM redoSetSensitive(SCM state);
 SCM dealableSetSensitive(SCM state);
 
+// Native replacements for helpers in aisleriot/games/api.scm
+SCM getCards(SCM slotId);
+SCM emptySlotP(SCM slotId);
+SCM getTopCard(SCM slotId);
+SCM isRedP(SCM card);
+SCM isBlackP(SCM card);
+SCM checkSameSuitList(SCM cards);
+SCM checkSameColorList(SCM cards);
+SCM checkAlternatingColorList(SCM cards);
+SCM checkStraightDescendingList(SCM cards);
+void installNativeApi();
+
 // Initialization
 void init_module(void *data);
 void *init(void *data);
@@ -75,6 +87,19 @@ const char LambdaNames[] = {
   "dealable\0"
 };
 
+// Pairs of api.scm helpers and their native replacements
+const char *const NativeApi[][2] = {
+    { "get-cards", "get-cards-c" },
+    { "empty-slot?", "empty-slot-c?" },
+    { "get-top-card", "get-top-card-c" },
+    { "is-red?", "is-red-c?" },
+    { "is-black?", "is-black-c?" },
+    { "check-same-suit-list", "check-same-suit-list-c" },
+    { "check-same-color-list", "check-same-color-list-c" },
+    { "check-alternating-color-list", "check-alternating-color-list-c" },
+    { "check-straight-descending-list", "check-straight-descending-list-c" },
+};
+
 } // Interface
 
 namespace Scheme {
@@ -86,10 +111,12 @@ SCM catchHandler(void *data, SCM tag, SCM throwArgs);
 // Helpers
 inline QString getMessage(SCM message);
 QString getUtf8String(SCM string);
+bool getScore(SCM score, int *value);
 const CardData createCard(SCM data);
-CardList cardsFromSlot(SCM cards);
+void cardsFromSlot(SCM cards, CardBuffer &buffer);
 SCM cardToSCM(const CardData &card);
 SCM slotToSCM(const CardList &slot);
+SCM slotToSCM(const CardBuffer &slot);
 
 // Calls from C to SCM
 SCM startNewGame(void *data);
@@ -0,0 +1,347 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTimer>
+#include <unistd.h>
+#include "journalstorage.h"
+#include "logging.h"
+#include "recorder.h"
+#include "sessionstore.h"
+
+namespace {
+const auto StateConf = QStringLiteral("/state");
+const auto MovesConfPrefix = QStringLiteral("/moves/");
+const auto SessionsConf = QStringLiteral("/sessions");
+const auto JournalConf = QStringLiteral("/journal");
+const auto JournalFileName = QStringLiteral("state.journal");
+const QByteArray Unescaped = QByteArrayLiteral("/;:+=,");
+const int BatchInterval = 100;
+const int CompactMinimumLines = 256;
+const int CompactRatio = 4;
+
+const QStringList SyncPolicyNames = {
+    QStringLiteral("none"),
+    QStringLiteral("requested"),
+    QStringLiteral("always"),
+};
+
+QString defaultPath()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath(JournalFileName);
+}
+} // namespace
+
+void JournalStorage::addArguments(QCommandLineParser *parser)
+{
+    parser->addOption({"journal-sync", "When to sync the state journal to disk: none, requested or always",
+                       "policy", SyncPolicyNames.at(SyncOnRequest)});
+}
+
+JournalStorage::SyncPolicy JournalStorage::syncPolicy(QCommandLineParser *parser)
+{
+    int index = SyncPolicyNames.indexOf(parser->value("journal-sync"));
+    if (index < 0) {
+        qCWarning(lcJournal) << "Unknown journal sync policy" << parser->value("journal-sync");
+        return SyncOnRequest;
+    }
+    return static_cast<SyncPolicy>(index);
+}
+
+JournalStorage::JournalStorage(Storage *backing, const QString &path, SyncPolicy policy, QObject *parent)
+    : Storage(parent)
+    , m_backing(backing)
+    , m_path(path)
+{
+    m_backing->setParent(this);
+    connect(m_backing, &Storage::valueChanged, this, &Storage::valueChanged);
+
+    if (m_path.isEmpty()) {
+        auto stored = m_backing->value(JournalConf);
+        m_path = stored.isValid() ? stored.toString() : defaultPath();
+    }
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+
+    int lines = load();
+    m_writer = new JournalWriter(m_path, policy, m_values, lines);
+    m_writer->moveToThread(&m_thread);
+    m_thread.setObjectName(QStringLiteral("Journal"));
+    m_thread.start();
+
+    migrate();
+    if (m_backing->value(JournalConf).toString() != m_path) {
+        m_backing->set(JournalConf, m_path);
+        m_backing->sync();
+    }
+}
+
+JournalStorage::~JournalStorage()
+{
+    QMetaObject::invokeMethod(m_writer, "flush", Qt::BlockingQueuedConnection, Q_ARG(bool, true));
+    m_thread.quit();
+    m_thread.wait();
+    delete m_writer;
+}
+
+QString JournalStorage::path() const
+{
+    return m_path;
+}
+
+bool JournalStorage::isJournaled(const QString &key)
+{
+    return key == StateConf || key.startsWith(MovesConfPrefix) || key.startsWith(SessionsConf);
+}
+
+QVariant JournalStorage::value(const QString &key) const
+{
+    if (!isJournaled(key))
+        return m_backing->value(key);
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_values.constFind(key);
+    return it != m_values.constEnd() ? QVariant(*it) : QVariant();
+}
+
+void JournalStorage::set(const QString &key, const QVariant &value)
+{
+    if (!isJournaled(key)) {
+        m_backing->set(key, value);
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (value.isValid())
+        m_values.insert(key, value.toString());
+    else
+        m_values.remove(key);
+    m_writer->enqueue(key, value.toString(), !value.isValid());
+}
+
+// Never waits for the disk, only the destructor does that
+void JournalStorage::sync()
+{
+    if (m_writer->unsynced())
+        QMetaObject::invokeMethod(m_writer, "flush", Qt::QueuedConnection, Q_ARG(bool, true));
+    m_backing->sync();
+}
+
+void JournalStorage::watch(const QString &key)
+{
+    if (!isJournaled(key))
+        m_backing->watch(key);
+}
+
+int JournalStorage::load()
+{
+    QFile file(m_path);
+    if (!file.exists())
+        return 0;
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(lcJournal) << "Can not read journal" << m_path << file.errorString();
+        return 0;
+    }
+
+    QByteArray data = file.readAll();
+    file.close();
+
+    int lines = 0;
+    int pos = 0;
+    while (pos < data.size()) {
+        int end = data.indexOf('\n', pos);
+        JournalWriter::Entry entry;
+        if (end < 0 || !JournalWriter::fromLine(data.mid(pos, end - pos), entry))
+            break;
+        if (entry.removed)
+            m_values.remove(entry.key);
+        else
+            m_values.insert(entry.key, entry.value);
+        lines++;
+        pos = end + 1;
+    }
+
+    if (pos < data.size()) {
+        qCWarning(lcJournal) << "Dropping" << data.size() - pos << "bytes of incomplete journal";
+        if (!QFile::resize(m_path, pos))
+            qCCritical(lcJournal) << "Can not truncate journal" << m_path;
+    }
+    qCDebug(lcJournal) << "Loaded" << m_values.count() << "keys from" << lines << "journal entries";
+    return lines;
+}
+
+void JournalStorage::migrate()
+{
+    // Move state and sessions that were stored before the journal existed
+    if (!m_values.isEmpty())
+        return;
+    QStringList keys = Recorder::storedKeys(m_backing) + SessionStore::storedKeys(m_backing);
+    if (keys.isEmpty())
+        return;
+
+    qCInfo(lcJournal) << "Moving stored state to journal";
+    for (const QString &key : keys)
+        set(key, m_backing->value(key));
+    // State must be on disk before it is removed from the backing storage
+    QMetaObject::invokeMethod(m_writer, "flush", Qt::BlockingQueuedConnection, Q_ARG(bool, true));
+    for (const QString &key : keys)
+        m_backing->set(key, QVariant());
+    m_backing->sync();
+}
+
+QByteArray JournalWriter::toLine(const Entry &entry)
+{
+    QByteArray line;
+    line.append(entry.removed ? '-' : '+');
+    line.append(entry.key.toUtf8().toPercentEncoding(Unescaped));
+    line.append('\t');
+    if (!entry.removed)
+        line.append(entry.value.toUtf8().toPercentEncoding(Unescaped));
+    line.append('\t');
+    line.append(QByteArray::number(qChecksum(line.constData(), line.size()), 16));
+    line.append('\n');
+    return line;
+}
+
+bool JournalWriter::fromLine(const QByteArray &line, Entry &entry)
+{
+    int sep = line.lastIndexOf('\t');
+    if (sep < 0)
+        return false;
+    bool ok = false;
+    quint16 checksum = line.mid(sep + 1).toUShort(&ok, 16);
+    if (!ok || checksum != qChecksum(line.constData(), sep + 1))
+        return false;
+    int valueSep = line.indexOf('\t');
+    if (valueSep == sep || (line.at(0) != '+' && line.at(0) != '-'))
+        return false;
+    entry.removed = line.at(0) == '-';
+    entry.key = QString::fromUtf8(QByteArray::fromPercentEncoding(line.mid(1, valueSep - 1)));
+    entry.value = QString::fromUtf8(QByteArray::fromPercentEncoding(line.mid(valueSep + 1, sep - valueSep - 1)));
+    return true;
+}
+
+JournalWriter::JournalWriter(const QString &path, JournalStorage::SyncPolicy policy,
+                             const QHash<QString, QString> &values, int lines)
+    : m_path(path)
+    , m_policy(policy)
+    , m_file(path)
+    , m_timer(new QTimer(this))
+    , m_values(values)
+    , m_lines(lines)
+    , m_unsynced(false)
+{
+    m_timer->setSingleShot(true);
+    m_timer->setInterval(BatchInterval);
+    connect(m_timer, &QTimer::timeout, this, [this] { flush(); });
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append))
+        qCCritical(lcJournal) << "Can not open journal" << m_path << m_file.errorString();
+}
+
+void JournalWriter::enqueue(const QString &key, const QString &value, bool removed)
+{
+    QMutexLocker locker(&m_mutex);
+    // Coalesce with an earlier write of the same key but keep the order of
+    // the rest so that the journal never refers to state it doesn't have yet
+    for (int i = 0; i < m_pending.count(); i++) {
+        if (m_pending.at(i).key == key) {
+            m_pending.remove(i);
+            break;
+        }
+    }
+    m_pending.append(Entry{key, value, removed});
+    m_unsynced = true;
+    if (m_pending.count() == 1)
+        QMetaObject::invokeMethod(this, "schedule", Qt::QueuedConnection);
+}
+
+// Whether there are journal entries that have not been synced to disk
+bool JournalWriter::unsynced()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_unsynced;
+}
+
+void JournalWriter::schedule()
+{
+    if (!m_timer->isActive())
+        m_timer->start();
+}
+
+void JournalWriter::flush(bool sync)
+{
+    m_timer->stop();
+
+    QVector<Entry> pending;
+    bool synced = sync || m_policy == JournalStorage::SyncEveryBatch;
+    {
+        QMutexLocker locker(&m_mutex);
+        pending.swap(m_pending);
+        if (synced)
+            m_unsynced = false;
+    }
+
+    if (!pending.isEmpty()) {
+        QByteArray data;
+        for (const Entry &entry : pending) {
+            data.append(toLine(entry));
+            if (entry.removed)
+                m_values.remove(entry.key);
+            else
+                m_values.insert(entry.key, entry.value);
+        }
+        if (m_file.write(data) != data.size() || !m_file.flush())
+            qCCritical(lcJournal) << "Failed to write journal" << m_file.errorString();
+        m_lines += pending.count();
+        qCDebug(lcJournal) << "Wrote" << pending.count() << "journal entries," << data.size() << "bytes";
+    }
+
+    if (m_policy == JournalStorage::SyncEveryBatch ? !pending.isEmpty()
+            : m_policy == JournalStorage::SyncOnRequest && sync) {
+        if (fdatasync(m_file.handle()) != 0)
+            qCWarning(lcJournal) << "Failed to sync journal";
+    }
+
+    if (m_lines > CompactMinimumLines && m_lines > CompactRatio * m_values.count())
+        compact();
+}
+
+void JournalWriter::compact()
+{
+    QSaveFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(lcJournal) << "Can not compact journal" << file.errorString();
+        return;
+    }
+    for (auto it = m_values.constBegin(); it != m_values.constEnd(); ++it)
+        file.write(toLine(Entry{it.key(), it.value(), false}));
+    // QSaveFile syncs and replaces the journal atomically
+    if (!file.commit()) {
+        qCWarning(lcJournal) << "Failed to compact journal" << file.errorString();
+        return;
+    }
+
+    qCDebug(lcJournal) << "Compacted journal from" << m_lines << "to" << m_values.count() << "entries";
+    m_lines = m_values.count();
+    m_file.close();
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append))
+        qCCritical(lcJournal) << "Can not open journal" << m_path << m_file.errorString();
+}
@@ -0,0 +1,120 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JOURNALSTORAGE_H
+#define JOURNALSTORAGE_H
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include "storage.h"
+
+class QCommandLineParser;
+class QTimer;
+class JournalWriter;
+
+/*
+ * Storage that keeps recorded game state in an append-only journal file.
+ *
+ * Game state is served from memory and written to the journal in batches on
+ * a separate thread so that saving never waits for the disk or D-Bus. Other
+ * keys and the location of the journal are kept in the backing storage.
+ * A torn write at the end of the journal is dropped when it is loaded.
+ */
+class JournalStorage : public Storage
+{
+    Q_OBJECT
+
+public:
+    enum SyncPolicy {
+        NoSync,
+        SyncOnRequest,
+        SyncEveryBatch,
+    };
+
+    static void addArguments(QCommandLineParser *parser);
+    static SyncPolicy syncPolicy(QCommandLineParser *parser);
+
+    explicit JournalStorage(Storage *backing, const QString &path = QString(),
+                            SyncPolicy policy = SyncOnRequest, QObject *parent = nullptr);
+    ~JournalStorage();
+
+    QVariant value(const QString &key) const override;
+    void set(const QString &key, const QVariant &value) override;
+    void sync() override;
+    void watch(const QString &key) override;
+
+    QString path() const;
+
+private:
+    static bool isJournaled(const QString &key);
+    int load();
+    void migrate();
+
+    Storage *m_backing;
+    QString m_path;
+    mutable QMutex m_mutex;
+    QHash<QString, QString> m_values;
+    QThread m_thread;
+    JournalWriter *m_writer;
+};
+
+class JournalWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Entry {
+        QString key;
+        QString value;
+        bool removed;
+    };
+
+    static QByteArray toLine(const Entry &entry);
+    static bool fromLine(const QByteArray &line, Entry &entry);
+
+    JournalWriter(const QString &path, JournalStorage::SyncPolicy policy,
+                  const QHash<QString, QString> &values, int lines);
+
+    void enqueue(const QString &key, const QString &value, bool removed);
+    bool unsynced();
+
+public slots:
+    void flush(bool sync = false);
+
+private slots:
+    void schedule();
+
+private:
+    void compact();
+
+    QString m_path;
+    JournalStorage::SyncPolicy m_policy;
+    QFile m_file;
+    QTimer *m_timer;
+    QMutex m_mutex;
+    QVector<Entry> m_pending;
+    QHash<QString, QString> m_values;
+    int m_lines;
+    bool m_unsynced;
+};
+
+#endif // JOURNALSTORAGE_H
@@ -17,22 +17,116 @@
 
 #include <QRegularExpression>
 #include <QTimer>
-#include "constants.h"
+#include "archive.h"
 #include "engine.h"
-#include "gameoptionmodel.h"
+#include "engineinternals.h"
 #include "logging.h"
-#ifndef ENGINE_EXERCISER
-#include "patience.h"
-#endif // ENGINE_EXERCISER
 #include "recorder.h"
+#include "statistics.h"
+#include "storage.h"
+#include "trace.h"
 
 namespace {
-const auto DataVersion = QStringLiteral("0");
+const auto LegacyDataVersion = QStringLiteral("0");
+const auto DataVersion = QStringLiteral("1");
+const auto LogPrefix = QStringLiteral("1:");
 const auto MovesTemplate = QStringLiteral("%1:%2");
 const int MovesBetweenSaves = 10;
+const int MaxChunks = 64;
+const int CheckpointInterval = 16;
+const int MaxSessions = 10;
+const int SessionMemoryBudget = 64 * 1024;
+const int SessionDiskBudget = 256 * 1024;
 const qint64 MoveTimeout = 30 * 1000;
 const qint64 MinimumSaveInterval = 1000;
 const quint32 ID = -1;
+const auto StateConf = QStringLiteral("/state");
+const auto ChunkConf = QStringLiteral("/moves/%1");
+const auto GenerationChunkConf = QStringLiteral("/moves/%1-%2");
+
+// Move to stop restoring at and archive to append left games to, set from command line
+int s_seek = -1;
+QString s_archive;
+
+/*
+ * Binary move log, version 1
+ *
+ * Each record starts with a byte that has the record type in the lowest
+ * three bits. For moves and undos the upper five bits hold the card or record
+ * count if it fits, otherwise they are zero and the count follows as a varint.
+ * Slot ids follow as varints: start and end slot for moves and the slot for
+ * clicks and double clicks. Undo records drop records written before them so
+ * that saving after undoing moves only needs to append.
+ */
+enum LogType : quint8 {
+    LogDeal = 1,
+    LogMove = 2,
+    LogClick = 3,
+    LogDoubleClick = 4,
+    LogUndo = 5,
+};
+const quint8 LogTypeMask = 0x07;
+const int LogCountShift = 3;
+const quint32 LogCountMax = 0xff >> LogCountShift;
+
+void appendVarint(QByteArray &data, quint32 value)
+{
+    while (value >= 0x80) {
+        data.append(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    data.append(static_cast<char>(value));
+}
+
+bool readVarint(const QByteArray &data, int &pos, quint32 &value)
+{
+    value = 0;
+    for (int shift = 0; pos < data.size() && shift < 32; shift += 7) {
+        quint8 byte = data.at(pos++);
+        value |= quint32(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+void appendHeader(QByteArray &data, LogType type)
+{
+    data.append(static_cast<char>(type));
+}
+
+void appendHeader(QByteArray &data, LogType type, quint32 count)
+{
+    if (count > 0 && count <= LogCountMax) {
+        data.append(static_cast<char>(type | (count << LogCountShift)));
+    } else {
+        data.append(static_cast<char>(type));
+        appendVarint(data, count);
+    }
+}
+
+bool readCount(const QByteArray &data, int &pos, quint8 header, quint32 &count)
+{
+    count = header >> LogCountShift;
+    return count > 0 || readVarint(data, pos, count);
+}
+
+/*
+ * A rewritten log goes to the other generation of keys and the stored state
+ * is switched to it last, so that the state never names a mix of old and
+ * new chunks even if the rest is not written. Generation 0 uses the keys of
+ * older versions.
+ */
+QString chunkKey(int generation, int chunk)
+{
+    return generation ? GenerationChunkConf.arg(generation).arg(chunk) : ChunkConf.arg(chunk);
+}
+
+void removeChunks(Storage *storage, int generation, int first)
+{
+    for (int chunk = first; storage->value(chunkKey(generation, chunk)).isValid(); chunk++)
+        storage->set(chunkKey(generation, chunk), QVariant());
+}
 
 QString encode(const QString &text)
 {
@@ -51,20 +145,25 @@ struct SavedState {
     bool hasSeed;
     bool seedOk;
     qint64 time;
-    QString moves;
+    QString moves; // Version 0 text records
+    QByteArray log; // Version 1 binary records
+    int chunks;
+    int generation;
 
     SavedState(const QString &gameFile = QString(),
                quint32 seed = 0,
                bool hasSeed = false,
                qint64 time = 0,
-               QString moves = QString())
+               int chunks = 0,
+               int generation = 0)
         : valid(false)
         , gameFile(gameFile)
         , seed(seed)
         , hasSeed(hasSeed)
         , seedOk(true)
         , time(time)
-        , moves(moves) {}
+        , chunks(chunks)
+        , generation(generation) {}
 
     QString toString(bool encoded = true) const
     {
@@ -74,11 +173,40 @@ struct SavedState {
             parts << QString::number(seed);
         if (!moves.isEmpty()) {
             auto data = MovesTemplate.arg(time).arg(moves);
-            parts << DataVersion << (encoded ? encode(data) : data);
+            parts << LegacyDataVersion << (encoded ? encode(data) : data);
+        } else if (chunks > 0) {
+            parts << DataVersion << QString::number(time) << QString::number(chunks);
+            if (generation)
+                parts << QString::number(generation);
         }
         return parts.join(';');
     }
 
+    void store(Storage *storage)
+    {
+        int previous = storedGeneration(storage);
+        generation = nextGeneration(previous);
+        if (!log.isEmpty()) {
+            storage->set(chunkKey(generation, 0), QString::fromLatin1(log.toBase64()));
+            chunks = 1;
+        } else {
+            chunks = 0;
+        }
+        storage->set(StateConf, toString());
+        removeChunks(storage, previous, 0);
+        removeChunks(storage, generation, chunks);
+    }
+
+    static int storedGeneration(const Storage *storage)
+    {
+        return fromString(storage->value(StateConf).toString()).generation;
+    }
+
+    static int nextGeneration(int generation)
+    {
+        return generation ? 0 : 1;
+    }
+
     static SavedState fromString(const QString &state)
     {
         SavedState saved;
@@ -89,59 +217,66 @@ struct SavedState {
             if (parts.count() >= 2) {
                 saved.hasSeed = true;
                 saved.seed = parts.at(1).toULongLong(&saved.seedOk);
-                if (saved.seedOk && parts.count() >= 4 && parts.at(2) == DataVersion) {
+                if (saved.seedOk && parts.count() >= 4 && parts.at(2) == LegacyDataVersion) {
                     QString moves = decode(parts.at(3));
                     int sep = moves.indexOf(':');
                     bool ok = false;
                     saved.time = moves.left(sep).toLongLong(&ok);
                     if (ok)
                         saved.moves = moves.mid(sep + 1);
+                } else if (saved.seedOk && parts.count() >= 5 && parts.at(2) == DataVersion) {
+                    bool ok = false;
+                    saved.time = parts.at(3).toLongLong(&ok);
+                    if (ok)
+                        saved.chunks = parts.at(4).toInt(&ok);
+                    if (ok && parts.count() >= 6)
+                        saved.generation = parts.at(5).toInt(&ok);
+                    if (!ok) {
+                        saved.chunks = 0;
+                        saved.generation = 0;
+                    }
                 }
             }
         }
         return saved;
     }
 
-#ifndef ENGINE_EXERCISER
-    static SavedState fromConfItem(const MGConfItem &stateConf)
+    static SavedState fromStorage(const Storage *storage)
     {
-        auto state = stateConf.value();
-        if (state.isValid())
-            return fromString(state.toString());
-        return SavedState();
+        auto value = storage->value(StateConf);
+        if (!value.isValid())
+            return SavedState();
+        SavedState state = fromString(value.toString());
+        for (int chunk = 0; chunk < state.chunks; chunk++)
+            state.log.append(QByteArray::fromBase64(storage->value(chunkKey(state.generation, chunk)).toString().toLatin1()));
+        return state;
     }
-#endif // ENGINE_EXERCISER
 };
 } // namespace
 
-const QString StateConf = QStringLiteral("/state");
-
 Recorder::Recorder(Engine *engine)
     : QObject(engine)
     , m_replaying(0)
-#ifndef ENGINE_EXERCISER
-    , m_stateConf(Constants::ConfPath + StateConf)
-#endif // ENGINE_EXERCISER
+    , m_seeking(false)
     , m_hasSeed(false)
     , m_seed(0)
     , m_moves(0)
+    , m_chunks(-1)
+    , m_saved(0)
+    , m_stable(0)
+    , m_result(ArchiveEntry::Unfinished)
+    , m_sessions(MaxSessions, SessionMemoryBudget, SessionDiskBudget)
 {
     connect(engine, &Engine::gameLoaded, this, &Recorder::handleGameLoaded, Qt::DirectConnection);
     connect(engine, &Engine::gameStarted, this, &Recorder::handleGameStarted, Qt::DirectConnection);
     connect(engine, &Engine::moveEnded, this, &Recorder::handleMoveEnded, Qt::QueuedConnection);
     connect(engine, &Engine::gameOver, this, &Recorder::handleGameOver, Qt::QueuedConnection);
-
-#ifndef ENGINE_EXERCISER
-    connect(&m_stateConf, &MGConfItem::valueChanged, this, [&]() {
-        qCDebug(lcRecorder) << (m_stateConf.value().isValid()
-                              ? "Saved engine state" : "Reset saved state");
-    });
-#endif // ENGINE_EXERCISER
 }
 
 Recorder::~Recorder()
 {
     save();
+    archiveOldState();
 }
 
 void Recorder::startReplay()
@@ -155,6 +290,21 @@ void Recorder::replayMove()
 {
     qCDebug(lcRecorder) << "Replaying first move";
     m_replaying = 1;
+    checkpoint();
+    if (!m_resumeState.isEmpty()) {
+        // Jump straight to the position of a resumed session instead of replaying every move
+        QByteArray state;
+        state.swap(m_resumeState);
+        if (EngineInternals::instance()->restoreState(state)) {
+            qCDebug(lcRecorder) << "Restored stored position after" << m_records.count() << "moves";
+            m_replaying = m_records.count() + 1;
+            EngineInternals::instance()->storeCheckpoint(m_records.count());
+        } else if (m_replaying) {
+            qCWarning(lcRecorder) << "Can not restore stored position, replaying moves";
+        } else {
+            return; // Engine failed while restoring
+        }
+    }
     replaySingle();
 }
 
@@ -163,27 +313,117 @@ bool Recorder::replaying() const
     return m_replaying;
 }
 
+bool Recorder::seek(int move)
+{
+    if (m_replaying) {
+        qCWarning(lcRecorder) << "Can not seek while replaying";
+        return false;
+    }
+
+    // Keep the whole game while seeking back and forth
+    if (m_review.isEmpty()) {
+        m_review = m_records;
+        for (int i = m_abandoned.count() - 1; i >= 0; i--)
+            m_review.append(m_abandoned.at(i));
+    }
+    if (move < 0 || move > m_review.count()) {
+        qCWarning(lcRecorder) << "Can not seek to move" << move << "of" << m_review.count();
+        return false;
+    }
+
+    int restored = EngineInternals::instance()->restoreCheckpoint(move);
+    if (restored < 0) {
+        qCWarning(lcRecorder) << "No checkpoint to seek to move" << move;
+        return false;
+    }
+
+    qCDebug(lcRecorder) << "Seeking to move" << move << "from checkpoint at" << restored;
+    m_records = m_review.mid(0, move);
+    m_abandoned.clear();
+    m_stable = qMin(m_stable, move);
+    m_moves++;
+    m_seeking = true;
+    m_replaying = restored + 1;
+    replaySingle();
+    return true;
+}
+
+int Recorder::position() const
+{
+    return m_replaying ? m_replaying - 1 : m_records.count();
+}
+
 bool Recorder::load()
 {
-#ifndef ENGINE_EXERCISER
-    auto state = SavedState::fromConfItem(m_stateConf);
+    m_resumeState.clear();
+    m_result = ArchiveEntry::Unfinished;
+    m_records.clear();
+    m_abandoned.clear();
+    m_review.clear();
+    auto state = SavedState::fromStorage(engine()->storage());
     qCDebug(lcRecorder) << "Loaded state" << state.toString(false);
     if (state.valid) {
         if (state.seedOk) {
             if (!state.moves.isEmpty()) {
                 for (const QString &record : state.moves.split(','))
                     m_records.append(Record::fromString(record));
+            } else if (!state.log.isEmpty()) {
+                if (!Record::readLog(state.log, m_records)) {
+                    qCCritical(lcRecorder) << "Invalid stored move log";
+                    m_records.append(Record());
+                }
+            }
+            if (state.chunks > 0 && state.chunks < MaxChunks) {
+                // Continue appending to the stored log
+                m_chunks = state.chunks;
+                m_saved = m_stable = m_records.count();
+            }
+            if (s_seek >= 0 && s_seek < m_records.count()) {
+                qCDebug(lcRecorder) << "Restoring up to move" << s_seek << "of" << m_records.count();
+                m_review = m_records;
+                m_records.resize(s_seek);
+                m_stable = qMin(m_stable, s_seek);
             }
+            s_seek = -1;
             emit replayingGame(state.gameFile, state.hasSeed, state.seed, state.time);
             return true;
         }
     } else {
         qCInfo(lcRecorder) << "Engine state was not stored, not restored";
     }
-#endif // ENGINE_EXERCISER
     return false;
 }
 
+void Recorder::archive(const OldState &state)
+{
+    if (m_archive.isNull())
+        m_archive.reset(new ArchiveWriter(s_archive));
+
+    ArchiveEntry entry;
+    entry.gameFile = state.gameFile;
+    entry.seed = state.seed;
+    entry.options = state.options;
+    entry.time = state.time;
+    entry.result = state.result;
+    QByteArray log;
+    for (const Record &record : state.records)
+        record.appendTo(log);
+    if (!log.isEmpty())
+        entry.moves = LogPrefix + QString::fromLatin1(log.toBase64());
+    if (m_archive->write(entry))
+        qCDebug(lcRecorder) << "Archived game" << state.gameFile << "with" << state.records.count() << "moves";
+}
+
+/*
+ * A deal is archived once it can not be continued anymore, i.e. when the
+ * previous game that a new deal replaced is dropped
+ */
+void Recorder::archiveOldState()
+{
+    if (!s_archive.isEmpty() && !m_oldState.isNull() && !m_oldState->restoring())
+        archive(*m_oldState);
+}
+
 void Recorder::replaySingle()
 {
     if (!m_replaying) {
@@ -192,12 +432,14 @@ void Recorder::replaySingle()
     }
 
     if (m_replaying > (uint)m_records.count()) {
-        emit replayCompleted(Success);
+        emit replayCompleted(m_seeking ? SeekCompleted : Success);
+        m_seeking = false;
         m_replaying = 0;
         return;
     }
 
     const Record &record = current();
+    Trace::record(Trace::ReplayStep, 0, m_replaying, record.type);
     switch (record.type) {
     case None:
         qCCritical(lcRecorder) << "Invalid Record";
@@ -266,26 +508,62 @@ Engine *Recorder::engine() const
     return qobject_cast<Engine *>(parent());
 }
 
+void Recorder::append(const Record &record)
+{
+    // A new move makes the positions after it unreachable
+    EngineInternals::instance()->dropCheckpoints(m_records.count());
+    m_review.clear();
+    m_records.append(record);
+    m_abandoned.clear();
+}
+
+void Recorder::checkpoint()
+{
+    int move = position();
+    if (move % CheckpointInterval == 0)
+        EngineInternals::instance()->storeCheckpoint(move);
+}
+
 void Recorder::clear()
 {
+    EngineInternals::instance()->dropCheckpoints();
+    m_resumeState.clear();
+    m_result = ArchiveEntry::Unfinished;
     m_records.clear();
     m_abandoned.clear();
+    m_review.clear();
+    m_chunks = -1;
     m_moves++; // Count clear() as a move to force save()
 }
 
 void Recorder::save()
 {
     if (!m_elapsed.isValid() || m_elapsed.hasExpired(MinimumSaveInterval) || m_moves) {
-        QStringList records;
-        for (const Record &record : m_records)
-            records << record.toString();
-#ifndef ENGINE_EXERCISER
-        // Take elapsed time from another thread :E
-        // This is fine. Trust me, I'm an engineer. ;)
-        // (Patience instance is not going anywhere so we get away with this.)
-        m_stateConf.set(SavedState(m_gameFile, m_seed, m_hasSeed, Patience::instance()->elapsedTimeMs(),
-                                   records.join(',')).toString());
-#endif // ENGINE_EXERCISER
+        auto storage = engine()->storage();
+        bool rewrite = m_chunks < 0 || m_chunks >= MaxChunks;
+        int previous = SavedState::storedGeneration(storage);
+        int generation = rewrite ? SavedState::nextGeneration(previous) : previous;
+        if (rewrite) {
+            m_chunks = 0;
+            m_saved = m_stable = 0;
+        }
+        // Append only what changed since the last save
+        QByteArray chunk;
+        if (m_saved > m_stable)
+            appendHeader(chunk, LogUndo, m_saved - m_stable);
+        for (int i = m_stable; i < m_records.count(); i++)
+            m_records.at(i).appendTo(chunk);
+        if (!chunk.isEmpty())
+            storage->set(chunkKey(generation, m_chunks++), QString::fromLatin1(chunk.toBase64()));
+        storage->set(StateConf, SavedState(m_gameFile, m_seed, m_hasSeed, engine()->elapsedTime(),
+                                           m_chunks, generation).toString());
+        if (rewrite) {
+            // Nothing refers to the old chunks anymore
+            removeChunks(storage, previous, 0);
+            removeChunks(storage, generation, m_chunks);
+        }
+        m_saved = m_stable = m_records.count();
+        qCDebug(lcRecorder) << "Saved engine state with" << chunk.size() << "new bytes in" << m_chunks << "chunks";
         m_moves = 0;
         m_elapsed.start();
     }
@@ -296,6 +574,7 @@ void Recorder::fail()
     qCWarning(lcRecorder) << "Failed to restore game, abandoning state and resetting engine";
     clear();
     m_replaying = 0;
+    m_seeking = false;
     emit replayCompleted(NeedsRestart);
     save();
 }
@@ -317,7 +596,9 @@ void Recorder::storeOldState()
 {
     // Store only if there is a new state to store
     if ((m_oldState.isNull() || !m_oldState->restoring()) && !m_replaying && m_hasSeed) {
-        m_oldState.reset(new OldState(m_records, m_seed, Patience::instance()->elapsedTimeMs()));
+        archiveOldState();
+        m_oldState.reset(new OldState(m_records, m_seed, engine()->elapsedTime(), m_result,
+                                      m_gameFile, engine()->storage()->storedOptions(m_gameFile)));
         qCDebug(lcRecorder) << "Stored old state";
         emit oldStateStored(true);
     }
@@ -328,7 +609,11 @@ void Recorder::restoreOldState()
     // Restore only if there was a state to restore
     if (!m_oldState.isNull()) {
         m_records = m_oldState->records;
+        m_resumeState.clear();
+        m_result = m_oldState->result;
         m_abandoned.clear();
+        m_review.clear();
+        m_chunks = -1;
         m_hasSeed = true;
         m_seed = m_oldState->seed;
         m_moves = 0;
@@ -336,7 +621,7 @@ void Recorder::restoreOldState()
         m_oldState->setRestoring();
         qCDebug(lcRecorder) << "Restored old state";
         emit oldStateStored(false);
-        emit replayingGame(m_gameFile, true, m_oldState->seed, time);
+        emit replayingGame(m_oldState->gameFile, true, m_oldState->seed, time);
         m_oldState.reset();
     }
 }
@@ -344,12 +629,54 @@ void Recorder::restoreOldState()
 void Recorder::dropOldState()
 {
     if (!m_oldState.isNull()) {
+        archiveOldState();
         m_oldState.reset();
         qCDebug(lcRecorder) << "Dropped old state";
         emit oldStateStored(false);
     }
 }
 
+void Recorder::parkSession()
+{
+    if (m_replaying || !m_hasSeed || m_records.isEmpty() || m_gameFile.isEmpty())
+        return;
+
+    SessionStore::Session session;
+    session.seed = m_seed;
+    session.time = engine()->elapsedTime();
+    for (const Record &record : m_records)
+        record.appendTo(session.log);
+    session.state = EngineInternals::instance()->storeState();
+    m_sessions.park(engine()->storage(), m_gameFile, session);
+}
+
+bool Recorder::resumeSession(const QString &gameFile, quint32 &seed, qint64 &time)
+{
+    SessionStore::Session session;
+    if (!m_sessions.take(engine()->storage(), gameFile, session))
+        return false;
+
+    QVector<Record> records;
+    if (!Record::readLog(session.log, records) || records.isEmpty()) {
+        qCWarning(lcRecorder) << "Invalid session for" << gameFile;
+        return false;
+    }
+
+    qCDebug(lcRecorder) << "Resuming session for" << gameFile << "with" << records.count() << "moves"
+                        << (session.state.isEmpty() ? "without" : "with") << "stored position";
+    m_records = records;
+    m_resumeState = session.state;
+    m_result = ArchiveEntry::Unfinished;
+    m_abandoned.clear();
+    m_review.clear();
+    m_chunks = -1;
+    m_moves++;
+    // Seed is stored when the engine resets its generator with it
+    seed = session.seed;
+    time = session.time;
+    return true;
+}
+
 void Recorder::handleGameLoaded(const QString &gameFile)
 {
     m_gameFile = gameFile;
@@ -359,8 +686,10 @@ void Recorder::handleGameStarted()
 {
     if (!m_replaying) {
         qCDebug(lcRecorder) << "Game started, resetting recorded state";
+        m_sessions.remove(engine()->storage(), m_gameFile);
         clear();
         save();
+        checkpoint();
     }
 }
 
@@ -369,17 +698,23 @@ void Recorder::handleMoveEnded()
     if (!m_replaying) {
         if (++m_moves >= MovesBetweenSaves || m_elapsed.hasExpired(MoveTimeout))
             save();
+        checkpoint();
     } else {
+        checkpoint();
         QTimer::singleShot(0, this, [this] {
             replaySingle();
         });
     }
 }
 
-void Recorder::handleGameOver()
+void Recorder::handleGameOver(bool won)
 {
-    if (!m_replaying)
+    if (!m_replaying) {
         save();
+        if (Statistics *statistics = engine()->statistics())
+            statistics->record(m_gameFile, m_seed, won, engine()->elapsedTime(), m_records.count());
+        m_result = won ? ArchiveEntry::Won : ArchiveEntry::Lost;
+    }
 }
 
 void Recorder::handleEngineFailure()
@@ -392,8 +727,12 @@ void Recorder::handleEngineFailure()
 
 void Recorder::undo()
 {
-    if (!m_replaying && !m_records.empty())
+    if (!m_replaying && !m_records.empty()) {
+        // The game continues, so it has no result until it ends again
+        m_result = ArchiveEntry::Unfinished;
         m_abandoned.append(m_records.takeLast());
+        m_stable = qMin(m_stable, m_records.count());
+    }
 }
 
 void Recorder::redo()
@@ -404,34 +743,26 @@ void Recorder::redo()
 
 void Recorder::recordDeal()
 {
-    if (!m_replaying) {
-        m_records.append(Record::deal());
-        m_abandoned.clear();
-    }
+    if (!m_replaying)
+        append(Record::deal());
 }
 
 void Recorder::recordDrop(int startSlotId, int endSlotId, int cards)
 {
-    if (!m_replaying) {
-        m_records.append(Record::move(startSlotId, endSlotId, cards));
-        m_abandoned.clear();
-    }
+    if (!m_replaying)
+        append(Record::move(startSlotId, endSlotId, cards));
 }
 
 void Recorder::recordClick(int slotId)
 {
-    if (!m_replaying) {
-        m_records.append(Record::click(slotId));
-        m_abandoned.clear();
-    }
+    if (!m_replaying)
+        append(Record::click(slotId));
 }
 
 void Recorder::recordDoubleClick(int slotId)
 {
-    if (!m_replaying) {
-        m_records.append(Record::doubleClick(slotId));
-        m_abandoned.clear();
-    }
+    if (!m_replaying)
+        append(Record::doubleClick(slotId));
 }
 
 void Recorder::addArguments(QCommandLineParser *parser)
@@ -441,17 +772,28 @@ void Recorder::addArguments(QCommandLineParser *parser)
         {{"s", "seed"}, "Set initial seed to load", "integer"},
         {{"m", "moves"}, "Recorded moves to make", "moves"},
         {{"t", "time"}, "Recorded time to set", "time"},
-        {{"o", "options"}, "Indices of options to set before loading game", "options"}
+        {{"o", "options"}, "Indices of options to set before loading game", "options"},
+        {"seek", "Stop restoring recorded moves at this move", "move"},
+        {"archive", "Append games to an archive file once they are left", "filename"}
     });
 }
 
-void Recorder::setArguments(QCommandLineParser *parser)
+// Keys of the stored state and the chunks of its current generation
+QStringList Recorder::storedKeys(const Storage *storage)
 {
-#ifdef ENGINE_EXERCISER
-    Q_UNUSED(parser)
-#else
-    MGConfItem stateConf(Constants::ConfPath + StateConf);
-    SavedState state = SavedState::fromConfItem(stateConf);
+    QStringList keys;
+    if (!storage->value(StateConf).isValid())
+        return keys;
+    keys << StateConf;
+    int generation = SavedState::storedGeneration(storage);
+    for (int chunk = 0; storage->value(chunkKey(generation, chunk)).isValid(); chunk++)
+        keys << chunkKey(generation, chunk);
+    return keys;
+}
+
+void Recorder::setArguments(QCommandLineParser *parser, Storage *storage)
+{
+    SavedState state = SavedState::fromStorage(storage);
     if (parser->isSet("game"))
         state.gameFile = parser->value("game");
     if (parser->isSet("seed")) {
@@ -460,21 +802,34 @@ void Recorder::setArguments(QCommandLineParser *parser)
     }
     if (parser->isSet("moves")) {
         auto moves = parser->value("moves");
-        if (!moves.contains(':') && !moves.contains(',') && moves != "D") {
-            moves = decode(moves.toUtf8());
-            if (moves.at(0).isDigit())
-                moves = moves.mid(moves.indexOf(':') + 1);
+        state.log.clear();
+        state.moves.clear();
+        if (moves.startsWith(LogPrefix)) {
+            for (const QString &chunk : moves.mid(LogPrefix.length()).split(','))
+                state.log.append(QByteArray::fromBase64(chunk.toLatin1()));
+        } else {
+            if (!moves.contains(':') && !moves.contains(',') && moves != "D") {
+                moves = decode(moves.toUtf8());
+                if (moves.at(0).isDigit())
+                    moves = moves.mid(moves.indexOf(':') + 1);
+            }
+            state.moves = moves;
         }
-        state.moves = moves;
     }
-    else if (parser->isSet("game") || parser->isSet("seed"))
+    else if (parser->isSet("game") || parser->isSet("seed")) {
         // invalidate moves
         state.moves.clear();
+        state.log.clear();
+    }
     if (parser->isSet("time"))
         state.time = parser->value("time").toLongLong();
+    if (parser->isSet("seek"))
+        s_seek = parser->value("seek").toInt();
+    if (parser->isSet("archive"))
+        s_archive = parser->value("archive");
     if (parser->isSet("game") || parser->isSet("seed") || parser->isSet("moves")) {
-        stateConf.set(state.toString());
-        stateConf.sync();
+        state.store(storage);
+        storage->sync();
     }
     if (!state.gameFile.isEmpty() && parser->isSet("options")) {
         GameOptionList options;
@@ -489,9 +844,8 @@ void Recorder::setArguments(QCommandLineParser *parser)
                 options << option;
             }
         }
-        GameOptionModel::saveOptions(state.gameFile, options);
+        storage->saveOptions(state.gameFile, options);
     }
-#endif // ENGINE_EXERCISER
 }
 
 Recorder::Record Recorder::Record::fromString(const QString &record)
@@ -551,3 +905,65 @@ QString Recorder::Record::toString() const
     }
     return record.join(':');
 }
+
+void Recorder::Record::appendTo(QByteArray &log) const
+{
+    switch (type) {
+    case Deal:
+        appendHeader(log, LogDeal);
+        break;
+    case Move:
+        appendHeader(log, LogMove, cards);
+        appendVarint(log, startSlot);
+        appendVarint(log, endSlot);
+        break;
+    case Click:
+        appendHeader(log, LogClick);
+        appendVarint(log, startSlot);
+        break;
+    case DoubleClick:
+        appendHeader(log, LogDoubleClick);
+        appendVarint(log, startSlot);
+        break;
+    case None:
+        qCCritical(lcRecorder) << "Invalid record";
+        break;
+    }
+}
+
+bool Recorder::Record::readLog(const QByteArray &log, QVector<Record> &records)
+{
+    int pos = 0;
+    while (pos < log.size()) {
+        quint8 header = log.at(pos++);
+        quint32 count, start, end;
+        switch (header & LogTypeMask) {
+        case LogDeal:
+            records.append(deal());
+            break;
+        case LogMove:
+            if (!readCount(log, pos, header, count) || !readVarint(log, pos, start) || !readVarint(log, pos, end))
+                return false;
+            records.append(move(start, end, count));
+            break;
+        case LogClick:
+            if (!readVarint(log, pos, start))
+                return false;
+            records.append(click(start));
+            break;
+        case LogDoubleClick:
+            if (!readVarint(log, pos, start))
+                return false;
+            records.append(doubleClick(start));
+            break;
+        case LogUndo:
+            if (!readCount(log, pos, header, count) || count > uint(records.count()))
+                return false;
+            records.resize(records.count() - count);
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
@@ -18,17 +18,17 @@
 #ifndef RECORDER_H
 #define RECORDER_H
 
-#ifndef ENGINE_EXERCISER
-#include <MGConfItem>
-#endif // ENGINE_EXERCISER
 #include <QCommandLineParser>
 #include <QElapsedTimer>
 #include <QObject>
 #include <QVector>
 #include <QScopedPointer>
+#include "archive.h"
 #include "enginedata.h"
+#include "sessionstore.h"
 
 class Engine;
+class Storage;
 class Recorder : public QObject
 {
     Q_OBJECT
@@ -38,10 +38,12 @@ public:
         Failed,
         Success,
         NeedsRestart,
+        SeekCompleted,
     };
 
     static void addArguments(QCommandLineParser *parser);
-    static void setArguments(QCommandLineParser *parser);
+    static void setArguments(QCommandLineParser *parser, Storage *storage);
+    static QStringList storedKeys(const Storage *storage);
 
     Recorder(Engine *engine);
     ~Recorder();
@@ -49,6 +51,8 @@ public:
     void startReplay();
     void replayMove();
     bool replaying() const;
+    bool seek(int move);
+    int position() const;
 
     void save();
     void undo();
@@ -66,6 +70,9 @@ public:
     void restoreOldState();
     void dropOldState();
 
+    void parkSession();
+    bool resumeSession(const QString &gameFile, quint32 &seed, qint64 &time);
+
 signals:
     void replayCompleted(CompletionStatus status);
     void replayingGame(const QString &gameFile, bool hasSeed, quint32 seed, qint64 time);
@@ -75,7 +82,7 @@ public slots:
     void handleGameLoaded(const QString &gameFile);
     void handleGameStarted();
     void handleMoveEnded();
-    void handleGameOver();
+    void handleGameOver(bool won);
     void handleEngineFailure();
 
 private:
@@ -111,24 +118,39 @@ private:
 
         static Record fromString(const QString &record);
         QString toString() const;
+
+        static bool readLog(const QByteArray &log, QVector<Record> &records);
+        void appendTo(QByteArray &log) const;
     };
 
+    // Game that a new deal replaced, kept with its game file and options as other games may be loaded
     struct OldState {
         QVector<Record> records;
         quint32 seed;
         qint64 time;
+        ArchiveEntry::Result result;
+        QString gameFile;
+        QString options;
 
-        OldState(QVector<Record> records, quint32 seed, qint64 time)
+        OldState(QVector<Record> records, quint32 seed, qint64 time, ArchiveEntry::Result result,
+                 const QString &gameFile, const QString &options)
             : records(records)
             , seed(seed)
-            , time(time) {}
+            , time(time)
+            , result(result)
+            , gameFile(gameFile)
+            , options(options) {}
 
         bool restoring() { return time == -1; }
         void setRestoring() { time = -1; }
     };
 
     bool load();
+    void archive(const OldState &state);
+    void archiveOldState();
     void replaySingle();
+    void append(const Record &record);
+    void checkpoint();
     void clear();
     void fail();
 
@@ -138,15 +160,21 @@ private:
     uint m_replaying;
     QVector<Record> m_records;
     QVector<Record> m_abandoned;
-#ifndef ENGINE_EXERCISER
-    MGConfItem m_stateConf;
-#endif // ENGINE_EXERCISER
+    QVector<Record> m_review;
+    QByteArray m_resumeState;
+    bool m_seeking;
     QString m_gameFile;
     bool m_hasSeed;
     quint32 m_seed;
     int m_moves;
+    int m_chunks;
+    int m_saved;
+    int m_stable;
+    ArchiveEntry::Result m_result;
     QElapsedTimer m_elapsed;
     QScopedPointer<OldState> m_oldState;
+    SessionStore m_sessions;
+    QScopedPointer<ArchiveWriter> m_archive;
 };
 
 #endif // RECORDER_H
@@ -0,0 +1,198 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QStringList>
+#include "logging.h"
+#include "sessionstore.h"
+#include "storage.h"
+
+namespace {
+const auto SessionsConf = QStringLiteral("/sessions");
+const auto SessionConfTemplate = QStringLiteral("/sessions/%1");
+const auto GameFileSuffix = QStringLiteral(".scm");
+
+QString sessionKey(const QString &gameFile)
+{
+    QString name = gameFile;
+    if (name.endsWith(GameFileSuffix))
+        name.chop(GameFileSuffix.length());
+    return SessionConfTemplate.arg(name);
+}
+} // namespace
+
+SessionStore::SessionStore(int maxSessions, int memoryBudget, int diskBudget)
+    : m_maxSessions(maxSessions)
+    , m_memoryBudget(memoryBudget)
+    , m_diskBudget(diskBudget)
+    , m_loaded(false)
+    , m_cacheSize(0)
+{
+}
+
+// Keys of the session list and every session in it
+QStringList SessionStore::storedKeys(const Storage *storage)
+{
+    QStringList keys;
+    QVariant sessions = storage->value(SessionsConf);
+    if (!sessions.isValid())
+        return keys;
+    keys << SessionsConf;
+    for (const QString &entry : sessions.toString().split(';', QString::SkipEmptyParts)) {
+        int sep = entry.lastIndexOf(':');
+        if (sep > 0 && storage->value(sessionKey(entry.left(sep))).isValid())
+            keys << sessionKey(entry.left(sep));
+    }
+    return keys;
+}
+
+void SessionStore::park(Storage *storage, const QString &gameFile, const Session &session)
+{
+    load(storage);
+    remove(storage, gameFile);
+
+    Session stored = session;
+    QString value = toString(stored);
+    if (value.size() > m_diskBudget && !stored.state.isEmpty()) {
+        qCDebug(lcRecorder) << "Dropping stored position of" << gameFile << "to keep the session";
+        stored.state.clear();
+        value = toString(stored);
+    }
+    if (value.size() > m_diskBudget) {
+        qCWarning(lcRecorder) << "Session for" << gameFile << "is too large to keep";
+        return;
+    }
+
+    storage->set(sessionKey(gameFile), value);
+    m_order.prepend(qMakePair(gameFile, value.size()));
+    m_cache.insert(gameFile, stored);
+    m_cacheSize += size(stored);
+
+    int total = 0;
+    for (int i = 0; i < m_order.count(); i++) {
+        total += m_order.at(i).second;
+        if (i >= m_maxSessions || total > m_diskBudget) {
+            while (m_order.count() > i)
+                remove(storage, m_order.last().first);
+            break;
+        }
+    }
+    trimCache();
+    save(storage);
+    qCDebug(lcRecorder) << "Parked session for" << gameFile << "," << m_order.count() << "sessions stored";
+}
+
+bool SessionStore::take(Storage *storage, const QString &gameFile, Session &session)
+{
+    load(storage);
+    if (indexOf(gameFile) < 0)
+        return false;
+
+    auto it = m_cache.constFind(gameFile);
+    bool ok = true;
+    if (it != m_cache.constEnd()) {
+        session = *it;
+    } else {
+        auto parts = storage->value(sessionKey(gameFile)).toString().split(';');
+        bool seedOk = false, timeOk = false;
+        // Sessions stored without a position have only three parts
+        if (parts.count() == 3 || parts.count() == 4) {
+            session.seed = parts.at(0).toUInt(&seedOk);
+            session.time = parts.at(1).toLongLong(&timeOk);
+            session.log = QByteArray::fromBase64(parts.at(2).toLatin1());
+            session.state = parts.count() == 4 ? QByteArray::fromBase64(parts.at(3).toLatin1()) : QByteArray();
+        }
+        ok = seedOk && timeOk;
+    }
+    remove(storage, gameFile);
+    save(storage);
+    if (!ok)
+        qCWarning(lcRecorder) << "Invalid stored session for" << gameFile;
+    return ok;
+}
+
+void SessionStore::remove(Storage *storage, const QString &gameFile)
+{
+    load(storage);
+    int index = indexOf(gameFile);
+    if (index >= 0) {
+        m_order.remove(index);
+        storage->set(sessionKey(gameFile), QVariant());
+        save(storage);
+    }
+    auto it = m_cache.find(gameFile);
+    if (it != m_cache.end()) {
+        m_cacheSize -= size(*it);
+        m_cache.erase(it);
+    }
+}
+
+void SessionStore::load(Storage *storage)
+{
+    if (m_loaded)
+        return;
+    m_loaded = true;
+
+    for (const QString &entry : storage->value(SessionsConf).toString().split(';', QString::SkipEmptyParts)) {
+        int sep = entry.lastIndexOf(':');
+        bool ok = false;
+        int size = entry.mid(sep + 1).toInt(&ok);
+        if (sep > 0 && ok)
+            m_order.append(qMakePair(entry.left(sep), size));
+    }
+}
+
+void SessionStore::save(Storage *storage)
+{
+    QStringList entries;
+    for (const auto &entry : m_order)
+        entries << QStringLiteral("%1:%2").arg(entry.first).arg(entry.second);
+    storage->set(SessionsConf, entries.isEmpty() ? QVariant() : QVariant(entries.join(';')));
+}
+
+void SessionStore::trimCache()
+{
+    for (int i = m_order.count() - 1; i >= 0 && m_cacheSize > m_memoryBudget; i--) {
+        auto it = m_cache.find(m_order.at(i).first);
+        if (it != m_cache.end()) {
+            m_cacheSize -= size(*it);
+            m_cache.erase(it);
+        }
+    }
+}
+
+QString SessionStore::toString(const Session &session)
+{
+    QString value = QStringLiteral("%1;%2;%3").arg(session.seed).arg(session.time)
+                                              .arg(QString::fromLatin1(session.log.toBase64()));
+    if (!session.state.isEmpty())
+        value.append(';').append(QString::fromLatin1(session.state.toBase64()));
+    return value;
+}
+
+int SessionStore::size(const Session &session)
+{
+    return session.log.size() + session.state.size();
+}
+
+int SessionStore::indexOf(const QString &gameFile) const
+{
+    for (int i = 0; i < m_order.count(); i++) {
+        if (m_order.at(i).first == gameFile)
+            return i;
+    }
+    return -1;
+}
@@ -0,0 +1,74 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SESSIONSTORE_H
+#define SESSIONSTORE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class Storage;
+
+/*
+ * In-progress games that were left by switching to another game.
+ *
+ * Sessions are kept per game file in least recently used order. Their move
+ * logs are cached in memory up to memoryBudget bytes and stored up to
+ * diskBudget bytes, older sessions are dropped when either runs out. A stored
+ * position is dropped first if a session does not fit otherwise, the moves
+ * are replayed then.
+ */
+class SessionStore
+{
+public:
+    struct Session {
+        quint32 seed;
+        qint64 time;
+        QByteArray log;
+        QByteArray state; // Position after the log, see EngineInternals::storeState()
+    };
+
+    SessionStore(int maxSessions, int memoryBudget, int diskBudget);
+
+    static QStringList storedKeys(const Storage *storage);
+
+    void park(Storage *storage, const QString &gameFile, const Session &session);
+    bool take(Storage *storage, const QString &gameFile, Session &session);
+    void remove(Storage *storage, const QString &gameFile);
+
+private:
+    void load(Storage *storage);
+    void save(Storage *storage);
+    void trimCache();
+    static QString toString(const Session &session);
+    static int size(const Session &session);
+    int indexOf(const QString &gameFile) const;
+
+    const int m_maxSessions;
+    const int m_memoryBudget;
+    const int m_diskBudget;
+    bool m_loaded;
+    QVector<QPair<QString, int>> m_order; // Most recent first, with stored sizes
+    QHash<QString, Session> m_cache;
+    int m_cacheSize;
+};
+
+#endif // SESSIONSTORE_H
@@ -0,0 +1,60 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "snapshot.h"
+
+TableSnapshot::TableSnapshot()
+    : m_seed(std::mt19937::default_seed)
+    , m_generation(0)
+{
+}
+
+TableSnapshot::TableSnapshot(const QVector<CardBuffer> &slots, uint_fast32_t seed, quint64 generation)
+    : m_slots(slots)
+    , m_seed(seed)
+    , m_generation(generation)
+{
+}
+
+int TableSnapshot::slotCount() const
+{
+    return m_slots.count();
+}
+
+const CardBuffer &TableSnapshot::slot(int slotId) const
+{
+    static const CardBuffer empty;
+    if (slotId < 0 || slotId >= m_slots.count())
+        return empty;
+    return m_slots.at(slotId);
+}
+
+CardList TableSnapshot::cards(int slotId, int count) const
+{
+    const CardBuffer &cards = slot(slotId);
+    return CardList::fromVector(cards.mid(count > 0 ? cards.count() - count : 0));
+}
+
+uint_fast32_t TableSnapshot::seed() const
+{
+    return m_seed;
+}
+
+quint64 TableSnapshot::generation() const
+{
+    return m_generation;
+}
@@ -0,0 +1,52 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <memory>
+#include <random>
+#include <QVector>
+#include "enginedata.h"
+
+/*
+ * Immutable copy of the table published by the engine after every move.
+ *
+ * Snapshots may be read from any thread. The slots share their data with
+ * the engine until it modifies them so publishing one is cheap.
+ */
+class TableSnapshot
+{
+public:
+    TableSnapshot();
+    TableSnapshot(const QVector<CardBuffer> &slots, uint_fast32_t seed, quint64 generation);
+
+    int slotCount() const;
+    const CardBuffer &slot(int slotId) const;
+    CardList cards(int slotId, int count) const;
+    uint_fast32_t seed() const;
+    quint64 generation() const;
+
+private:
+    const QVector<CardBuffer> m_slots;
+    const uint_fast32_t m_seed;
+    const quint64 m_generation;
+};
+
+typedef std::shared_ptr<const TableSnapshot> TableSnapshotPointer;
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,322 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <limits>
+#include <QDir>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+#include "logging.h"
+#include "statistics.h"
+
+namespace {
+const auto FileName = QStringLiteral("statistics.dat");
+const auto LogFileName = QStringLiteral("statistics.log");
+const QByteArray Magic = QByteArrayLiteral("PDST");
+const quint32 Version = 2;
+const int HeaderSize = 8;
+const int NameSize = 32;
+
+/*
+ * Aggregate record: name, played, won, streak, best streak, best time,
+ * last seed, moves of the last deal, streak before the last deal, whether
+ * the last deal was won and total moves, all little endian
+ */
+const int RecordSize = NameSize + 9 * 4 + 8;
+
+// Log record: name, seed, time, moves and won
+const int LogRecordSize = NameSize + 3 * 4 + 4;
+
+void encodeName(uchar *data, const QString &gameFile)
+{
+    QByteArray name = gameFile.toUtf8().left(NameSize);
+    memset(data, 0, NameSize);
+    memcpy(data, name.constData(), name.size());
+}
+
+QString decodeName(const uchar *data)
+{
+    const char *name = reinterpret_cast<const char *>(data);
+    return QString::fromUtf8(name, qstrnlen(name, NameSize));
+}
+
+// Game file as it fits in a record
+QString recordName(const QString &gameFile)
+{
+    QByteArray name = gameFile.toUtf8().left(NameSize);
+    return QString::fromUtf8(name.constData(), qstrnlen(name.constData(), name.size()));
+}
+
+QByteArray header()
+{
+    QByteArray data(Magic);
+    data.resize(HeaderSize);
+    qToLittleEndian<quint32>(Version, reinterpret_cast<uchar *>(data.data()) + Magic.size());
+    return data;
+}
+
+QByteArray encodeAggregate(const QString &gameFile, const Statistics::Aggregate &aggregate)
+{
+    QByteArray data(RecordSize, '\0');
+    uchar *out = reinterpret_cast<uchar *>(data.data());
+    encodeName(out, gameFile);
+    out += NameSize;
+    for (quint32 value : { aggregate.played, aggregate.won, aggregate.streak,
+                           aggregate.bestStreak, aggregate.bestTime, aggregate.lastSeed,
+                           aggregate.lastMoves, aggregate.previousStreak, quint32(aggregate.lastWon) }) {
+        qToLittleEndian<quint32>(value, out);
+        out += 4;
+    }
+    qToLittleEndian<quint64>(aggregate.totalMoves, out);
+    return data;
+}
+
+Statistics::Aggregate decodeAggregate(const uchar *data)
+{
+    Statistics::Aggregate aggregate;
+    data += NameSize;
+    aggregate.played = qFromLittleEndian<quint32>(data);
+    aggregate.won = qFromLittleEndian<quint32>(data + 4);
+    aggregate.streak = qFromLittleEndian<quint32>(data + 8);
+    aggregate.bestStreak = qFromLittleEndian<quint32>(data + 12);
+    aggregate.bestTime = qFromLittleEndian<quint32>(data + 16);
+    aggregate.lastSeed = qFromLittleEndian<quint32>(data + 20);
+    aggregate.lastMoves = qFromLittleEndian<quint32>(data + 24);
+    aggregate.previousStreak = qFromLittleEndian<quint32>(data + 28);
+    aggregate.lastWon = qFromLittleEndian<quint32>(data + 32);
+    aggregate.totalMoves = qFromLittleEndian<quint64>(data + 36);
+    return aggregate;
+}
+} // namespace
+
+Statistics::Aggregate::Aggregate()
+    : played(0)
+    , won(0)
+    , streak(0)
+    , bestStreak(0)
+    , bestTime(0)
+    , lastSeed(0)
+    , lastMoves(0)
+    , previousStreak(0)
+    , lastWon(false)
+    , totalMoves(0)
+{
+}
+
+double Statistics::Aggregate::winRate() const
+{
+    return played ? double(won) / played : 0.0;
+}
+
+double Statistics::Aggregate::averageMoves() const
+{
+    return played ? double(totalMoves) / played : 0.0;
+}
+
+Statistics::Statistics(const QString &directory)
+{
+    QDir dir(directory.isEmpty() ? QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) : directory);
+    dir.mkpath(QStringLiteral("."));
+    m_path = dir.filePath(FileName);
+    m_logPath = dir.filePath(LogFileName);
+
+    QMutexLocker locker(&m_mutex);
+    if (!load()) {
+        qCWarning(lcRecorder) << "Statistics are corrupted, rebuilding them from" << m_logPath;
+        rebuildLocked();
+    }
+}
+
+QString Statistics::path() const
+{
+    return m_path;
+}
+
+QString Statistics::logPath() const
+{
+    return m_logPath;
+}
+
+void Statistics::record(const QString &gameFile, quint32 seed, bool won, qint64 time, int moves)
+{
+    QMutexLocker locker(&m_mutex);
+    quint32 elapsed = quint32(qBound<qint64>(0, time, std::numeric_limits<quint32>::max()));
+
+    QByteArray entry(LogRecordSize, '\0');
+    uchar *out = reinterpret_cast<uchar *>(entry.data());
+    encodeName(out, gameFile);
+    qToLittleEndian<quint32>(seed, out + NameSize);
+    qToLittleEndian<quint32>(elapsed, out + NameSize + 4);
+    qToLittleEndian<quint32>(moves, out + NameSize + 8);
+    out[NameSize + 12] = won;
+    if (m_log.write(entry) != entry.size() || !m_log.flush())
+        qCWarning(lcRecorder) << "Can not write statistics log" << m_log.errorString();
+
+    int index = indexOf(gameFile);
+    if (apply(m_aggregates[index], seed, won, elapsed, moves))
+        writeAggregate(index);
+}
+
+Statistics::Aggregate Statistics::aggregate(const QString &gameFile) const
+{
+    QMutexLocker locker(&m_mutex);
+    int index = m_index.value(recordName(gameFile), -1);
+    return index >= 0 ? m_aggregates.at(index) : Aggregate();
+}
+
+QStringList Statistics::games() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_games;
+}
+
+bool Statistics::rebuild()
+{
+    QMutexLocker locker(&m_mutex);
+    return rebuildLocked();
+}
+
+bool Statistics::load()
+{
+    m_log.close();
+    m_log.setFileName(m_logPath);
+    if (!m_log.open(QIODevice::ReadWrite | QIODevice::Append)) {
+        qCWarning(lcRecorder) << "Can not open statistics log" << m_log.errorString();
+    } else if (m_log.size() % LogRecordSize) {
+        // Drop a torn write at the end
+        m_log.resize(m_log.size() - m_log.size() % LogRecordSize);
+    }
+
+    m_file.close();
+    m_file.setFileName(m_path);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        qCWarning(lcRecorder) << "Can not open statistics" << m_file.errorString();
+        return true;
+    }
+
+    if (m_file.size() == 0)
+        return m_file.write(header()) == HeaderSize && m_log.size() == 0;
+
+    QByteArray data = m_file.readAll();
+    if (!data.startsWith(header()) || (data.size() - HeaderSize) % RecordSize)
+        return false;
+
+    m_games.clear();
+    m_aggregates.clear();
+    m_index.clear();
+    for (int pos = HeaderSize; pos < data.size(); pos += RecordSize) {
+        const uchar *record = reinterpret_cast<const uchar *>(data.constData()) + pos;
+        m_index.insert(decodeName(record), m_games.count());
+        m_games.append(decodeName(record));
+        m_aggregates.append(decodeAggregate(record));
+    }
+    return m_index.count() == m_games.count();
+}
+
+bool Statistics::rebuildLocked()
+{
+    m_games.clear();
+    m_aggregates.clear();
+    m_index.clear();
+
+    QFile log(m_logPath);
+    if (log.open(QIODevice::ReadOnly)) {
+        QByteArray data = log.readAll();
+        for (int pos = 0; pos + LogRecordSize <= data.size(); pos += LogRecordSize) {
+            const uchar *entry = reinterpret_cast<const uchar *>(data.constData()) + pos;
+            int index = indexOf(decodeName(entry));
+            apply(m_aggregates[index],
+                  qFromLittleEndian<quint32>(entry + NameSize),
+                  entry[NameSize + 12],
+                  qFromLittleEndian<quint32>(entry + NameSize + 4),
+                  qFromLittleEndian<quint32>(entry + NameSize + 8));
+        }
+    }
+
+    QSaveFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(lcRecorder) << "Can not rebuild statistics" << file.errorString();
+        return false;
+    }
+    file.write(header());
+    for (int i = 0; i < m_games.count(); i++)
+        file.write(encodeAggregate(m_games.at(i), m_aggregates.at(i)));
+    if (!file.commit()) {
+        qCWarning(lcRecorder) << "Can not rebuild statistics" << file.errorString();
+        return false;
+    }
+
+    m_file.close();
+    if (!m_file.open(QIODevice::ReadWrite))
+        qCWarning(lcRecorder) << "Can not open statistics" << m_file.errorString();
+    qCDebug(lcRecorder) << "Rebuilt statistics for" << m_games.count() << "games";
+    return true;
+}
+
+int Statistics::indexOf(const QString &gameFile)
+{
+    QString name = recordName(gameFile);
+    auto it = m_index.constFind(name);
+    if (it != m_index.constEnd())
+        return *it;
+    m_index.insert(name, m_games.count());
+    m_games.append(name);
+    m_aggregates.append(Aggregate());
+    return m_games.count() - 1;
+}
+
+bool Statistics::writeAggregate(int index)
+{
+    if (!m_file.seek(HeaderSize + qint64(index) * RecordSize)
+            || m_file.write(encodeAggregate(m_games.at(index), m_aggregates.at(index))) != RecordSize
+            || !m_file.flush()) {
+        qCWarning(lcRecorder) << "Can not write statistics" << m_file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool Statistics::apply(Aggregate &aggregate, quint32 seed, bool won, quint32 time, quint32 moves)
+{
+    if (aggregate.played && aggregate.lastSeed == seed) {
+        if (aggregate.lastWon || !won)
+            return false;
+        // Lost deal was won after undoing, count it as won instead
+        aggregate.played--;
+        aggregate.totalMoves -= aggregate.lastMoves;
+        aggregate.streak = aggregate.previousStreak;
+    }
+
+    aggregate.played++;
+    aggregate.lastSeed = seed;
+    aggregate.lastMoves = moves;
+    aggregate.lastWon = won;
+    aggregate.previousStreak = aggregate.streak;
+    aggregate.totalMoves += moves;
+    if (won) {
+        aggregate.won++;
+        aggregate.streak++;
+        aggregate.bestStreak = qMax(aggregate.bestStreak, aggregate.streak);
+        if (!aggregate.bestTime || time < aggregate.bestTime)
+            aggregate.bestTime = time;
+    } else {
+        aggregate.streak = 0;
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/*
+ * Per game statistics of finished games.
+ *
+ * Every result is appended to a log and folded into fixed size per game
+ * records, so recording and reading aggregates take constant time. The
+ * records can be rebuilt from the log if they get corrupted. A deal counts
+ * only once even if it ends more than once, e.g. after undoing, but a lost
+ * deal that is won afterwards counts as won.
+ */
+class Statistics
+{
+public:
+    struct Aggregate {
+        quint32 played;
+        quint32 won;
+        quint32 streak;
+        quint32 bestStreak;
+        quint32 bestTime;
+        quint32 lastSeed;
+        quint32 lastMoves;
+        quint32 previousStreak;
+        bool lastWon;
+        quint64 totalMoves;
+
+        Aggregate();
+        double winRate() const;
+        double averageMoves() const;
+    };
+
+    explicit Statistics(const QString &directory = QString());
+
+    void record(const QString &gameFile, quint32 seed, bool won, qint64 time, int moves);
+    Aggregate aggregate(const QString &gameFile) const;
+    QStringList games() const;
+    bool rebuild();
+
+    QString path() const;
+    QString logPath() const;
+
+private:
+    bool load();
+    bool rebuildLocked();
+    int indexOf(const QString &gameFile);
+    bool writeAggregate(int index);
+    static bool apply(Aggregate &aggregate, quint32 seed, bool won, quint32 time, quint32 moves);
+
+    mutable QMutex m_mutex;
+    QString m_path;
+    QString m_logPath;
+    QFile m_file;
+    QFile m_log;
+    QStringList m_games;
+    QVector<Aggregate> m_aggregates;
+    QHash<QString, int> m_index;
+};
+
+#endif // STATISTICS_H
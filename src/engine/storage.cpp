@@ -0,0 +1,115 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QMutexLocker>
+#include <QSet>
+#include <QStringList>
+#include "logging.h"
+#include "storage.h"
+
+namespace {
+
+const auto OptionsConfTemplate = QStringLiteral("/options/%1");
+const auto GameFileSuffix = QStringLiteral(".scm");
+
+QString optionsKey(const QString &gameFile)
+{
+    QString name = gameFile;
+    if (name.endsWith(GameFileSuffix))
+        name.chop(GameFileSuffix.length());
+    return OptionsConfTemplate.arg(name);
+}
+
+} // namespace
+
+Storage::Storage(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void Storage::sync()
+{
+}
+
+void Storage::watch(const QString &key)
+{
+    Q_UNUSED(key)
+}
+
+bool Storage::loadOptions(const QString &gameFile, GameOptionList &options) const
+{
+    auto stored = value(optionsKey(gameFile));
+    if (stored.isValid()) {
+        auto values = stored.toString().split(';').toSet();
+        qCDebug(lcOptionList) << values.count() << "options stored for" << gameFile;
+        for (int i = 0; i < options.length(); i++) {
+            options[i].set = values.contains(QString::number(options.at(i).index));
+        }
+        return true;
+    }
+    return false;
+}
+
+// Indices of set options in the form --options takes them
+QString Storage::storedOptions(const QString &gameFile) const
+{
+    return value(optionsKey(gameFile)).toString();
+}
+
+void Storage::saveOptions(const QString &gameFile, const GameOptionList &options)
+{
+    if (options.empty()) {
+        set(optionsKey(gameFile), QVariant());
+    } else {
+        QStringList values;
+        for (const GameOption &option : options) {
+            if (option.set)
+                values.append(QString::number(option.index));
+        }
+        set(optionsKey(gameFile), values.join(';'));
+    }
+    sync();
+}
+
+void Storage::clearOptions(const QString &gameFile)
+{
+    set(optionsKey(gameFile), QVariant());
+    sync();
+}
+
+MemoryStorage::MemoryStorage(QObject *parent)
+    : Storage(parent)
+{
+}
+
+QVariant MemoryStorage::value(const QString &key) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_values.value(key);
+}
+
+void MemoryStorage::set(const QString &key, const QVariant &value)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (value.isValid())
+            m_values.insert(key, value);
+        else
+            m_values.remove(key);
+    }
+    emit valueChanged(key);
+}
@@ -0,0 +1,75 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QVariant>
+#include "enginedata.h"
+
+/*
+ * Persistent key-value settings used by the engine.
+ *
+ * Keys are paths like "/state" relative to the application's configuration
+ * root. Setting an invalid QVariant removes the key. Values may be read and
+ * written from any thread but valueChanged is only emitted for watched keys.
+ */
+class Storage : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Storage(QObject *parent = nullptr);
+
+    virtual QVariant value(const QString &key) const = 0;
+    virtual void set(const QString &key, const QVariant &value) = 0;
+    virtual void sync();
+    virtual void watch(const QString &key);
+
+    bool loadOptions(const QString &gameFile, GameOptionList &options) const;
+    QString storedOptions(const QString &gameFile) const;
+    void saveOptions(const QString &gameFile, const GameOptionList &options);
+    void clearOptions(const QString &gameFile);
+
+signals:
+    void valueChanged(const QString &key);
+};
+
+/*
+ * Storage that lives only as long as the process, used by default and by
+ * headless tools.
+ */
+class MemoryStorage : public Storage
+{
+    Q_OBJECT
+
+public:
+    explicit MemoryStorage(QObject *parent = nullptr);
+
+    QVariant value(const QString &key) const override;
+    void set(const QString &key, const QVariant &value) override;
+
+private:
+    mutable QMutex m_mutex;
+    QHash<QString, QVariant> m_values;
+};
+
+#endif // STORAGE_H
@@ -0,0 +1,343 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSocketNotifier>
+#include <QStandardPaths>
+#include <QThread>
+#include <QVector>
+#include "engineinternals.h"
+#include "interface.h"
+#include "logging.h"
+#include "trace.h"
+
+namespace {
+
+const int RingSize = 4096; // Must be a power of two
+const auto DefaultFileName = QStringLiteral("engine-trace.json");
+
+const char *const NamedCalls[] = {
+    "start-game",
+    "undo",
+    "redo",
+    "do-deal-next-cards",
+    "record-move",
+    "end-move",
+    "discard-move",
+    "eval-move",
+};
+
+const char *const SignalNames[] = {
+    "action",
+    "moveEnded",
+    "gameLoaded",
+    "gameStarted",
+    "gameOver",
+    "clearData",
+    "engineFailure",
+};
+
+struct Entry {
+    qint64 time;
+    quint16 event;
+    quint16 id;
+    qint32 values[3];
+};
+
+/*
+ * Entry as it is stored in a ring. Fields are atomic so that they can be
+ * read while the owning thread writes them, and sequence tells which event
+ * the slot holds: it is the event's position in the ring plus one once the
+ * event is complete and zero while it is written.
+ */
+struct Slot {
+    std::atomic<quint32> sequence;
+    std::atomic<qint64> time;
+    std::atomic<quint32> eventAndId;
+    std::atomic<qint32> values[3];
+};
+
+struct Ring {
+    std::atomic<quint32> head;
+    int threadId;
+    QString threadName;
+    Slot slots[RingSize];
+};
+
+// Rings are never freed, a thread may exit before its events are dumped
+QMutex s_ringsMutex;
+QVector<Ring *> s_rings;
+thread_local Ring *t_ring = nullptr;
+
+QString s_path;
+bool s_dumpOnExit = false;
+int s_signalFds[2] = { -1, -1 };
+
+qint64 now()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+Ring *registerRing()
+{
+    Ring *ring = new Ring;
+    ring->head.store(0, std::memory_order_relaxed);
+    for (Slot &slot : ring->slots)
+        slot.sequence.store(0, std::memory_order_relaxed);
+    QThread *thread = QThread::currentThread();
+    QMutexLocker locker(&s_ringsMutex);
+    ring->threadId = s_rings.count() + 1;
+    ring->threadName = thread && !thread->objectName().isEmpty()
+            ? thread->objectName() : QStringLiteral("Thread %1").arg(ring->threadId);
+    s_rings.append(ring);
+    return ring;
+}
+
+QVector<Entry> snapshot(Ring *ring)
+{
+    // The owning thread may keep writing, skip events that it overwrote or is writing while copying
+    quint32 head = ring->head.load(std::memory_order_acquire);
+    quint32 first = head > RingSize ? head - RingSize : 0;
+    QVector<Entry> entries;
+    entries.reserve(head - first);
+    for (quint32 i = first; i < head; i++) {
+        const Slot &slot = ring->slots[i & (RingSize - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != i + 1)
+            continue;
+        Entry entry;
+        entry.time = slot.time.load(std::memory_order_relaxed);
+        quint32 eventAndId = slot.eventAndId.load(std::memory_order_relaxed);
+        entry.event = eventAndId >> 16;
+        entry.id = eventAndId & 0xffff;
+        for (int value = 0; value < 3; value++)
+            entry.values[value] = slot.values[value].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == i + 1)
+            entries.append(entry);
+    }
+    return entries;
+}
+
+QString callName(quint16 id)
+{
+    if (id < EngineInternals::LambdaCount) {
+        const char *name = Interface::LambdaNames;
+        for (int i = 0; i < id; i++)
+            name += strlen(name) + 1;
+        return QString::fromLatin1(name);
+    }
+    if (id >= Trace::FirstNamedCall && id < Trace::FirstNamedCall + int(sizeof(NamedCalls) / sizeof(*NamedCalls)))
+        return QString::fromLatin1(NamedCalls[id - Trace::FirstNamedCall]);
+    if (id == Trace::AnonymousCall)
+        return QStringLiteral("delayed-call");
+    return QStringLiteral("scheme-call");
+}
+
+QJsonObject toJson(const Entry &entry, int threadId)
+{
+    QJsonObject event;
+    event.insert("pid", static_cast<int>(QCoreApplication::applicationPid()));
+    event.insert("tid", threadId);
+    event.insert("ts", entry.time / 1000.0);
+    QJsonObject args;
+    switch (entry.event) {
+    case Trace::SchemeCallBegin:
+        event.insert("name", callName(entry.id));
+        event.insert("cat", "scheme");
+        event.insert("ph", "B");
+        return event;
+    case Trace::SchemeCallEnd:
+        event.insert("name", callName(entry.id));
+        event.insert("cat", "scheme");
+        event.insert("ph", "E");
+        args.insert("error", entry.values[0] != 0);
+        break;
+    case Trace::CardsSet:
+        event.insert("name", "setCards");
+        event.insert("cat", "engine");
+        args.insert("slot", entry.id);
+        args.insert("removed", entry.values[0]);
+        args.insert("inserted", entry.values[1]);
+        args.insert("flipped", entry.values[2]);
+        break;
+    case Trace::DelayedCallQueued:
+        event.insert("name", "delayedCallQueued");
+        event.insert("cat", "engine");
+        args.insert("delay", entry.values[0]);
+        break;
+    case Trace::DelayedCallFired:
+        event.insert("name", "delayedCallFired");
+        event.insert("cat", "engine");
+        break;
+    case Trace::SignalEmitted:
+        event.insert("name", entry.id < sizeof(SignalNames) / sizeof(*SignalNames)
+                     ? SignalNames[entry.id] : "signal");
+        event.insert("cat", "signal");
+        args.insert("a", entry.values[0]);
+        args.insert("b", entry.values[1]);
+        args.insert("c", entry.values[2]);
+        break;
+    case Trace::ReplayStep:
+        event.insert("name", "replayStep");
+        event.insert("cat", "recorder");
+        args.insert("move", entry.values[0]);
+        args.insert("type", entry.values[1]);
+        break;
+    default:
+        event.insert("name", "unknown");
+        break;
+    }
+    if (entry.event != Trace::SchemeCallEnd) {
+        event.insert("ph", "i");
+        event.insert("s", "t");
+    }
+    event.insert("args", args);
+    return event;
+}
+
+QString defaultPath()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath(DefaultFileName);
+}
+
+void handleSignal(int)
+{
+    char byte = 1;
+    ssize_t written = ::write(s_signalFds[0], &byte, sizeof(byte));
+    Q_UNUSED(written)
+}
+
+void installSignalHandler()
+{
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, s_signalFds) != 0) {
+        qCWarning(lcEngine) << "Could not create socket pair for trace signal";
+        return;
+    }
+
+    auto notifier = new QSocketNotifier(s_signalFds[1], QSocketNotifier::Read, QCoreApplication::instance());
+    QObject::connect(notifier, &QSocketNotifier::activated, [](int fd) {
+        char byte;
+        ssize_t got = ::read(fd, &byte, sizeof(byte));
+        Q_UNUSED(got)
+        Trace::dump();
+    });
+
+    struct sigaction action = {};
+    action.sa_handler = handleSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, nullptr);
+}
+
+} // namespace
+
+void Trace::record(Event event, quint16 id, qint32 a, qint32 b, qint32 c)
+{
+    Ring *ring = t_ring;
+    if (Q_UNLIKELY(!ring))
+        ring = t_ring = registerRing();
+    quint32 head = ring->head.load(std::memory_order_relaxed);
+    Slot &slot = ring->slots[head & (RingSize - 1)];
+    // Readers must see the slot as incomplete before any of its fields change
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.time.store(now(), std::memory_order_relaxed);
+    slot.eventAndId.store(quint32(event) << 16 | id, std::memory_order_relaxed);
+    slot.values[0].store(a, std::memory_order_relaxed);
+    slot.values[1].store(b, std::memory_order_relaxed);
+    slot.values[2].store(c, std::memory_order_relaxed);
+    slot.sequence.store(head + 1, std::memory_order_release);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+quint16 Trace::callId(const QString &name)
+{
+    for (size_t i = 0; i < sizeof(NamedCalls) / sizeof(*NamedCalls); i++) {
+        if (name == QLatin1String(NamedCalls[i]))
+            return FirstNamedCall + i;
+    }
+    return UnknownNamedCall;
+}
+
+bool Trace::dump()
+{
+    return dump(s_path.isEmpty() ? defaultPath() : s_path);
+}
+
+bool Trace::dump(const QString &path)
+{
+    QJsonArray events;
+    {
+        QMutexLocker locker(&s_ringsMutex);
+        for (Ring *ring : s_rings) {
+            QJsonObject metadata;
+            metadata.insert("name", "thread_name");
+            metadata.insert("ph", "M");
+            metadata.insert("pid", static_cast<int>(QCoreApplication::applicationPid()));
+            metadata.insert("tid", ring->threadId);
+            metadata.insert("args", QJsonObject({{"name", ring->threadName}}));
+            events.append(metadata);
+            for (const Entry &entry : snapshot(ring))
+                events.append(toJson(entry, ring->threadId));
+        }
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCWarning(lcEngine) << "Could not write engine trace to" << path;
+        return false;
+    }
+    file.write(QJsonDocument(QJsonObject({{"traceEvents", events}})).toJson(QJsonDocument::Compact));
+    qCInfo(lcEngine) << "Wrote engine trace to" << path;
+    return true;
+}
+
+void Trace::finish()
+{
+    if (s_dumpOnExit)
+        dump();
+}
+
+void Trace::addArguments(QCommandLineParser *parser)
+{
+    parser->addOption({"trace", "Write engine event trace to file on exit, on failure and on SIGUSR1", "file"});
+}
+
+void Trace::setArguments(QCommandLineParser *parser)
+{
+    if (parser->isSet("trace")) {
+        s_path = parser->value("trace");
+        s_dumpOnExit = true;
+    }
+    installSignalHandler();
+}
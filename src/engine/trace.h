@@ -0,0 +1,86 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+
+class QCommandLineParser;
+
+/*
+ * Always-on engine event trace.
+ *
+ * Every thread records compact events into its own fixed size ring buffer
+ * without taking locks. The buffers are written out in Chrome trace event
+ * format (load in chrome://tracing or Perfetto) when the engine fails, when
+ * the process receives SIGUSR1 and on exit if --trace was given.
+ */
+namespace Trace {
+
+enum Event : quint16 {
+    SchemeCallBegin,
+    SchemeCallEnd,
+    CardsSet,
+    DelayedCallQueued,
+    DelayedCallFired,
+    SignalEmitted,
+    ReplayStep,
+};
+
+// Ids for Scheme calls that are not one of EngineInternals::Lambda
+enum Call : quint16 {
+    FirstNamedCall = 0x100,
+    UnknownNamedCall = 0x1ff,
+    AnonymousCall = 0x200,
+};
+
+enum Signal : quint16 {
+    ActionSignal,
+    MoveEndedSignal,
+    GameLoadedSignal,
+    GameStartedSignal,
+    GameOverSignal,
+    ClearDataSignal,
+    EngineFailureSignal,
+};
+
+void record(Event event, quint16 id, qint32 a = 0, qint32 b = 0, qint32 c = 0);
+quint16 callId(const QString &name);
+
+bool dump();
+bool dump(const QString &path);
+void finish();
+
+void addArguments(QCommandLineParser *parser);
+void setArguments(QCommandLineParser *parser);
+
+class CallScope
+{
+public:
+    explicit CallScope(quint16 id) : m_id(id), m_error(1) { record(SchemeCallBegin, m_id); }
+    ~CallScope() { record(SchemeCallEnd, m_id, m_error); }
+    void succeeded() { m_error = 0; }
+
+private:
+    quint16 m_id;
+    qint32 m_error;
+};
+
+} // Trace
+
+#endif // TRACE_H
@@ -25,6 +25,8 @@ Manager::Manager(Table *table)
     : QObject(table)
     , m_table(table)
     , m_preparing(true)
+    , m_created(0)
+    , m_reused(0)
 {
     auto engine = Engine::instance();
     connect(engine, &Engine::newSlot, this, &Manager::handleNewSlot);
@@ -50,7 +52,7 @@ void Manager::handleNewSlot(int id, const CardList &dataList, int type,
         if (!dataList.isEmpty()) {
             QList<Card *> cards;
             for (const CardData &data : dataList) {
-                auto card = new Card(data, m_table, slot, this);
+                Card *card = create(data, slot);
                 cards.append(card);
             }
             slot->put(cards);
@@ -78,14 +80,13 @@ void Manager::handleImmediately(Engine::ActionType action, int slotId, int index
     switch (action) {
     case Engine::InsertionAction:
         {
-            Card *card = new Card(data, m_table, slot, this);
+            Card *card = create(data, slot);
             slot->insert(index, card);
             break;
         }
     case Engine::RemovalAction:
         {
-            Card *card = slot->takeAt(index);
-            card->shred();
+            release(slot->takeAt(index));
             break;
         }
     case Engine::FlippingAction:
@@ -96,11 +97,8 @@ void Manager::handleImmediately(Engine::ActionType action, int slotId, int index
         }
     case Engine::ClearingAction:
         {
-            auto cards = slot->takeAll();
-            for (Card *card : cards) {
-                if (card)
-                    card->shred();
-            }
+            for (Card *card : slot->takeAll())
+                release(card);
             break;
         }
     case Engine::MoveEndedAction:
@@ -123,7 +121,6 @@ bool Manager::handleQueued(const Action &action) {
             if (card) {
                 handled = true;
                 card->setShow(action.data.show);
-                card->update();
                 qCDebug(lcManager) << "Inserted" << card << "to" << slot << "at" << action.index;
             } else {
                 qCDebug(lcManager) << "Inserted placeholder for" << action.data << "to" << slot << "at" << action.index;
@@ -159,7 +156,6 @@ bool Manager::handleQueued(const Action &action) {
                 if (card->rank() != action.data.rank || card->suit() != action.data.suit)
                     qCCritical(lcManager) << "Rank or suit doesn't match to" << action.data
                                           << "for" << card << "in" << slot << "at index" << action.index;
-                card->update();
                 qCDebug(lcManager) << "Flipped" << card << "from" << slot << "at" << action.index;
             } else {
                 m_queue.flipQueued(slot->id(), action.index, action.data);
@@ -187,22 +183,23 @@ bool Manager::handleQueued(const Action &action) {
 void Manager::handleClearData()
 {
     m_preparing = true;
+    m_preparingTimer.start();
+    m_created = 0;
+    m_reused = 0;
     m_table->stopAnimation();
     for (Slot *slot : *m_table) {
-        for (Card *card : slot->takeAll()) {
-            if (card) {
-                card->shred();
-            }
-        }
+        for (Card *card : slot->takeAll())
+            release(card);
         slot->setParentItem(nullptr);
         slot->deleteLater();
     }
     m_table->clear();
     m_queue.clear();
     for (Card *card : m_queue.takeAll())
-        card->deleteLater();
+        release(card);
     qCDebug(lcManager) << "Started preparing while storing" << m_queue.cardCount()
-                       << "for" << m_queue.actionCount() << "actions";
+                       << "for" << m_queue.actionCount() << "actions with"
+                       << m_pool.count() << "cards in pool";
 }
 
 void Manager::handleGameStarted()
@@ -211,16 +208,26 @@ void Manager::handleGameStarted()
     m_table->setDirtyCardSize();
     qCDebug(lcManager) << "Stopped preparing while storing" << m_queue.cardCount()
                        << "for" << m_queue.actionCount() << "actions";
+    qCDebug(lcManager) << "Prepared game in" << m_preparingTimer.elapsed() << "ms with"
+                       << m_created << "new and" << m_reused << "reused cards";
 }
 
 void Manager::handleMoveEnded()
 {
     qCInfo(lcManager) << "Move ended, clearing queue";
+    int coalesced = m_queue.coalesce();
+    if (coalesced > 0)
+        qCDebug(lcManager) << "Coalesced" << coalesced << "actions";
     for (auto it = m_queue.begin(); it != m_queue.end(); ++it) {
         if (!handleQueued(*it))
             it.requeue();
     }
 
+    int writes = 0;
+    for (Slot *slot : *m_table)
+        writes += slot->updateDirtyLocations();
+    qCDebug(lcManager) << "Updated card locations with" << writes << "property writes";
+
     // Hide all unused cards
     for (auto it = m_queue.beginRecent(); it != m_queue.endRecent(); ++it)
         (*it)->setParentItem(nullptr);
@@ -248,7 +255,7 @@ void Manager::store(const QList<Card *> &cards, bool suppress)
 void Manager::forEach(std::function<void(Card *card)> func)
 {
     for (auto it = m_queue.beginStored(); it != m_queue.endStored(); ++it)
-        func(it.value());
+        func(*it);
 }
 
 Manager::iterator Manager::begin()
@@ -260,3 +267,31 @@ Manager::iterator Manager::end()
 {
     return m_queue.endStored();
 }
+
+// Takes a card from the pool, preferring one with the same value, or creates a new one
+Card *Manager::create(const CardData &data, Slot *slot)
+{
+    Card *card = m_pool.take(data.value());
+    if (!card && !m_pool.isEmpty()) {
+        auto it = m_pool.begin();
+        card = it.value();
+        m_pool.erase(it);
+    }
+    if (card) {
+        card->reuse(data, slot);
+        m_reused++;
+    } else {
+        card = new Card(data, m_table, slot, this);
+        m_created++;
+    }
+    return card;
+}
+
+// Cards are kept for later games instead of deleting them
+void Manager::release(Card *card)
+{
+    if (card) {
+        card->setParentItem(nullptr);
+        m_pool.insert(card->value(), card);
+    }
+}
@@ -19,7 +19,9 @@
 #define MANAGER_H
 
 #include <functional>
+#include <QElapsedTimer>
 #include <QList>
+#include <QMultiHash>
 #include <QObject>
 #include <QPair>
 #include "engine.h"
@@ -40,7 +42,7 @@ public:
     void store(const QList<Card *> &cards);
 
     void forEach(std::function<void(Card *)> func);
-    using iterator = typename QMultiHash<SuitAndRank, Card *>::iterator;
+    using iterator = typename Queue<Card *>::card_iterator;
     iterator begin();
     iterator end();
 
@@ -56,11 +58,17 @@ private slots:
 private:
     void store(const QList<Card *> &cards, bool suppress);
     bool handleQueued(const Action &action);
+    Card *create(const CardData &data, Slot *slot);
+    void release(Card *card);
 
     Engine *m_engine;
     Table *m_table;
     bool m_preparing;
     Queue<Card *> m_queue;
+    QMultiHash<SuitAndRank, Card *> m_pool;
+    QElapsedTimer m_preparingTimer;
+    int m_created;
+    int m_reused;
 };
 
 #endif // MANAGER_H
@@ -18,281 +18,6 @@
 #include "logging.h"
 #include "queue.h"
 
-#ifndef ENGINE_EXERCISER
-#include "card.h"
-template class Queue<Card *>;
-#else
-#include <QSharedPointer>
-#include "enginedata.h"
-template class Queue<QSharedPointer<CardData>>;
-#endif
-
-template<class C>
-void Queue<C>::addSlot(int slot)
-{
-    m_laterActions.insert(slot, std::list<Action>());
-}
-
-template<class C>
-void Queue<C>::clear()
-{
-    m_actions.clear();
-    m_laterActions.clear();
-    m_recentlyAdded.clear();
-}
-
-template<class C>
-int Queue<C>::actionCount()
-{
-    int count = m_actions.size();
-    for (const auto &list : m_laterActions)
-        count += list.size();
-    return count;
-}
-
-template<class C>
-int Queue<C>::cardCount()
-{
-    return m_cards.count();
-}
-
-template<class C>
-void Queue<C>::queue(Engine::ActionType type, int slot, int index, const CardData &data)
-{
-    Action action(type, slot, index, data);
-    qCDebug(lcQueue) << "Queueing" << action;
-    m_actions.push_back(action);
-}
-
-template<class C>
-void Queue<C>::requeue(Action action)
-{
-    qCDebug(lcQueue) << "Queueing again" << action;
-    m_laterActions[action.slot].push_back(action);
-}
-
-template<class C>
-void Queue<C>::store(C card)
-{
-    qCDebug(lcQueue) << "Storing" << card;
-    m_cards.insert(card->value(), card);
-    m_recentlyAdded.insert(card);
-}
-
-template<class C>
-C Queue<C>::take(const Action &action)
-{
-    auto card = m_cards.take(action.value());
-    m_recentlyAdded.remove(card);
-    return card;
-}
-
-template<class C>
-QList<C> Queue<C>::takeAll()
-{
-    QList<C> cards;
-    for (auto card : m_cards)
-        cards.append(card);
-    m_cards.clear();
-    m_recentlyAdded.clear();
-    return cards;
-}
-
-template<class C>
-typename Queue<C>::iterator Queue<C>::begin()
-{
-    return Queue<C>::iterator(this);
-}
-
-template<class C>
-typename Queue<C>::iterator Queue<C>::end()
-{
-    return Queue<C>::iterator(this, true);
-}
-
-template<class C>
-void Queue<C>::incrementQueued(int slot, int index)
-{
-    for (auto &action : m_laterActions[slot]) {
-        if (action.index >= index)
-            action.index++;
-    }
-}
-
-template<class C>
-void Queue<C>::decrementQueued(int slot, int index, const CardData &data)
-{
-    for (auto it = m_laterActions[slot].begin(); it != m_laterActions[slot].end();) {
-        if (it->index == index) {
-            if (it->data.rank != data.rank || it->data.suit != data.suit)
-                qCCritical(lcQueue) << "Rank or suit doesn't match to" << data
-                                    << "for queued" << it->data << "in" << slot
-                                    << "at index" << index << "while decrementing";
-            it = m_laterActions[slot].erase(it);
-        } else {
-            if (it->index > index)
-                it->index--;
-            ++it;
-        }
-    }
-}
-
-template<class C>
-void Queue<C>::flipQueued(int slot, int index, const CardData &data)
-{
-    for (auto &action : m_laterActions[slot]) {
-        if (action.index == index) {
-            action.data.show = data.show;
-            if (action.data.rank != data.rank || action.data.suit != data.suit)
-                qCCritical(lcQueue) << "Rank or suit doesn't match to" << data
-                                    << "for queued" << action.data << "in" << slot
-                                    << "at index" << index << "while flipping";
-            break;
-        }
-    }
-}
-
-template<class C>
-void Queue<C>::clearQueued(int slot)
-{
-    m_laterActions[slot].clear();
-}
-
-template<class C>
-Queue<C>::iterator::iterator(Queue<C> *queue, bool atEnd)
-    : queue(queue)
-    , state(atEnd ? EndState : BeginState)
-{
-    ++(*this); // Move forward from BeginState
-}
-
-template<class C>
-void Queue<C>::iterator::operator=(const iterator& other)
-{
-    queue = other.queue;
-    state = other.state;
-    iter = other.iter;
-    slotIter = other.slotIter;
-}
-
-template<class C>
-bool Queue<C>::iterator::operator!=(const iterator& other) const
-{
-    if (queue != other.queue)
-        return true;
-
-    if (state != other.state)
-        return true;
-
-    switch (state) {
-    case BeginState:
-    case EndState:
-        return false;
-    case IterLaterState:
-        if (slotIter != other.slotIter)
-            return false;
-        [[fallthrough]];
-    case IterActionsState:
-        return iter != other.iter; 
-    default:
-        Q_UNREACHABLE();
-        break;
-    }
-}
-
-template<class C>
-typename Queue<C>::iterator &Queue<C>::iterator::operator++()
-{
-    bool first = false;
-    if (state == BeginState) {
-        iter = queue->m_actions.begin();
-        state = IterActionsState;
-        first = true;
-    }
-    if (state != EndState) {
-        if (state == IterActionsState) {
-            if (!first)
-                ++iter;
-            // Iterating m_actions
-            if (iter == queue->m_actions.end()) {
-                slotIter = queue->m_laterActions.begin();
-                state = slotIter == queue->m_laterActions.end() ? EndState : IterLaterState;
-                first = true;
-            }
-        }
-        if (state == IterLaterState) {
-            // Iterating m_laterActions
-            if (first)
-                iter = slotIter->begin();
-            else
-                ++iter;
-
-            while (iter == slotIter->end()) {
-                ++slotIter;
-                if (slotIter == queue->m_laterActions.end()) {
-                    qCDebug(lcQueue) << "Iterator reached end";
-                    state = EndState;
-                    break;
-                }
-                iter = slotIter->begin();
-            }
-        }
-    }
-    return *this;
-}
-
-template<class C>
-Action &Queue<C>::iterator::operator*() const
-{
-    if (state == BeginState || state == EndState)
-        qCCritical(lcQueue) << "Deref queue iterator at" << (state == BeginState ? "beginning" : "end");
-    return *iter;
-}
-
-template<class C>
-bool Queue<C>::iterator::requeue()
-{
-    if (state != IterActionsState) {
-        qCWarning(lcQueue) << "Trying to queue an action while in state" << state;
-        qCCritical(lcQueue) << "Discarding" << *iter;
-        return false;
-    }
-
-    if (iter->type != Engine::InsertionAction) {
-        qCWarning(lcQueue) << "Trying to queue non-insertion action";
-        qCCritical(lcQueue) << "Discarding" << *iter;
-        return false;
-    }
-
-    iter->replaces = true;
-    queue->requeue(*iter);
-    return true;
-}
-
-template<class C>
-typename QSet<C>::iterator Queue<C>::beginRecent()
-{
-    return m_recentlyAdded.begin();
-}
-
-template<class C>
-typename QSet<C>::iterator Queue<C>::endRecent()
-{
-    return m_recentlyAdded.end();
-}
-
-template<class C>
-typename QMultiHash<SuitAndRank, C>::iterator Queue<C>::beginStored()
-{
-    return m_cards.begin();
-}
-
-template<class C>
-typename QMultiHash<SuitAndRank, C>::iterator Queue<C>::endStored()
-{
-    return m_cards.end();
-}
-
 Action::Action(Engine::ActionType type, int slot, int index, const CardData &data)
     : type(type)
     , slot(slot)
@@ -18,10 +18,13 @@
 #ifndef QUEUE_H
 #define QUEUE_H
 
-#include <list>
+#include <iterator>
+#include <vector>
 #include <QDebug>
+#include <QList>
 #include "engine.h"
 #include "enginedata.h"
+#include "logging.h"
 
 struct Action {
     Engine::ActionType type;
@@ -37,10 +40,30 @@ struct Action {
     friend QDebug operator<<(QDebug debug, const Action &action);
 };
 
+/*
+ * Actions and cards waiting for a move to end.
+ *
+ * Everything is kept in flat vectors that are only cleared, never freed,
+ * so that once the queue has seen a few moves it doesn't allocate anymore.
+ * Later actions are kept per slot and indexed by slot id. Stored cards are
+ * indexed by suit and rank with room for a number of copies of each card,
+ * which grows when a game uses more decks than seen before.
+ */
 template<class C>
 class Queue
 {
+    struct StoredCard {
+        C card;
+        bool recent;
+    };
+
+    static constexpr int RankCount = RankAceHigh + 1;
+    static constexpr int ValueCount = (SuitSpade + 1) * RankCount;
+    static constexpr int InitialCopies = 2;
+
 public:
+    Queue();
+
     void addSlot(int slot);
     void clear();
     int actionCount();
@@ -48,8 +71,8 @@ public:
 
     class iterator {
         Queue *queue;
-        typename std::list<Action>::iterator iter;
-        typename QMap<int, std::list<Action>>::iterator slotIter;
+        int slot;
+        int position;
 
         enum QueueIteratorState {
             BeginState,
@@ -58,6 +81,8 @@ public:
             EndState
         } state;
 
+        std::vector<Action> &actions() const;
+
     public:
         iterator(Queue *queue, bool atEnd = false);
 
@@ -69,11 +94,37 @@ public:
         bool requeue();
     };
 
+    // Iterates stored cards, or only recently stored cards
+    class card_iterator {
+    public:
+        using difference_type = int;
+        using value_type = C;
+        using pointer = C *;
+        using reference = C &;
+        using iterator_category = std::forward_iterator_tag;
+
+        card_iterator(Queue *queue, bool recent, bool atEnd = false);
+
+        bool operator==(const card_iterator &other) const;
+        bool operator!=(const card_iterator &other) const;
+        card_iterator &operator++();
+        C &operator*() const;
+
+    private:
+        void skip();
+
+        Queue *m_queue;
+        bool m_recent;
+        int m_value;
+        int m_copy;
+    };
+
     typename Queue<C>::iterator begin();
     typename Queue<C>::iterator end();
 
     void queue(Engine::ActionType type, int slot, int index, const CardData &data);
-    void requeue(Action action);
+    void requeue(const Action &action);
+    int coalesce();
 
     void store(C card);
     C take(const Action &action);
@@ -84,17 +135,547 @@ public:
     void flipQueued(int slot, int index, const CardData &data);
     void clearQueued(int slot);
 
-    typename QSet<C>::iterator beginRecent();
-    typename QSet<C>::iterator endRecent();
+    card_iterator beginRecent();
+    card_iterator endRecent();
 
-    typename QMultiHash<SuitAndRank, C>::iterator beginStored();
-    typename QMultiHash<SuitAndRank, C>::iterator endStored();
+    card_iterator beginStored();
+    card_iterator endStored();
 
 private:
-    std::list<Action> m_actions;
-    QMap<int, std::list<Action>> m_laterActions;
-    QMultiHash<SuitAndRank, C> m_cards;
-    QSet<C> m_recentlyAdded;
+    static bool dropped(const Action &action);
+    static void drop(Action &action);
+    void coalesce(int position);
+
+    static int valueIndex(const SuitAndRank &value);
+    StoredCard &stored(int value, int copy);
+    void addCopies();
+    std::vector<Action> *laterActions(int slot);
+
+    std::vector<Action> m_actions;
+    std::vector<std::vector<Action>> m_laterActions;
+    std::vector<StoredCard> m_cards;
+    int m_counts[ValueCount];
+    int m_copies;
+    int m_cardCount;
 };
 
+template<class C>
+Queue<C>::Queue()
+    : m_counts{}
+    , m_copies(0)
+    , m_cardCount(0)
+{
+}
+
+template<class C>
+void Queue<C>::addSlot(int slot)
+{
+    if (slot >= int(m_laterActions.size()))
+        m_laterActions.resize(slot + 1);
+}
+
+template<class C>
+void Queue<C>::clear()
+{
+    m_actions.clear();
+    for (auto &actions : m_laterActions)
+        actions.clear();
+    for (int value = 0; value < ValueCount; value++) {
+        for (int copy = 0; copy < m_counts[value]; copy++)
+            stored(value, copy).recent = false;
+    }
+}
+
+template<class C>
+int Queue<C>::actionCount()
+{
+    int count = m_actions.size();
+    for (const auto &actions : m_laterActions)
+        count += actions.size();
+    return count;
+}
+
+template<class C>
+int Queue<C>::cardCount()
+{
+    return m_cardCount;
+}
+
+template<class C>
+void Queue<C>::queue(Engine::ActionType type, int slot, int index, const CardData &data)
+{
+    m_actions.emplace_back(type, slot, index, data);
+    qCDebug(lcQueue) << "Queueing" << m_actions.back();
+}
+
+template<class C>
+void Queue<C>::requeue(const Action &action)
+{
+    qCDebug(lcQueue) << "Queueing again" << action;
+    addSlot(action.slot);
+    m_laterActions[action.slot].push_back(action);
+}
+
+// Move ended actions are never queued, so they mark actions that were coalesced away
+template<class C>
+bool Queue<C>::dropped(const Action &action)
+{
+    return action.type == Engine::MoveEndedAction;
+}
+
+template<class C>
+void Queue<C>::drop(Action &action)
+{
+    qCDebug(lcQueue) << "Coalesced" << action;
+    action.type = Engine::MoveEndedAction;
+}
+
+/*
+ * Cancels actions that don't change the table before they are applied.
+ *
+ * A card that is removed and inserted back to the same place is left
+ * there, or only flipped, and a card that is inserted and removed again
+ * is never inserted. A flip is folded into the insertion before it, and
+ * only the last of repeated flips is kept. Actions only cancel when
+ * nothing between them touches the same slot, apart from flipping cards
+ * below them, or takes or stores a card with the same suit and rank, so
+ * that every other action still gets the same card from the store.
+ * Returns the number of actions dropped.
+ */
+template<class C>
+int Queue<C>::coalesce()
+{
+    int count = m_actions.size();
+    for (int position = 0; position < count; position++) {
+        if (!dropped(m_actions[position]))
+            coalesce(position);
+    }
+    auto kept = m_actions.begin();
+    for (auto it = m_actions.begin(); it != m_actions.end(); ++it) {
+        if (!dropped(*it)) {
+            if (kept != it)
+                *kept = *it;
+            ++kept;
+        }
+    }
+    m_actions.erase(kept, m_actions.end());
+    return count - m_actions.size();
+}
+
+template<class C>
+void Queue<C>::coalesce(int position)
+{
+    Action &action = m_actions[position];
+    bool movesCard = action.type == Engine::InsertionAction || action.type == Engine::RemovalAction;
+    if (!movesCard && action.type != Engine::FlippingAction)
+        return;
+
+    for (auto it = m_actions.begin() + position + 1; it != m_actions.end(); ++it) {
+        Action &other = *it;
+        if (dropped(other))
+            continue;
+        if (other.type == Engine::ClearingAction)
+            return; // Cleared cards go to the store too
+        bool otherMovesCard = other.type == Engine::InsertionAction || other.type == Engine::RemovalAction;
+        if (other.slot != action.slot) {
+            if (movesCard && otherMovesCard && other.value() == action.value())
+                return;
+            continue;
+        }
+        if (other.index != action.index) {
+            /*
+             * Dropping an insertion or a removal shifts the cards above it,
+             * so only flips of cards below it can be skipped
+             */
+            if (other.type == Engine::FlippingAction && (!movesCard || other.index < action.index))
+                continue;
+            return;
+        }
+        if (other.value() != action.value())
+            return;
+
+        switch (action.type) {
+        case Engine::RemovalAction:
+            if (other.type == Engine::InsertionAction) {
+                // The card stays, at most its side changes
+                if (other.data.show == action.data.show)
+                    drop(other);
+                else
+                    other.type = Engine::FlippingAction;
+                drop(action);
+            }
+            return;
+        case Engine::InsertionAction:
+            if (other.type == Engine::FlippingAction) {
+                action.data.show = other.data.show;
+                drop(other);
+                continue;
+            }
+            if (other.type == Engine::RemovalAction) {
+                drop(other);
+                drop(action);
+            }
+            return;
+        case Engine::FlippingAction:
+            // Removals keep their flips, the removed card may be inserted back
+            if (other.type == Engine::FlippingAction)
+                drop(action);
+            return;
+        default:
+            return;
+        }
+    }
+}
+
+template<class C>
+int Queue<C>::valueIndex(const SuitAndRank &value)
+{
+    if (value.first < SuitClubs || value.first > SuitSpade
+            || value.second < RankJoker || value.second > RankAceHigh)
+        return -1;
+    return value.first * RankCount + value.second;
+}
+
+template<class C>
+typename Queue<C>::StoredCard &Queue<C>::stored(int value, int copy)
+{
+    return m_cards[value * m_copies + copy];
+}
+
+template<class C>
+void Queue<C>::addCopies()
+{
+    int copies = m_copies ? m_copies * 2 : InitialCopies;
+    qCDebug(lcQueue) << "Making room for" << copies << "copies of each card";
+    std::vector<StoredCard> cards(ValueCount * copies, StoredCard{ C(), false });
+    for (int value = 0; value < ValueCount; value++) {
+        for (int copy = 0; copy < m_counts[value]; copy++)
+            cards[value * copies + copy] = stored(value, copy);
+    }
+    m_cards.swap(cards);
+    m_copies = copies;
+}
+
+template<class C>
+void Queue<C>::store(C card)
+{
+    qCDebug(lcQueue) << "Storing" << card;
+    int value = valueIndex(card->value());
+    if (value < 0) {
+        qCCritical(lcQueue) << "Can not store" << card << "with invalid suit or rank";
+        return;
+    }
+    if (m_counts[value] == m_copies)
+        addCopies();
+    stored(value, m_counts[value]++) = StoredCard{ card, true };
+    m_cardCount++;
+}
+
+// Returns the card with the same suit and rank that was stored last
+template<class C>
+C Queue<C>::take(const Action &action)
+{
+    int value = valueIndex(action.value());
+    if (value < 0 || m_counts[value] == 0)
+        return C();
+    StoredCard &entry = stored(value, --m_counts[value]);
+    C card = entry.card;
+    entry.card = C();
+    m_cardCount--;
+    return card;
+}
+
+template<class C>
+QList<C> Queue<C>::takeAll()
+{
+    QList<C> cards;
+    cards.reserve(m_cardCount);
+    for (int value = 0; value < ValueCount; value++) {
+        for (int copy = 0; copy < m_counts[value]; copy++) {
+            StoredCard &entry = stored(value, copy);
+            cards.append(entry.card);
+            entry.card = C();
+        }
+        m_counts[value] = 0;
+    }
+    m_cardCount = 0;
+    return cards;
+}
+
+template<class C>
+typename Queue<C>::iterator Queue<C>::begin()
+{
+    return Queue<C>::iterator(this);
+}
+
+template<class C>
+typename Queue<C>::iterator Queue<C>::end()
+{
+    return Queue<C>::iterator(this, true);
+}
+
+template<class C>
+std::vector<Action> *Queue<C>::laterActions(int slot)
+{
+    if (slot < 0 || slot >= int(m_laterActions.size()))
+        return nullptr;
+    return &m_laterActions[slot];
+}
+
+template<class C>
+void Queue<C>::incrementQueued(int slot, int index)
+{
+    if (auto actions = laterActions(slot)) {
+        for (auto &action : *actions) {
+            if (action.index >= index)
+                action.index++;
+        }
+    }
+}
+
+template<class C>
+void Queue<C>::decrementQueued(int slot, int index, const CardData &data)
+{
+    auto actions = laterActions(slot);
+    if (!actions)
+        return;
+
+    // Compacts the remaining actions in place
+    auto kept = actions->begin();
+    for (auto it = actions->begin(); it != actions->end(); ++it) {
+        if (it->index == index) {
+            if (it->data.rank != data.rank || it->data.suit != data.suit)
+                qCCritical(lcQueue) << "Rank or suit doesn't match to" << data
+                                    << "for queued" << it->data << "in" << slot
+                                    << "at index" << index << "while decrementing";
+            continue;
+        }
+        if (it->index > index)
+            it->index--;
+        if (kept != it)
+            *kept = *it;
+        ++kept;
+    }
+    actions->erase(kept, actions->end());
+}
+
+template<class C>
+void Queue<C>::flipQueued(int slot, int index, const CardData &data)
+{
+    auto actions = laterActions(slot);
+    if (!actions)
+        return;
+
+    for (auto &action : *actions) {
+        if (action.index == index) {
+            action.data.show = data.show;
+            if (action.data.rank != data.rank || action.data.suit != data.suit)
+                qCCritical(lcQueue) << "Rank or suit doesn't match to" << data
+                                    << "for queued" << action.data << "in" << slot
+                                    << "at index" << index << "while flipping";
+            break;
+        }
+    }
+}
+
+template<class C>
+void Queue<C>::clearQueued(int slot)
+{
+    if (auto actions = laterActions(slot))
+        actions->clear();
+}
+
+template<class C>
+Queue<C>::iterator::iterator(Queue<C> *queue, bool atEnd)
+    : queue(queue)
+    , slot(-1)
+    , position(0)
+    , state(atEnd ? EndState : BeginState)
+{
+    ++(*this); // Move forward from BeginState
+}
+
+template<class C>
+void Queue<C>::iterator::operator=(const iterator& other)
+{
+    queue = other.queue;
+    state = other.state;
+    slot = other.slot;
+    position = other.position;
+}
+
+template<class C>
+bool Queue<C>::iterator::operator!=(const iterator& other) const
+{
+    if (queue != other.queue)
+        return true;
+
+    if (state != other.state)
+        return true;
+
+    switch (state) {
+    case BeginState:
+    case EndState:
+        return false;
+    case IterLaterState:
+        if (slot != other.slot)
+            return true;
+        [[fallthrough]];
+    case IterActionsState:
+        return position != other.position;
+    default:
+        Q_UNREACHABLE();
+        break;
+    }
+}
+
+template<class C>
+std::vector<Action> &Queue<C>::iterator::actions() const
+{
+    return state == IterLaterState ? queue->m_laterActions[slot] : queue->m_actions;
+}
+
+template<class C>
+typename Queue<C>::iterator &Queue<C>::iterator::operator++()
+{
+    bool first = false;
+    if (state == BeginState) {
+        position = 0;
+        state = IterActionsState;
+        first = true;
+    }
+    if (state != EndState) {
+        if (state == IterActionsState) {
+            if (!first)
+                ++position;
+            // Iterating m_actions
+            if (position >= int(queue->m_actions.size())) {
+                slot = -1;
+                state = IterLaterState;
+            } else {
+                return *this;
+            }
+        } else {
+            ++position;
+        }
+        // Iterating m_laterActions in slot order
+        while (slot < 0 || position >= int(queue->m_laterActions[slot].size())) {
+            ++slot;
+            position = 0;
+            if (slot >= int(queue->m_laterActions.size())) {
+                qCDebug(lcQueue) << "Iterator reached end";
+                slot = -1;
+                state = EndState;
+                break;
+            }
+        }
+    }
+    return *this;
+}
+
+template<class C>
+Action &Queue<C>::iterator::operator*() const
+{
+    if (state == BeginState || state == EndState)
+        qCCritical(lcQueue) << "Deref queue iterator at" << (state == BeginState ? "beginning" : "end");
+    return actions()[position];
+}
+
+template<class C>
+bool Queue<C>::iterator::requeue()
+{
+    if (state != IterActionsState) {
+        qCWarning(lcQueue) << "Trying to queue an action while in state" << state;
+        qCCritical(lcQueue) << "Discarding" << **this;
+        return false;
+    }
+
+    Action &action = queue->m_actions[position];
+    if (action.type != Engine::InsertionAction) {
+        qCWarning(lcQueue) << "Trying to queue non-insertion action";
+        qCCritical(lcQueue) << "Discarding" << action;
+        return false;
+    }
+
+    action.replaces = true;
+    queue->requeue(action);
+    return true;
+}
+
+template<class C>
+Queue<C>::card_iterator::card_iterator(Queue<C> *queue, bool recent, bool atEnd)
+    : m_queue(queue)
+    , m_recent(recent)
+    , m_value(atEnd ? ValueCount : 0)
+    , m_copy(0)
+{
+    skip();
+}
+
+template<class C>
+bool Queue<C>::card_iterator::operator==(const card_iterator &other) const
+{
+    return m_queue == other.m_queue && m_value == other.m_value && m_copy == other.m_copy;
+}
+
+template<class C>
+bool Queue<C>::card_iterator::operator!=(const card_iterator &other) const
+{
+    return !(*this == other);
+}
+
+template<class C>
+typename Queue<C>::card_iterator &Queue<C>::card_iterator::operator++()
+{
+    ++m_copy;
+    skip();
+    return *this;
+}
+
+template<class C>
+C &Queue<C>::card_iterator::operator*() const
+{
+    return m_queue->stored(m_value, m_copy).card;
+}
+
+template<class C>
+void Queue<C>::card_iterator::skip()
+{
+    // Move forward to the next stored card or to the end
+    while (m_value < ValueCount) {
+        if (m_copy >= m_queue->m_counts[m_value]) {
+            ++m_value;
+            m_copy = 0;
+        } else if (m_recent && !m_queue->stored(m_value, m_copy).recent) {
+            ++m_copy;
+        } else {
+            break;
+        }
+    }
+}
+
+template<class C>
+typename Queue<C>::card_iterator Queue<C>::beginRecent()
+{
+    return card_iterator(this, true);
+}
+
+template<class C>
+typename Queue<C>::card_iterator Queue<C>::endRecent()
+{
+    return card_iterator(this, true, true);
+}
+
+template<class C>
+typename Queue<C>::card_iterator Queue<C>::beginStored()
+{
+    return card_iterator(this, false);
+}
+
+template<class C>
+typename Queue<C>::card_iterator Queue<C>::endStored()
+{
+    return card_iterator(this, false, true);
+}
+
 #endif // QUEUE_H
@@ -15,14 +15,11 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <MGConfItem>
-#include <QSet>
-#include "constants.h"
-#include "gamelist.h"
 #include "gameoptionmodel.h"
 #include "engine.h"
 #include "logging.h"
 #include "patience.h"
+#include "storage.h"
 
 namespace {
 
@@ -55,8 +52,6 @@ quintptr fromOptionsIndex(int i)
 
 } // namespace
 
-const QString OptionsConfTemplate = QStringLiteral("/options/%1");
-
 QHash<int, QByteArray> GameOptionModel::s_roleNames = {
     { Qt::DisplayRole, "display" },
     { SetRole, "set" },
@@ -218,7 +213,7 @@ bool GameOptionModel::setData(const QModelIndex &index, const QVariant &value, i
     } else {
         return false;
     }
-    GameOptionModel::saveOptions(Patience::instance()->gameFile(), m_options);
+    Engine::instance()->storage()->saveOptions(Patience::instance()->gameFile(), m_options);
     return true;
 }
 
@@ -227,44 +222,6 @@ QHash<int, QByteArray> GameOptionModel::roleNames() const
     return s_roleNames;
 }
 
-bool GameOptionModel::loadOptions(const QString &gameFile, GameOptionList &options)
-{
-    MGConfItem optionsConf(Constants::ConfPath + OptionsConfTemplate.arg(GameList::name(gameFile)));
-    auto stored = optionsConf.value();
-    if (stored.isValid()) {
-        auto values = stored.toString().split(';').toSet();
-        qCDebug(lcOptionList) << values.count() << "options stored for" << gameFile;
-        for (int i = 0; i < options.length(); i++) {
-            options[i].set = values.contains(QString::number(options.at(i).index));
-        }
-        return true;
-    }
-    return false;
-}
-
-void GameOptionModel::saveOptions(const QString &gameFile, const GameOptionList &options)
-{
-    MGConfItem optionsConf(Constants::ConfPath + OptionsConfTemplate.arg(GameList::name(gameFile)));
-    if (options.empty()) {
-        optionsConf.unset();
-    } else {
-        QStringList values;
-        for (const GameOption &option : options) {
-            if (option.set)
-                values.append(QString::number(option.index));
-        }
-        optionsConf.set(values.join(';'));
-    }
-    optionsConf.sync();
-}
-
-void GameOptionModel::clearOptions(const QString &gameFile)
-{
-    MGConfItem optionsConf(Constants::ConfPath + OptionsConfTemplate.arg(GameList::name(gameFile)));
-    optionsConf.set(QVariant());
-    optionsConf.sync();
-}
-
 void GameOptionModel::handleGameOptions(GameOptionList options)
 {
     if (!m_options.isEmpty()) {
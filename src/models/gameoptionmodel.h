@@ -37,10 +37,6 @@ public:
     bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
     QHash<int, QByteArray> roleNames() const;
 
-    static bool loadOptions(const QString &gameFile, GameOptionList &options);
-    static void saveOptions(const QString &gameFile, const GameOptionList &options);
-    static void clearOptions(const QString &gameFile);
-
     enum Roles {
         DisplayRole = Qt::DisplayRole,
         SetRole = Qt::UserRole,
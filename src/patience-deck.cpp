@@ -27,14 +27,17 @@
 #include <QScopedPointer>
 #include <QtQml>
 #include <sailfishapp.h>
+#include "confstorage.h"
 #include "constants.h"
 #include "engine.h"
 #include "feedbackevent.h"
 #include "gamelist.h"
 #include "gameoptionmodel.h"
 #include "helpmodel.h"
+#include "journalstorage.h"
 #include "patience.h"
 #include "patiencedeck.h"
+#include "statistics.h"
 #include "table.h"
 #include "texturerenderer.h"
 
@@ -69,6 +72,9 @@ int main(int argc, char *argv[])
     parser.process(*app);
     if (parser.isSet(helpOption))
         parser.showHelp();
+    Engine::instance()->setStorage(new JournalStorage(new ConfStorage(), QString(),
+                                                      JournalStorage::syncPolicy(&parser)));
+    Engine::instance()->setStatistics(new Statistics());
     Engine::setArguments(&parser);
     Table::setArguments(&parser);
     TextureRenderer::setArguments(&parser);
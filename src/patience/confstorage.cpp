@@ -0,0 +1,58 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <MGConfItem>
+#include "confstorage.h"
+#include "constants.h"
+
+ConfStorage::ConfStorage(QObject *parent)
+    : Storage(parent)
+{
+}
+
+QVariant ConfStorage::value(const QString &key) const
+{
+    // Short-lived items so that this works from any thread
+    MGConfItem conf(Constants::ConfPath + key);
+    return conf.value();
+}
+
+void ConfStorage::set(const QString &key, const QVariant &value)
+{
+    MGConfItem conf(Constants::ConfPath + key);
+    if (value.isValid())
+        conf.set(value);
+    else
+        conf.unset();
+}
+
+void ConfStorage::sync()
+{
+    MGConfItem conf(Constants::ConfPath);
+    conf.sync();
+}
+
+void ConfStorage::watch(const QString &key)
+{
+    if (m_watched.contains(key))
+        return;
+    auto conf = new MGConfItem(Constants::ConfPath + key, this);
+    connect(conf, &MGConfItem::valueChanged, this, [this, key] {
+        emit valueChanged(key);
+    });
+    m_watched.insert(key, conf);
+}
@@ -0,0 +1,41 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONFSTORAGE_H
+#define CONFSTORAGE_H
+
+#include <QHash>
+#include "storage.h"
+
+class MGConfItem;
+class ConfStorage : public Storage
+{
+    Q_OBJECT
+
+public:
+    explicit ConfStorage(QObject *parent = nullptr);
+
+    QVariant value(const QString &key) const override;
+    void set(const QString &key, const QVariant &value) override;
+    void sync() override;
+    void watch(const QString &key) override;
+
+private:
+    QHash<QString, MGConfItem *> m_watched;
+};
+
+#endif // CONFSTORAGE_H
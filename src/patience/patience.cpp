@@ -66,6 +66,11 @@ Patience::Patience(QObject *parent)
     if (s_testMode & TestModeEnabled)
         qCInfo(lcTestMode) << "Test mode enabled.";
     auto engine = Engine::instance();
+    // Take elapsed time from another thread :E
+    // This is fine. Trust me, I'm an engineer. ;)
+    // (Patience instance is not going anywhere so we get away with this.)
+    engine->setTimeSource([this] { return elapsedTimeMs(); });
+    m_engineThread.setObjectName(QStringLiteral("Engine"));
     engine->moveToThread(&m_engineThread);
     connect(&m_engineThread, &QThread::started, engine, &Engine::init);
     connect(&m_engineThread, &QThread::finished, engine, &Engine::deleteLater);
@@ -512,9 +517,13 @@ void Patience::handleActionsDisabled(bool disabled)
 
 void Patience::handleCardTextureUpdated()
 {
+    Table *table = qobject_cast<Table *>(sender());
+    if (table && table->cardTexturePreview())
+        return;
     if (s_testMode & TestModeEnabled) {
         s_testMode |= TestModeTextureDrawn;
-        qCInfo(lcTestMode) << "Card texture drawn in test mode.";
+        qCInfo(lcTestMode) << "Card texture drawn in test mode, texture cache"
+                           << (table && table->cardTextureCached() ? "hit." : "miss.");
         testModeCompleted();
     }
 }
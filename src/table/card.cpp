@@ -15,8 +15,6 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <QSGSimpleRectNode>
-#include <QSGSimpleTextureNode>
 #include "table.h"
 #include "card.h"
 #include "constants.h"
@@ -59,48 +57,11 @@ Card::Card(const CardData &card, Table *table, Slot *slot, QObject *parent)
     : QQuickItem(slot)
     , m_table(table)
     , m_data(card)
-    , m_dirty(true)
 {
     setParent(parent);
     setAcceptedMouseButtons(Qt::LeftButton);
-    setFlag(QQuickItem::ItemHasContents);
-    connect(table, &Table::cardTextureUpdated, this, &Card::handleCardTextureUpdated);
-    connect(table, &Table::doubleResolutionChanged, this, &Card::handleDoubleResolutionChanged);
-}
-
-QSGNode *Card::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
-{
-    auto texture = m_table->cardTexture();
-    if (!texture)
-        return nullptr;
-
-    auto *node = static_cast<QSGSimpleTextureNode *>(oldNode);
-    if (!node || m_dirty) {
-        if (!node)
-            node = new QSGSimpleTextureNode();
-        node->setTexture(texture);
-        int column = getColumn(show() ? rank() : CardBack);
-        int row = getRow(show() ? rank() : CardBack, suit());
-        QSizeF size = m_table->cardSizeInTexture();
-        QRect rect(column * size.width(), row * size.height(), size.width(), size.height());
-        node->setSourceRect(rect);
-        if (node->childCount() > 0)
-            static_cast<QSGSimpleRectNode *>(node->firstChild())->setRect(boundingRect());
-        m_dirty = false;
-    }
-    if (highlighted()) {
-        if (node->childCount() < 1) {
-            auto color = m_table->highlightColor();
-            auto child = new QSGSimpleRectNode(boundingRect(), color);
-            child->setFlag(QSGNode::OwnedByParent);
-            node->appendChildNode(child);
-        }
-    } else { // !highlighted()
-        if (node->childCount() > 0)
-            node->removeAllChildNodes();
-    }
-    node->setRect(boundingRect());
-    return node;
+    // Table draws all cards, this item is only for input
+    connect(this, &QQuickItem::zChanged, table, &Table::updateCards);
 }
 
 QSizeF Card::size() const
@@ -111,7 +72,6 @@ QSizeF Card::size() const
 void Card::setSize(const QSizeF &size)
 {
     if (width() != size.width() || height() != size.height()) {
-        m_dirty = true;
         setWidth(size.width());
         setHeight(size.height());
     }
@@ -149,10 +109,16 @@ void Card::moveTo(QQuickItem *item)
     }
 }
 
-void Card::shred()
+// Sets up a card that was released to the pool as if it was new
+void Card::reuse(const CardData &card, Slot *slot)
 {
-    setParentItem(nullptr);
-    deleteLater();
+    m_data = card;
+    m_table->updateCards();
+    setKeepMouseGrab(false);
+    setParentItem(slot);
+    setPosition(QPointF());
+    setZ(0);
+    setVisible(true);
 }
 
 Suit Card::suit() const
@@ -189,7 +155,7 @@ void Card::setShow(bool show)
 {
     if (m_data.show != show) {
         m_data.show = show;
-        m_dirty = true;
+        m_table->updateCards();
     }
 }
 
@@ -198,16 +164,32 @@ bool Card::operator==(const Card &other) const
     return m_data == other.m_data;
 }
 
-void Card::handleCardTextureUpdated()
+// Index of the color the card is tinted with, back first and then suits
+int Card::colorClass() const
+{
+    return show() ? suit() + 1 : 0;
+}
+
+// Area of this card in the card texture in pixels
+QRect Card::sourceRect() const
+{
+    int column = getColumn(show() ? rank() : CardBack);
+    int row = getRow(show() ? rank() : CardBack, suit());
+    QSizeF size = m_table->cardSizeInTexture();
+    return QRect(column * size.width(), row * size.height(), size.width(), size.height());
+}
+
+void Card::geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry)
 {
-    m_dirty = true;
-    update();
+    QQuickItem::geometryChanged(newGeometry, oldGeometry);
+    m_table->updateCards();
 }
 
-void Card::handleDoubleResolutionChanged()
+void Card::itemChange(ItemChange change, const ItemChangeData &value)
 {
-    m_dirty = true;
-    update();
+    if (change == ItemParentHasChanged || change == ItemVisibleHasChanged)
+        m_table->updateCards();
+    QQuickItem::itemChange(change, value);
 }
 
 void Card::mousePressEvent(QMouseEvent *event)
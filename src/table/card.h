@@ -22,9 +22,6 @@
 #include "enginedata.h"
 #include "drag.h"
 
-class QQuickWindow;
-class QSvgRenderer;
-class QSGTexture;
 class Table;
 class Slot;
 class Card : public QQuickItem
@@ -34,42 +31,40 @@ class Card : public QQuickItem
 public:
     Card(const CardData &card, Table *table, Slot *slot, QObject *parent = nullptr);
 
-    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *);
-
     QSizeF size() const;
     void setSize(const QSizeF &size);
     QPointF topLeft() const;
     void setTopLeft(const QPointF &topLeft);
     QPointF center() const;
     void moveTo(QQuickItem *item);
-    void shred();
+    void reuse(const CardData &card, Slot *slot);
 
     Suit suit() const;
     Rank rank() const;
     bool show() const;
     void setShow(bool show);
     bool isBlack() const;
+    int colorClass() const;
 
     Slot *slot() const;
     CardData data() const;
     SuitAndRank value() const;
+    QRect sourceRect() const;
+    bool highlighted() const;
 
     bool operator==(const Card &other) const;
 
-private slots:
-    void handleCardTextureUpdated();
-    void handleDoubleResolutionChanged();
+protected:
+    void geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+    void itemChange(ItemChange change, const ItemChangeData &value) override;
 
 private:
     void mousePressEvent(QMouseEvent *event);
     void mouseReleaseEvent(QMouseEvent *event);
     void mouseMoveEvent(QMouseEvent *event);
 
-    bool highlighted() const;
-
     Table *m_table;
     CardData m_data;
-    bool m_dirty;
 };
 
 QDebug operator<<(QDebug debug, const Card *card);
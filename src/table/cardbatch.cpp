@@ -0,0 +1,306 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QSGMaterial>
+#include <QSGTexture>
+#include <QVector4D>
+#include "cardbatch.h"
+#include "logging.h"
+
+namespace {
+
+// Grow in steps of a deck to avoid reallocating when cards are added one by one
+const int CapacityStep = 52;
+
+struct CardVertex {
+    float x;
+    float y;
+    float tx;
+    float ty;
+    float colorClass;
+    unsigned char r;
+    unsigned char g;
+    unsigned char b;
+    unsigned char a;
+
+    void set(float nx, float ny, float ntx, float nty, int ncolorClass, const QColor &tint)
+    {
+        x = nx;
+        y = ny;
+        tx = ntx;
+        ty = nty;
+        colorClass = ncolorClass;
+        // Premultiplied like everything else in the scene graph
+        r = tint.red() * tint.alpha() / 255;
+        g = tint.green() * tint.alpha() / 255;
+        b = tint.blue() * tint.alpha() / 255;
+        a = tint.alpha();
+    }
+};
+
+const QSGGeometry::AttributeSet &cardAttributes()
+{
+    static QSGGeometry::Attribute attributes[] = {
+        QSGGeometry::Attribute::create(0, 2, GL_FLOAT, true),
+        QSGGeometry::Attribute::create(1, 2, GL_FLOAT),
+        QSGGeometry::Attribute::create(2, 1, GL_FLOAT),
+        QSGGeometry::Attribute::create(3, 4, GL_UNSIGNED_BYTE),
+    };
+    static QSGGeometry::AttributeSet set = { 4, sizeof(CardVertex), attributes };
+    return set;
+}
+
+} // namespace
+
+class CardBatchMaterial : public QSGMaterial
+{
+public:
+    CardBatchMaterial()
+        : texture(nullptr)
+        , maskOffset(0)
+        , colors(CardBatchNode::ColorCount, QColor(Qt::black))
+    {
+        setFlag(Blending);
+    }
+
+    QSGMaterialType *type() const override
+    {
+        static QSGMaterialType type;
+        return &type;
+    }
+
+    QSGMaterialShader *createShader() const override;
+
+    int compare(const QSGMaterial *other) const override
+    {
+        auto material = static_cast<const CardBatchMaterial *>(other);
+        if (texture != material->texture)
+            return texture < material->texture ? -1 : 1;
+        for (int i = 0; i < colors.count(); i++) {
+            if (colors.at(i) != material->colors.at(i))
+                return colors.at(i).rgba() < material->colors.at(i).rgba() ? -1 : 1;
+        }
+        return 0;
+    }
+
+    QSGTexture *texture;
+    float maskOffset;
+    QVector<QColor> colors;
+};
+
+class CardBatchShader : public QSGMaterialShader
+{
+public:
+    const char *vertexShader() const override
+    {
+        // Uniform arrays can be indexed freely only in vertex shaders on GLES 2
+        return "attribute highp vec4 qt_Vertex;\n"
+               "attribute highp vec2 qt_MultiTexCoord0;\n"
+               "attribute highp float colorClass;\n"
+               "attribute lowp vec4 tint;\n"
+               "uniform highp mat4 qt_Matrix;\n"
+               "uniform highp float maskOffset;\n"
+               "uniform lowp vec4 colors[5];\n"
+               "varying highp vec2 coord;\n"
+               "varying highp vec2 maskCoord;\n"
+               "varying lowp vec4 color;\n"
+               "varying lowp vec4 cardColor;\n"
+               "void main() {\n"
+               "    coord = qt_MultiTexCoord0;\n"
+               "    maskCoord = vec2(coord.x, coord.y + maskOffset);\n"
+               "    color = tint;\n"
+               "    cardColor = colors[int(colorClass)];\n"
+               "    gl_Position = qt_Matrix * qt_Vertex;\n"
+               "}\n";
+    }
+
+    const char *fragmentShader() const override
+    {
+        /*
+         * Card color is added where the mask says it is visible, then
+         * highlight is blended over the card but not over its transparent corners
+         */
+        return "uniform sampler2D qt_Texture;\n"
+               "uniform lowp float qt_Opacity;\n"
+               "varying highp vec2 coord;\n"
+               "varying highp vec2 maskCoord;\n"
+               "varying lowp vec4 color;\n"
+               "varying lowp vec4 cardColor;\n"
+               "void main() {\n"
+               "    lowp vec4 card = texture2D(qt_Texture, coord);\n"
+               "    card.rgb += cardColor.rgb * texture2D(qt_Texture, maskCoord).a;\n"
+               "    gl_FragColor = vec4(card.rgb * (1.0 - color.a) + color.rgb * card.a, card.a) * qt_Opacity;\n"
+               "}\n";
+    }
+
+    char const *const *attributeNames() const override
+    {
+        static const char *names[] = { "qt_Vertex", "qt_MultiTexCoord0", "colorClass", "tint", nullptr };
+        return names;
+    }
+
+    void updateState(const RenderState &state, QSGMaterial *newMaterial, QSGMaterial *oldMaterial) override
+    {
+        if (state.isMatrixDirty())
+            program()->setUniformValue(m_matrixId, state.combinedMatrix());
+        if (state.isOpacityDirty())
+            program()->setUniformValue(m_opacityId, state.opacity());
+
+        auto material = static_cast<CardBatchMaterial *>(newMaterial);
+        auto previous = static_cast<CardBatchMaterial *>(oldMaterial);
+        if (!previous || previous->colors != material->colors) {
+            QVector<QVector4D> colors;
+            for (const QColor &color : material->colors)
+                colors.append(QVector4D(color.redF(), color.greenF(), color.blueF(), color.alphaF()));
+            program()->setUniformValueArray(m_colorsId, colors.constData(), colors.count());
+        }
+        program()->setUniformValue(m_maskOffsetId, material->maskOffset);
+        if (material->texture)
+            material->texture->bind();
+    }
+
+private:
+    void initialize() override
+    {
+        m_matrixId = program()->uniformLocation("qt_Matrix");
+        m_opacityId = program()->uniformLocation("qt_Opacity");
+        m_maskOffsetId = program()->uniformLocation("maskOffset");
+        m_colorsId = program()->uniformLocation("colors");
+    }
+
+    int m_matrixId;
+    int m_opacityId;
+    int m_maskOffsetId;
+    int m_colorsId;
+};
+
+QSGMaterialShader *CardBatchMaterial::createShader() const
+{
+    return new CardBatchShader;
+}
+
+CardBatchNode::CardBatchNode()
+    : m_material(new CardBatchMaterial)
+    , m_texture(nullptr)
+    , m_count(0)
+{
+    auto geometry = new QSGGeometry(cardAttributes(), 0, 0, GL_UNSIGNED_SHORT);
+    geometry->setDrawingMode(GL_TRIANGLES);
+    geometry->setVertexDataPattern(QSGGeometry::DynamicPattern);
+    geometry->setIndexDataPattern(QSGGeometry::StaticPattern);
+    setGeometry(geometry);
+    setMaterial(m_material);
+    setFlags(QSGNode::OwnsGeometry | QSGNode::OwnsMaterial);
+}
+
+void CardBatchNode::setTexture(QSGTexture *texture)
+{
+    m_texture = texture;
+    m_material->texture = texture;
+    if (texture) {
+        m_textureRect = texture->normalizedTextureSubRect();
+        m_textureSize = texture->textureSize();
+        m_material->maskOffset = m_textureRect.height() / 2;
+    }
+    markDirty(QSGNode::DirtyMaterial);
+}
+
+// Colors for the classes of the mask in the texture
+void CardBatchNode::setColors(const QVector<QColor> &colors)
+{
+    if (colors.count() != ColorCount) {
+        qCWarning(lcTable) << "Expected" << ColorCount << "card colors, got" << colors.count();
+        return;
+    }
+    if (m_material->colors != colors) {
+        m_material->colors = colors;
+        markDirty(QSGNode::DirtyMaterial);
+    }
+}
+
+void CardBatchNode::setCount(int count)
+{
+    if (count > capacity())
+        reserve(count);
+    // Collapse quads that are no longer used
+    auto *vertices = static_cast<CardVertex *>(geometry()->vertexData());
+    for (int i = count * 4; i < m_count * 4; i++)
+        vertices[i].set(0, 0, 0, 0, 0, Qt::transparent);
+    m_count = count;
+}
+
+// Source is the card's area in the texture in pixels
+void CardBatchNode::setCard(int index, const QRectF &rect, const QRect &source, int colorClass, const QColor &tint)
+{
+    if (!m_texture || index >= m_count)
+        return;
+
+    qreal left = m_textureRect.x() + source.left() / m_textureSize.width() * m_textureRect.width();
+    qreal right = m_textureRect.x() + (source.left() + source.width()) / m_textureSize.width() * m_textureRect.width();
+    qreal top = m_textureRect.y() + source.top() / m_textureSize.height() * m_textureRect.height();
+    qreal bottom = m_textureRect.y() + (source.top() + source.height()) / m_textureSize.height() * m_textureRect.height();
+
+    auto *vertex = static_cast<CardVertex *>(geometry()->vertexData()) + index * 4;
+    vertex[0].set(rect.left(), rect.top(), left, top, colorClass, tint);
+    vertex[1].set(rect.right(), rect.top(), right, top, colorClass, tint);
+    vertex[2].set(rect.left(), rect.bottom(), left, bottom, colorClass, tint);
+    vertex[3].set(rect.right(), rect.bottom(), right, bottom, colorClass, tint);
+}
+
+void CardBatchNode::commit()
+{
+    markDirty(QSGNode::DirtyGeometry);
+}
+
+int CardBatchNode::count() const
+{
+    return m_count;
+}
+
+int CardBatchNode::capacity() const
+{
+    return geometry()->vertexCount() / 4;
+}
+
+// Contents are lost, cards must be set again after this
+void CardBatchNode::reserve(int count)
+{
+    int capacity = (count + CapacityStep - 1) / CapacityStep * CapacityStep;
+    qCDebug(lcTable) << "Reserving room for" << capacity << "cards";
+
+    QSGGeometry *geometry = this->geometry();
+    geometry->allocate(capacity * 4, capacity * 6);
+    auto *vertices = static_cast<CardVertex *>(geometry->vertexData());
+    for (int i = 0; i < capacity * 4; i++)
+        vertices[i].set(0, 0, 0, 0, 0, Qt::transparent);
+
+    // Two triangles for every card
+    quint16 *indices = geometry->indexDataAsUShort();
+    for (int i = 0; i < capacity; i++) {
+        quint16 first = i * 4;
+        indices[i * 6] = first;
+        indices[i * 6 + 1] = first + 1;
+        indices[i * 6 + 2] = first + 2;
+        indices[i * 6 + 3] = first + 2;
+        indices[i * 6 + 4] = first + 1;
+        indices[i * 6 + 5] = first + 3;
+    }
+    m_count = 0;
+    markDirty(QSGNode::DirtyGeometry);
+}
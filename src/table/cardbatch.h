@@ -0,0 +1,65 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CARDBATCH_H
+#define CARDBATCH_H
+
+#include <QColor>
+#include <QRectF>
+#include <QSGGeometryNode>
+#include <QVector>
+
+class QSGTexture;
+class CardBatchMaterial;
+
+/*
+ * Draws all cards on the table as quads of one geometry.
+ *
+ * Quads are drawn in the order they are set, so the last card is on top.
+ * Highlighted cards are tinted per vertex instead of drawing another node
+ * on top of them. The lower half of the texture is a mask for card colors,
+ * which are uniforms picked by the color class of each card. The geometry
+ * only grows, unused quads are left empty. Every card must be set again
+ * after the count changes.
+ */
+class CardBatchNode : public QSGGeometryNode
+{
+public:
+    static const int ColorCount = 5;
+
+    CardBatchNode();
+
+    void setTexture(QSGTexture *texture);
+    void setColors(const QVector<QColor> &colors);
+    void setCount(int count);
+    void setCard(int index, const QRectF &rect, const QRect &source, int colorClass, const QColor &tint);
+    void commit();
+
+    int count() const;
+    int capacity() const;
+
+private:
+    void reserve(int count);
+
+    CardBatchMaterial *m_material;
+    QSGTexture *m_texture;
+    QRectF m_textureRect;
+    QSizeF m_textureSize;
+    int m_count;
+};
+
+#endif // CARDBATCH_H
@@ -0,0 +1,181 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QAtomicInt>
+#include <QPainter>
+#include <QRunnable>
+#include <QStringList>
+#include <QSvgRenderer>
+#include <QThread>
+#include <QVector>
+#include "cardrasterizer.h"
+#include "logging.h"
+
+namespace {
+
+const int Columns = 13;
+const int Rows = 5;
+const QImage::Format TextureFormat = QImage::Format_ARGB32_Premultiplied;
+
+const QStringList SuitNames = {
+    QStringLiteral("club"),
+    QStringLiteral("diamond"),
+    QStringLiteral("heart"),
+    QStringLiteral("spade"),
+};
+const QStringList RankNames = {
+    QStringLiteral("1"), QStringLiteral("2"), QStringLiteral("3"), QStringLiteral("4"),
+    QStringLiteral("5"), QStringLiteral("6"), QStringLiteral("7"), QStringLiteral("8"),
+    QStringLiteral("9"), QStringLiteral("10"), QStringLiteral("jack"), QStringLiteral("queen"),
+    QStringLiteral("king"),
+};
+// In the same columns as in getColumn() of card.cpp
+const QStringList ExtraNames = {
+    QStringLiteral("joker_black"),
+    QStringLiteral("joker_red"),
+    QStringLiteral("back"),
+};
+
+struct Cell {
+    QString id;
+    int column;
+    int row;
+};
+
+QVector<Cell> getCells()
+{
+    QVector<Cell> cells;
+    for (int row = 0; row < SuitNames.count(); row++) {
+        for (int column = 0; column < RankNames.count(); column++)
+            cells.append({ QStringLiteral("%1_%2").arg(SuitNames.at(row), RankNames.at(column)), column, row });
+    }
+    for (int column = 0; column < ExtraNames.count(); column++)
+        cells.append({ ExtraNames.at(column), column, Rows - 1 });
+    return cells;
+}
+
+const QVector<Cell> Cells = getCells();
+
+QRect cellRect(const Cell &cell, const QSize &size)
+{
+    qreal width = qreal(size.width()) / Columns;
+    qreal height = qreal(size.height()) / Rows;
+    return QRectF(cell.column * width, cell.row * height, width, height).toAlignedRect();
+}
+
+// Places the card where drawing the whole document to the sheet would put it
+QImage drawCell(QSvgRenderer *renderer, const Cell &cell, const QSize &size)
+{
+    QRect rect = cellRect(cell, size);
+    QImage image(rect.size(), TextureFormat);
+    image.fill(Qt::transparent);
+    if (!renderer->elementExists(cell.id)) {
+        qCWarning(lcRenderer) << "Card" << cell.id << "is missing from the document";
+        return image;
+    }
+
+    QRectF viewBox = renderer->viewBoxF();
+    qreal scaleX = size.width() / viewBox.width();
+    qreal scaleY = size.height() / viewBox.height();
+    QRectF bounds = renderer->matrixForElement(cell.id).mapRect(renderer->boundsOnElement(cell.id));
+    QRectF target((bounds.x() - viewBox.x()) * scaleX - rect.x(),
+                  (bounds.y() - viewBox.y()) * scaleY - rect.y(),
+                  bounds.width() * scaleX, bounds.height() * scaleY);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    renderer->render(&painter, cell.id, target);
+    return image;
+}
+
+} // namespace
+
+class CardRasterizer::Job : public QRunnable
+{
+public:
+    Job(const QByteArray &document, std::unique_ptr<QSvgRenderer> &renderer,
+        const QSize &size, QAtomicInt &next, QVector<QImage> &images)
+        : m_document(document)
+        , m_renderer(renderer)
+        , m_size(size)
+        , m_next(next)
+        , m_images(images)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        if (!m_renderer)
+            m_renderer.reset(new QSvgRenderer(m_document));
+        for (int i = m_next.fetchAndAddRelaxed(1); i < Cells.count(); i = m_next.fetchAndAddRelaxed(1))
+            m_images[i] = drawCell(m_renderer.get(), Cells.at(i), m_size);
+    }
+
+private:
+    const QByteArray &m_document;
+    std::unique_ptr<QSvgRenderer> &m_renderer;
+    QSize m_size;
+    QAtomicInt &m_next;
+    QVector<QImage> &m_images;
+};
+
+CardRasterizer::CardRasterizer()
+{
+}
+
+CardRasterizer::~CardRasterizer()
+{
+    m_pool.waitForDone();
+}
+
+void CardRasterizer::setDocument(const QByteArray &document)
+{
+    m_document = document;
+    m_renderers.clear();
+}
+
+QImage CardRasterizer::rasterize(const QSize &size, int threads)
+{
+    threads = qBound(1, threads, Cells.count());
+    if (int(m_renderers.size()) < threads)
+        m_renderers.resize(threads);
+    m_pool.setMaxThreadCount(qMax(1, threads - 1));
+
+    QAtomicInt next(0);
+    QVector<QImage> images(Cells.count());
+    std::vector<std::unique_ptr<Job>> jobs;
+    for (int i = 0; i < threads; i++)
+        jobs.emplace_back(new Job(m_document, m_renderers[i], size, next, images));
+    for (int i = 1; i < threads; i++)
+        m_pool.start(jobs[i].get());
+    jobs[0]->run();
+    m_pool.waitForDone();
+
+    QImage sheet(size, TextureFormat);
+    sheet.fill(Qt::transparent);
+    QPainter painter(&sheet);
+    // Cells may overlap by a pixel when the card size is fractional
+    for (int i = 0; i < Cells.count(); i++)
+        painter.drawImage(cellRect(Cells.at(i), size).topLeft(), images.at(i));
+    return sheet;
+}
+
+int CardRasterizer::idealThreadCount()
+{
+    return qMax(1, QThread::idealThreadCount());
+}
@@ -0,0 +1,59 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CARDRASTERIZER_H
+#define CARDRASTERIZER_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QSize>
+#include <QThreadPool>
+#include <memory>
+#include <vector>
+
+class QSvgRenderer;
+
+/*
+ * Draws the card sheet one card at a time on a pool of threads.
+ *
+ * QSvgRenderer is not thread safe, so every worker parses the document
+ * into its own renderer the first time it is used. The renderers are
+ * kept until the document changes. Cards are handed out one by one, so a
+ * worker that gets a slow face card does not hold up the others. The
+ * calling thread works too. Cells are laid out like Card expects: ranks
+ * in columns, suits in rows, and the jokers and the back on the last row.
+ */
+class CardRasterizer
+{
+public:
+    CardRasterizer();
+    ~CardRasterizer();
+
+    void setDocument(const QByteArray &document);
+    QImage rasterize(const QSize &size, int threads);
+
+    static int idealThreadCount();
+
+private:
+    class Job;
+
+    QByteArray m_document;
+    std::vector<std::unique_ptr<QSvgRenderer>> m_renderers;
+    QThreadPool m_pool;
+};
+
+#endif // CARDRASTERIZER_H
@@ -51,6 +51,8 @@ Drag::Drag(QMouseEvent *event, Table *table, Card *card, Selection *selection)
     setParentItem(table);
     setX(m_source->x());
     setY(m_source->y());
+    connect(this, &QQuickItem::xChanged, table, &Table::updateCards);
+    connect(this, &QQuickItem::yChanged, table, &Table::updateCards);
 
     auto engine = Engine::instance();
     connect(this, &Drag::doDrag, engine, &Engine::drag);
@@ -43,9 +43,14 @@ Slot::Slot(int id, SlotType type, double x, double y, int expansionDepth,
                 | expandedRight ? ExpandsInX : DoesNotExpand)
     , m_expansionDepth(expansionDepth)
     , m_firstExpandedValid(false)
+    , m_locationsDirty(false)
     , m_highlighted(false)
     , m_firstHighlightedCard(nullptr)
 {
+    // Table draws the cards, they move with the slot
+    connect(this, &QQuickItem::xChanged, table, &Table::updateCards);
+    connect(this, &QQuickItem::yChanged, table, &Table::updateCards);
+    connect(this, &QQuickItem::zChanged, table, &Table::updateCards);
 }
 
 void Slot::updateDimensions()
@@ -66,16 +71,19 @@ void Slot::updateDimensions()
     updateLocations();
 }
 
-void Slot::updateLocations()
+int Slot::updateLocations()
 {
-    updateLocations(begin());
+    m_locationsDirty = false;
+    return updateLocations(begin());
 }
 
-void Slot::updateLocations(iterator first)
+// Returns the number of properties written
+int Slot::updateLocations(iterator first)
 {
     if (reevaluateDelta())
         first = begin();
 
+    int writes = 0;
     for (auto it = first; it != end(); ++it) {
         Card *card = *it;
         if (card) {
@@ -91,8 +99,16 @@ void Slot::updateLocations(iterator first)
                 card->setX(0);
                 card->setY(0);
             }
+            writes += 4;
         }
     }
+    return writes;
+}
+
+// Lays out cards once after a move instead of after every change
+int Slot::updateDirtyLocations()
+{
+    return m_locationsDirty ? updateLocations() : 0;
 }
 
 QPointF Slot::nextPosition() const
@@ -156,9 +172,7 @@ void Slot::insert(int index, Card *card)
     m_firstExpandedValid = false;
     if (card)
         card->moveTo(this);
-    // TODO: Do adjustments once move ends
-    if (!m_table->preparing())
-        updateLocations();
+    m_locationsDirty = true;
     qCDebug(lcSlot) << "Inserted" << card << "to" << this;
 }
 
@@ -171,9 +185,7 @@ void Slot::set(int index, Card *card)
     } else {
         m_cards.replace(index, card);
         card->moveTo(this);
-        // TODO: Do adjustments once move ends
-        if (!m_table->preparing())
-            updateLocations();
+        m_locationsDirty = true;
         qCDebug(lcSlot) << "Replaced" << card << "at" << this << "index" << index;
     }
 }
@@ -184,8 +196,7 @@ Card *Slot::takeAt(int index)
     m_firstExpandedValid = false;
     if (card == m_firstHighlightedCard)
         m_firstHighlightedCard = nullptr;
-    if (!m_table->preparing())
-        updateLocations();
+    m_locationsDirty = true;
     qCDebug(lcSlot) << "Removed" << card << "from" << this;
     if (isEmpty())
         emit slotEmptied();
@@ -207,20 +218,16 @@ void Slot::highlight(Card *card)
 {
     m_highlighted = true;
     m_firstHighlightedCard = card;
-    if (!isEmpty()) {
-        for (auto it = find(card ?: top()); it != end(); ++it)
-            (*it)->update();
-    }
+    if (!isEmpty())
+        m_table->updateCards();
     qCDebug(lcSlot) << this << "is now highlighted";
 }
 
 void Slot::removeHighlight()
 {
     m_highlighted = false;
-    if (!isEmpty()) {
-        for (auto it = find(m_firstHighlightedCard ?: top()); it != end(); ++it)
-            (*it)->update();
-    }
+    if (!isEmpty())
+        m_table->updateCards();
     m_firstHighlightedCard = nullptr;
     qCDebug(lcSlot) << this << "is no longer highlighted";
 }
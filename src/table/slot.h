@@ -55,8 +55,9 @@ public:
          bool expandedDown, bool expandedRight, Table *table);
 
     void updateDimensions();
-    void updateLocations();
-    void updateLocations(iterator iter);
+    int updateLocations();
+    int updateLocations(iterator iter);
+    int updateDirtyLocations();
     QPointF nextPosition() const;
 
     int id() const;
@@ -107,6 +108,7 @@ private:
     int m_expansionDepth;
     mutable const_iterator m_firstExpanded;
     mutable bool m_firstExpandedValid;
+    bool m_locationsDirty;
     bool m_highlighted;
     Card *m_firstHighlightedCard;
 };
@@ -0,0 +1,147 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QSGVertexColorMaterial>
+#include "logging.h"
+#include "slotbatch.h"
+
+namespace {
+
+const int BackgroundVertices = 4;
+const int BackgroundIndices = 6;
+// Outline is a ring of eight triangles, highlight is a quad
+const int SlotVertices = 12;
+const int SlotIndices = 30;
+
+void setColor(QSGGeometry::ColoredPoint2D &vertex, float x, float y, const QColor &color)
+{
+    // Premultiplied like everything else in the scene graph
+    vertex.set(x, y,
+               color.red() * color.alpha() / 255,
+               color.green() * color.alpha() / 255,
+               color.blue() * color.alpha() / 255,
+               color.alpha());
+}
+
+void setQuad(QSGGeometry::ColoredPoint2D *vertex, const QRectF &rect, const QColor &color)
+{
+    if (!color.alpha()) {
+        for (int i = 0; i < 4; i++)
+            setColor(vertex[i], 0, 0, Qt::transparent);
+        return;
+    }
+    setColor(vertex[0], rect.left(), rect.top(), color);
+    setColor(vertex[1], rect.right(), rect.top(), color);
+    setColor(vertex[2], rect.left(), rect.bottom(), color);
+    setColor(vertex[3], rect.right(), rect.bottom(), color);
+}
+
+void setQuadIndices(quint16 *indices, quint16 first)
+{
+    indices[0] = first;
+    indices[1] = first + 1;
+    indices[2] = first + 2;
+    indices[3] = first + 2;
+    indices[4] = first + 1;
+    indices[5] = first + 3;
+}
+
+} // namespace
+
+SlotBatchNode::SlotBatchNode()
+{
+    auto geometry = new QSGGeometry(QSGGeometry::defaultAttributes_ColoredPoint2D(),
+                                    BackgroundVertices, BackgroundIndices, GL_UNSIGNED_SHORT);
+    geometry->setDrawingMode(GL_TRIANGLES);
+    geometry->setVertexDataPattern(QSGGeometry::StaticPattern);
+    geometry->setIndexDataPattern(QSGGeometry::StaticPattern);
+    setGeometry(geometry);
+    setMaterial(new QSGVertexColorMaterial);
+    setFlags(QSGNode::OwnsGeometry | QSGNode::OwnsMaterial);
+    setSlotCount(0);
+}
+
+void SlotBatchNode::setBackground(const QRectF &rect, const QColor &color)
+{
+    setQuad(geometry()->vertexDataAsColoredPoint2D(), rect, color);
+}
+
+// Contents are lost, background and slots must be set again after this
+void SlotBatchNode::setSlotCount(int count)
+{
+    QSGGeometry *geometry = this->geometry();
+    if (count != slotCount()) {
+        qCDebug(lcTable) << "Allocating room for" << count << "slots";
+        geometry->allocate(BackgroundVertices + count * SlotVertices,
+                           BackgroundIndices + count * SlotIndices);
+    }
+
+    auto *vertices = geometry->vertexDataAsColoredPoint2D();
+    for (int i = 0; i < geometry->vertexCount(); i++)
+        setColor(vertices[i], 0, 0, Qt::transparent);
+
+    quint16 *indices = geometry->indexDataAsUShort();
+    setQuadIndices(indices, 0);
+    for (int i = 0; i < count; i++) {
+        quint16 first = BackgroundVertices + i * SlotVertices;
+        quint16 *index = indices + BackgroundIndices + i * SlotIndices;
+        // Two triangles for every side of the outline
+        for (int side = 0; side < 4; side++) {
+            quint16 outer = first + side * 2;
+            quint16 nextOuter = first + (side + 1) % 4 * 2;
+            index[side * 6] = outer;
+            index[side * 6 + 1] = outer + 1;
+            index[side * 6 + 2] = nextOuter;
+            index[side * 6 + 3] = nextOuter;
+            index[side * 6 + 4] = outer + 1;
+            index[side * 6 + 5] = nextOuter + 1;
+        }
+        setQuadIndices(index + 24, first + 8);
+    }
+    markDirty(QSGNode::DirtyGeometry);
+}
+
+// Rect is the outer edge of the outline, highlight covers all of it
+void SlotBatchNode::setSlot(int index, const QRectF &rect, qreal outlineWidth,
+                            const QColor &outlineColor, const QColor &highlightColor)
+{
+    if (index < 0 || index >= slotCount())
+        return;
+
+    auto *vertex = geometry()->vertexDataAsColoredPoint2D() + BackgroundVertices + index * SlotVertices;
+    QRectF inside = rect - QMarginsF(outlineWidth, outlineWidth, outlineWidth, outlineWidth);
+    // Outer and inner corner in pairs going clockwise from top left
+    setColor(vertex[0], rect.left(), rect.top(), outlineColor);
+    setColor(vertex[1], inside.left(), inside.top(), outlineColor);
+    setColor(vertex[2], rect.right(), rect.top(), outlineColor);
+    setColor(vertex[3], inside.right(), inside.top(), outlineColor);
+    setColor(vertex[4], rect.right(), rect.bottom(), outlineColor);
+    setColor(vertex[5], inside.right(), inside.bottom(), outlineColor);
+    setColor(vertex[6], rect.left(), rect.bottom(), outlineColor);
+    setColor(vertex[7], inside.left(), inside.bottom(), outlineColor);
+    setQuad(vertex + 8, rect, highlightColor);
+}
+
+void SlotBatchNode::commit()
+{
+    markDirty(QSGNode::DirtyGeometry);
+}
+
+int SlotBatchNode::slotCount() const
+{
+    return (geometry()->vertexCount() - BackgroundVertices) / SlotVertices;
+}
@@ -0,0 +1,47 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SLOTBATCH_H
+#define SLOTBATCH_H
+
+#include <QColor>
+#include <QRectF>
+#include <QSGGeometryNode>
+
+/*
+ * Draws the table background and all slot outlines and highlights as
+ * triangles of one geometry with per vertex colors.
+ *
+ * The background comes first, then every slot as an outline followed by
+ * its highlight. Fully transparent parts are collapsed so that they cost
+ * nothing to draw. Geometry is only reallocated when the slot count changes.
+ */
+class SlotBatchNode : public QSGGeometryNode
+{
+public:
+    SlotBatchNode();
+
+    void setBackground(const QRectF &rect, const QColor &color);
+    void setSlotCount(int count);
+    void setSlot(int index, const QRectF &rect, qreal outlineWidth,
+                 const QColor &outlineColor, const QColor &highlightColor);
+    void commit();
+
+    int slotCount() const;
+};
+
+#endif // SLOTBATCH_H
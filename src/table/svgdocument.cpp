@@ -15,8 +15,10 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <QDomDocument>
 #include <QFile>
+#include <QVector>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
 #include "logging.h"
 #include "svgdocument.h"
 
@@ -27,133 +29,91 @@ const QString StyleAttribute = QStringLiteral("style");
 const QString FillStyle = QStringLiteral("fill");
 const QString StrokeStyle = QStringLiteral("stroke");
 const QString StyleTemplate = QStringLiteral("%1:%2");
+const QString NamespaceAttribute = QStringLiteral("xmlns");
+const QString PrefixedNamespaceAttribute = QStringLiteral("xmlns:%1");
 
-class DomDocumentIterator {
-    DomDocumentIterator(QDomDocument &document, bool atEnd = false)
-        : mDocument(document)
-    {
-        if (!atEnd) {
-            mCurrent = document.documentElement();
-        } else {
-            mCurrent = QDomElement();
-            if (!mCurrent.isNull())
-                qCCritical(lcTable) << "End iterator is not at end!";
-        }
-    }
-
-public:
-    static DomDocumentIterator begin(QDomDocument &document)
-    {
-        return DomDocumentIterator(document);
-    }
-
-    static DomDocumentIterator end(QDomDocument &document)
-    {
-        return DomDocumentIterator(document, true);
-    }
-
-    void operator=(const DomDocumentIterator& other)
-    {
-        mDocument = other.mDocument;
-        mCurrent = other.mCurrent;
-    }
-
-    bool operator!=(const DomDocumentIterator& other) const
-    {
-        if (&mDocument != &other.mDocument)
-            return true;
-        if (mCurrent.isNull() && other.mCurrent.isNull())
-            return false;
-        return mCurrent != other.mCurrent;
-    }
-
-    DomDocumentIterator &operator++()
-    {
-        if (!mCurrent.isNull()) {
-            /*
-             * Try child, if available use that.
-             * Otherwise try sibling, if available use that.
-             * Otherwise if element doesn't have a parent, end iteration.
-             * Otherwise go to parent and try its sibling, if available use that.
-             * Otherwise repeat from parent check.
-             */
-            QDomElement next = mCurrent.firstChildElement();
-            if (next.isNull())
-                next = mCurrent.nextSiblingElement();
-            QDomNode parent = mCurrent.parentNode();
-            while (next.isNull()) {
-                if (parent.isNull()) {
-                    qCDebug(lcTable) << "End of iteration";
-                    next = QDomElement(); // Ensure that next is null
-                    break;
-                }
-                next = parent.nextSiblingElement();
-                parent = parent.parentNode();
-            }
-            mCurrent = next;
-        }
-        return *this;
-    }
-
-    QDomElement &operator*()
-    {
-        return mCurrent;
-    }
-
-    QDomElement *operator->()
-    {
-        return &mCurrent;
-    }
-
-private:
-    QDomDocument &mDocument;
-    QDomElement mCurrent;
-};
-
-QDomDocument getDocument(const QString &path) {
-    QDomDocument document;
-    QFile file(path);
-    if (file.exists())
-        document.setContent(&file);
-    return document;
-}
-
-void setStyle(QDomElement &element, bool fill, bool stroke, QString value) {
-    auto styles = element.attribute(StyleAttribute).split(';', QString::SkipEmptyParts);
-    for (auto it = styles.begin(); it != styles.end() && fill && stroke; ++it) {
-        auto parts = it->split(':');
-        if (parts.length() != 2) {
+/*
+ * Replaces fill and stroke in style and appends them if they are missing.
+ * The first value that is replaced is stored to original.
+ */
+QString setStyle(const QStringRef &style, bool fill, bool stroke, const QString &value, QString &original) {
+    QStringList styles;
+    bool fillSet = false;
+    bool strokeSet = false;
+    for (const QStringRef &part : style.split(';', QString::SkipEmptyParts)) {
+        int separator = part.indexOf(':');
+        if (separator < 0) {
             qCCritical(lcTable) << "Invalid style";
-            break;
+            styles.append(part.toString());
+            continue;
         }
-        if (fill && parts[0] == FillStyle) {
-            *it = StyleTemplate.arg(FillStyle, value);
-            fill = false;
-        } else if (stroke && parts[0] == StrokeStyle) {
-            *it = StyleTemplate.arg(StrokeStyle, value);
-            stroke = false;
+        QStringRef name = part.left(separator);
+        if (fill && name == FillStyle) {
+            styles.append(StyleTemplate.arg(FillStyle, value));
+            fillSet = true;
+        } else if (stroke && name == StrokeStyle) {
+            styles.append(StyleTemplate.arg(StrokeStyle, value));
+            strokeSet = true;
+        } else {
+            styles.append(part.toString());
+            continue;
         }
+        if (original.isEmpty())
+            original = part.mid(separator + 1).trimmed().toString();
     }
-    if (fill)
+    if (fill && !fillSet)
         styles.append(StyleTemplate.arg(FillStyle, value));
-    if (stroke)
+    if (stroke && !strokeSet)
         styles.append(StyleTemplate.arg(StrokeStyle, value));
-    element.setAttribute(StyleAttribute, styles.join(';'));
+    return styles.join(';');
 }
 
-void modifyDocument(QDomDocument &document, const QHash<QString, QString> &colours) {
-    if (colours.isEmpty())
+void modifyAttributes(QXmlStreamAttributes &attributes, const QHash<QString, QString> &colours,
+                      QHash<QString, QString> &originals) {
+    QStringRef classAttribute = attributes.value(ClassAttribute);
+    if (classAttribute.isEmpty())
         return;
-    for (auto it = DomDocumentIterator::begin(document); it != DomDocumentIterator::end(document); ++it) {
-        const auto classes = it->attribute(ClassAttribute).split(' ', QString::SkipEmptyParts);
-        for (const auto &className : classes) {
-            if (colours.contains(className)) {
-                setStyle(*it, classes.contains(FillStyle), classes.contains(StrokeStyle),
-                         colours.value(className));
+
+    const QVector<QStringRef> classes = classAttribute.split(' ', QString::SkipEmptyParts);
+    for (const QStringRef &className : classes) {
+        auto colour = colours.constFind(className.toString());
+        if (colour == colours.constEnd())
+            continue;
+
+        bool fill = classes.contains(QStringRef(&FillStyle));
+        bool stroke = classes.contains(QStringRef(&StrokeStyle));
+        QString original;
+        auto style = attributes.begin();
+        for (; style != attributes.end(); ++style) {
+            if (style->qualifiedName() == StyleAttribute)
                 break;
-            }
         }
+        if (style != attributes.end())
+            *style = QXmlStreamAttribute(StyleAttribute, setStyle(style->value(), fill, stroke, *colour, original));
+        else
+            attributes.append(StyleAttribute, setStyle(QStringRef(), fill, stroke, *colour, original));
+        if (!original.isEmpty() && !originals.contains(colour.key()))
+            originals.insert(colour.key(), original);
+        return;
+    }
+}
+
+/*
+ * Like QXmlStreamWriter::writeCurrentToken() but keeps qualified names as
+ * they are instead of letting the writer choose namespace prefixes.
+ */
+void writeStartElement(QXmlStreamWriter &writer, const QXmlStreamReader &reader,
+                       const QXmlStreamAttributes &attributes) {
+    writer.writeStartElement(reader.qualifiedName().toString());
+    for (const QXmlStreamNamespaceDeclaration &declaration : reader.namespaceDeclarations()) {
+        if (declaration.prefix().isEmpty())
+            writer.writeAttribute(NamespaceAttribute, declaration.namespaceUri().toString());
+        else
+            writer.writeAttribute(PrefixedNamespaceAttribute.arg(declaration.prefix().toString()),
+                                  declaration.namespaceUri().toString());
     }
+    for (const QXmlStreamAttribute &attribute : attributes)
+        writer.writeAttribute(attribute.qualifiedName().toString(), attribute.value().toString());
 }
 
 } // namespace
@@ -164,13 +124,51 @@ SvgDocument::SvgDocument(const QString &path, QObject *parent)
 {
 }
 
+/*
+ * Copies the document in one pass and changes fill and stroke colours of
+ * elements that have a matching class. Without colours the file is used
+ * as it is.
+ */
 void SvgDocument::load(QHash<QString, QString> colours)
 {
-    auto document = getDocument(m_path);
-    modifyDocument(document, colours);
+    close();
+    m_originalColours.clear();
+    QFile file(m_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(lcTable) << "Can not open" << m_path << file.errorString();
+        setData(QByteArray());
+        open(QIODevice::ReadOnly);
+        return;
+    }
+
+    if (colours.isEmpty()) {
+        setData(file.readAll());
+        open(QIODevice::ReadOnly);
+        return;
+    }
+
+    setData(QByteArray());
+    buffer().reserve(file.size());
     open(QIODevice::WriteOnly);
-    QTextStream stream(this);
-    document.save(stream, 0);
+    QXmlStreamReader reader(&file);
+    QXmlStreamWriter writer(this);
+    while (!reader.atEnd()) {
+        if (reader.readNext() == QXmlStreamReader::StartElement) {
+            QXmlStreamAttributes attributes = reader.attributes();
+            modifyAttributes(attributes, colours, m_originalColours);
+            writeStartElement(writer, reader, attributes);
+        } else if (reader.tokenType() != QXmlStreamReader::Invalid) {
+            writer.writeCurrentToken(reader);
+        }
+    }
+    if (reader.hasError())
+        qCWarning(lcTable) << "Error reading" << m_path << reader.errorString();
     close();
     open(QIODevice::ReadOnly);
 }
+
+// Colours that were replaced on the last load, one for each class
+QHash<QString, QString> SvgDocument::originalColours() const
+{
+    return m_originalColours;
+}
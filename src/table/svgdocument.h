@@ -28,9 +28,11 @@ class SvgDocument : public QBuffer
 public:
     explicit SvgDocument(const QString &path, QObject *parent = nullptr);
     void load(QHash<QString, QString> colours);
+    QHash<QString, QString> originalColours() const;
 
 private:
     QString m_path;
+    QHash<QString, QString> m_originalColours;
 };
 
 #endif // SVGDOCUMENT_H
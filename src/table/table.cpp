@@ -23,14 +23,17 @@
 #include <QColor>
 #include <QCommandLineParser>
 #include <QGuiApplication>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
 #include <QQuickWindow>
 #include <QRunnable>
-#include <QSGSimpleRectNode>
+#include <QSGClipNode>
 #include <QSGTexture>
 #include <QStyleHints>
 #include <random>
 #include "animationbuilder.h"
 #include "card.h"
+#include "cardbatch.h"
 #include "constants.h"
 #include "drag.h"
 #include "engine.h"
@@ -40,6 +43,7 @@
 #include "patience.h"
 #include "selection.h"
 #include "slot.h"
+#include "slotbatch.h"
 #include "table.h"
 #include "texturerenderer.h"
 
@@ -54,8 +58,10 @@ const qreal SlotMargin = 3 / CardBaseWidth;
 const qreal SlotOutlineWidth = 3 / CardBaseWidth;
 const QColor DefaultBackgroundColor(Qt::darkGreen);
 const QColor DefaultHighlightColor(Qt::blue);
+const QColor SlotOutlineColor(Qt::gray);
 const qreal DefaultHighlightOpacity = 0.25;
 const int CardsInMoveMinimum = 4;
+const int FramesPerPerfReport = 120;
 
 float pow2(float value) { return value * value; }
 
@@ -213,29 +219,6 @@ private:
 
 } // namespace
 
-class SlotNode : public QSGGeometryNode
-{
-public:
-    SlotNode()
-        : QSGGeometryNode()
-        , m_hidden(false)
-    {
-    }
-
-    bool isSubtreeBlocked()
-    {
-        return m_hidden;
-    }
-
-    void setHidden(bool hidden)
-    {
-        m_hidden = hidden;
-    }
-
-private:
-    bool m_hidden;
-};
-
 #define dirty(flag) (m_dirty & (flag))
 #define smudge(flag) m_dirty |= (flag)
 #define clean() m_dirty = Clean
@@ -248,15 +231,19 @@ Table::Table(QQuickItem *parent)
     , m_dirtyCardSize(true)
     , m_backgroundColor(DefaultBackgroundColor)
     , m_doubleResolution(false)
+    , m_cardTextureCached(false)
+    , m_cardColors(CardBatchNode::ColorCount, QColor(Qt::black))
     , m_highlightedSlot(nullptr)
     , m_highlightColor(DefaultHighlightColor)
     , m_manager(this)
     , m_interaction(nullptr)
     , m_cardTexture(nullptr)
     , m_pendingCardTexture(nullptr)
+    , m_maxTextureSize(0)
     , m_previousWindow(nullptr)
     , m_animation(nullptr)
     , m_animate(false)
+    , m_frames(0)
 {
     setAcceptedMouseButtons(Qt::LeftButton);
     setFlag(QQuickItem::ItemClipsChildrenToShape);
@@ -272,6 +259,7 @@ Table::Table(QQuickItem *parent)
     connect(this, &Table::doRenderCardTexture, renderer, &TextureRenderer::renderTexture);
     connect(renderer, &TextureRenderer::textureRendered, this, &Table::handleCardTextureRendered);
     connect(renderer, &TextureRenderer::doubleSizeTextureRendered, this, &Table::handleDoubleSizeTextureRendered);
+    connect(renderer, &TextureRenderer::cardColorsChanged, this, &Table::handleCardColorsChanged);
     m_textureThread.start();
 
     auto engine = Engine::instance();
@@ -338,8 +326,7 @@ void Table::playWinAnimation()
 
 void Table::createWinAnimation()
 {
-    // SAFETY: While Engine is owned by another thread, it's not destroyed until
-    // the app closes and the seed only changes when a new game is started
+    // Engine publishes the seed in a snapshot that is safe to read from here
     std::mt19937 generator(Engine::instance()->seed());
     AnimationBuilder builder = AnimationBuilder::sequentialAnimation(this);
     using SlotIterator = typename QVector<Slot *>::iterator;
@@ -479,120 +466,109 @@ QRectF Table::getSlotOutline(Slot *slot)
     return QRectF(slot->x(), slot->y(), slot->width(), slot->height()) - margins;
 }
 
-void Table::setGeometryForSlotNode(SlotNode *node, Slot *slot)
-{
-    auto *geometry = node->geometry();
-    if (!geometry) {
-        geometry = new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(), 10);
-        geometry->setVertexDataPattern(QSGGeometry::StaticPattern);
-        geometry->setIndexDataPattern(QSGGeometry::StaticPattern);
-        node->setGeometry(geometry);
-        node->setFlag(QSGNode::OwnsGeometry);
-    }
-
-    auto outside = getSlotOutline(slot);
-    qreal outline = SlotOutlineWidth * slot->width();
-    auto inside = outside - QMarginsF(outline, outline, outline, outline);
-    auto *data = geometry->vertexDataAsPoint2D();
-    data[0].set(outside.left(), outside.top());
-    data[1].set(inside.left(), inside.top());
-    data[2].set(outside.right(), outside.top());
-    data[3].set(inside.right(), inside.top());
-    data[4].set(outside.right(), outside.bottom());
-    data[5].set(inside.right(), inside.bottom());
-    data[6].set(outside.left(), outside.bottom());
-    data[7].set(inside.left(), inside.bottom());
-    data[8].set(outside.left(), outside.top());
-    data[9].set(inside.left(), inside.top());
-    node->markDirty(QSGNode::DirtyGeometry);
-}
-
-void Table::setHighlightForSlotNode(SlotNode *node, Slot *slot)
-{
-    auto child = static_cast<QSGSimpleRectNode *>(node->firstChild());
-    if (dirty(HighlightedSlot)) {
-        if (slot->highlighted() && slot->isEmpty()) {
-            if (!child) {
-                child = new QSGSimpleRectNode(getSlotOutline(slot), m_highlightColor);
-                child->setFlag(QSGNode::OwnedByParent);
-                node->appendChildNode(child);
-                return;
-            }
-        } else if (child) {
-            node->removeAllChildNodes();
-            return;
-        }
-    }
-    if (child && dirty(HighlightColor))
-        child->setColor(m_highlightColor);
-    if (child && dirty(SlotSize))
-        child->setRect(getSlotOutline(slot));
-}
-
-void Table::setMaterialForSlotNode(SlotNode *node)
-{
-    static QSGFlatColorMaterial *material = nullptr;
-    if (!material) {
-        material = new QSGFlatColorMaterial;
-        material->setColor(QColor(Qt::gray));
-    }
-    node->setMaterial(material);
-}
-
 QSGNode *Table::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
 {
     auto *node = oldNode;
-    if (!node || m_dirty) {
-        if (!node || dirty(BackgroundType)) {
-            if (transparentBackground())
-                node = new QSGNode();
-            else
-                node = new QSGSimpleRectNode(boundingRect(), m_backgroundColor);
-            m_dirty = SlotCount;
-        }
-
-        if (dirty(BackgroundSize) && !transparentBackground())
-            static_cast<QSGSimpleRectNode *>(node)->setRect(boundingRect());
+    if (!node) {
+        node = new QSGNode();
+        auto *slotNode = new SlotBatchNode();
+        slotNode->setFlag(QSGNode::OwnedByParent);
+        node->appendChildNode(slotNode);
+        // Cards are drawn on top of slots and clipped to the table like child items
+        auto *clipNode = new QSGClipNode();
+        clipNode->setIsRectangular(true);
+        clipNode->setFlag(QSGNode::OwnedByParent);
+        auto *cardNode = new CardBatchNode();
+        cardNode->setFlag(QSGNode::OwnedByParent);
+        clipNode->appendChildNode(cardNode);
+        node->appendChildNode(clipNode);
+        m_dirty = Filthy;
+    }
 
-        if (dirty(BackgroundColor) && !transparentBackground())
-            static_cast<QSGSimpleRectNode *>(node)->setColor(m_backgroundColor);
+    if (m_dirty) {
+        auto *slotNode = static_cast<SlotBatchNode *>(node->firstChild());
+        auto *clipNode = static_cast<QSGClipNode *>(node->lastChild());
 
         if (dirty(SlotCount)) {
-            node->removeAllChildNodes();
-            for (int i = 0; i < m_slots.count(); i++) {
-                auto *slotNode = new SlotNode();
-                setMaterialForSlotNode(slotNode);
-                slotNode->setFlag(QSGNode::OwnedByParent);
-                node->appendChildNode(slotNode);
-            }
-            smudge(HighlightedSlot | HighlightColor | SlotSize | HiddenSlots);
+            slotNode->setSlotCount(m_slots.count());
+            smudge(BackgroundSize | SlotSize);
+        }
+
+        if (dirty(BackgroundType | BackgroundColor | BackgroundSize)) {
+            slotNode->setBackground(boundingRect(), m_backgroundColor);
+            slotNode->commit();
         }
 
         if (dirty(HighlightedSlot | HighlightColor | SlotSize | HiddenSlots)) {
-            auto slotIt = m_slots.constBegin();
-            auto nodeIt = static_cast<SlotNode *>(node->firstChild());
-            while (slotIt != m_slots.constEnd() && nodeIt != nullptr) {
-                if (dirty(SlotSize))
-                    setGeometryForSlotNode(nodeIt, *slotIt);
-                if (dirty(HiddenSlots))
-                    nodeIt->setHidden((*slotIt)->isEmpty());
-                if (dirty(HighlightedSlot | HighlightColor | SlotSize))
-                    setHighlightForSlotNode(nodeIt, *slotIt);
-                ++slotIt;
-                nodeIt = static_cast<SlotNode *>(nodeIt->nextSibling());
-            }
-            if (slotIt != m_slots.constEnd())
-                qCCritical(lcTable) << "Failed to iterate through all slots!";
-            if (nodeIt != nullptr)
-                qCCritical(lcTable) << "Failed to iterate through all slot nodes!";
+            for (int i = 0; i < m_slots.count(); i++)
+                setSlotInBatch(slotNode, i);
+            slotNode->commit();
         }
 
+        if (dirty(BackgroundSize)) {
+            clipNode->setClipRect(boundingRect());
+            smudge(Cards);
+        }
+
+        if (dirty(Cards | HighlightColor))
+            updateCardBatchNode(static_cast<CardBatchNode *>(clipNode->firstChild()));
+
         clean();
     }
 
     return node;
 }
 
+void Table::setSlotInBatch(SlotBatchNode *node, int index)
+{
+    Slot *slot = m_slots.at(index);
+    bool highlighted = slot->highlighted() && slot->isEmpty();
+    node->setSlot(index, getSlotOutline(slot), SlotOutlineWidth * slot->width(), SlotOutlineColor,
+                  highlighted ? m_highlightColor : QColor(Qt::transparent));
+}
+
+void Table::updateCardBatchNode(CardBatchNode *node)
+{
+    QElapsedTimer timer;
+    if (lcRendererPerf().isDebugEnabled())
+        timer.start();
+
+    m_drawnCards.resize(0);
+    if (m_cardTexture)
+        collectCards(this);
+
+    node->setTexture(m_cardTexture);
+    node->setColors(m_cardColors);
+    node->setCount(m_drawnCards.count());
+    for (int i = 0; i < m_drawnCards.count(); i++) {
+        Card *card = m_drawnCards.at(i);
+        QRectF rect = card->mapRectToItem(this, QRectF(0, 0, card->width(), card->height()));
+        node->setCard(i, rect, card->sourceRect(), card->colorClass(),
+                      card->highlighted() ? m_highlightColor : QColor(Qt::transparent));
+    }
+    node->commit();
+
+    if (timer.isValid())
+        qCDebug(lcRendererPerf) << "Updated" << m_drawnCards.count() << "cards in one node in"
+                                << timer.nsecsElapsed() / 1000 << "µs";
+}
+
+// Collects visible cards in the order they would be painted as items
+void Table::collectCards(QQuickItem *item)
+{
+    QList<QQuickItem *> children = item->childItems();
+    std::stable_sort(children.begin(), children.end(), [](QQuickItem *a, QQuickItem *b) {
+        return a->z() < b->z();
+    });
+    for (QQuickItem *child : children) {
+        if (!child->isVisible())
+            continue;
+        if (Card *card = qobject_cast<Card *>(child))
+            m_drawnCards.append(card);
+        collectCards(child);
+    }
+}
+
 qreal Table::minimumSideMargin() const
 {
     return m_minimumSideMargin;
@@ -723,6 +699,18 @@ bool Table::doubleResolution() const
     return m_doubleResolution;
 }
 
+// Whether the current card texture was loaded from disk instead of drawn
+bool Table::cardTextureCached() const
+{
+    return m_cardTextureCached;
+}
+
+// Whether the current card texture is a low resolution one waiting to be replaced
+bool Table::cardTexturePreview() const
+{
+    return m_cardTexture && m_cardTexture->textureSize().width() < m_cardSize.width() * 13;
+}
+
 void Table::setDoubleResolution(bool doubleResolution)
 {
     if (m_doubleResolution != doubleResolution) {
@@ -1021,6 +1009,13 @@ void Table::setDirtyCardSize()
     polish();
 }
 
+void Table::updateCards()
+{
+    smudge(Cards);
+    if (!preparing())
+        update();
+}
+
 void Table::updateCardSize()
 {
     if (!m_tableSize.isValid())
@@ -1055,6 +1050,13 @@ void Table::updateCardSize()
         QSize size(m_cardSize.width() * 13, m_cardSize.height() * 5);
         bool doubleSize = (m_cardSize.height() * 3 < height() && m_cardSize.width() * 7 < width())
             || (m_cardSize.height() * 3 < width() && m_cardSize.width() * 7 < height());
+        // Mask below the cards doubles the height of the texture
+        if (doubleSize && !fitsTexture(QSize(size.width() * 2, size.height() * 4))) {
+            qCDebug(lcTable) << "Double size texture would not fit, using single size";
+            doubleSize = false;
+        }
+        if (lcRendererPerf().isDebugEnabled())
+            m_textureTimer.start();
         emit doRenderCardTexture(size, doubleSize);
     }
 
@@ -1107,7 +1109,14 @@ QSGTexture *Table::cardTexture()
 
 bool Table::textureIsDoubleSize() const
 {
-    return m_doubleResolution && !m_doubleSizeImage.isNull();
+    return m_doubleResolution && !m_doubleSizeImage.isNull() && fitsTexture(m_doubleSizeImage.size());
+}
+
+// Larger images would be scaled down by Qt, which would lose the point of drawing them at double size
+bool Table::fitsTexture(const QSize &size) const
+{
+    int maxTextureSize = m_maxTextureSize.load();
+    return maxTextureSize <= 0 || (size.width() <= maxTextureSize && size.height() <= maxTextureSize);
 }
 
 void Table::setCardTexture(QSGTexture *texture)
@@ -1141,8 +1150,17 @@ void Table::connectWindowSignals(QQuickWindow *window)
     if (m_previousWindow)
         m_previousWindow->disconnect(this);
     if (window) {
+        // Emitted on the render thread with the context current, before the texture is created
+        connect(window, &QQuickWindow::sceneGraphInitialized, this, [this] {
+            GLint size = 0;
+            QOpenGLContext::currentContext()->functions()->glGetIntegerv(GL_MAX_TEXTURE_SIZE, &size);
+            m_maxTextureSize.store(size);
+            qCDebug(lcTable) << "Maximum texture size is" << size;
+        }, Qt::DirectConnection);
         connect(window, &QQuickWindow::sceneGraphInitialized, this, &Table::createCardTexture);
         connect(window, &QQuickWindow::sceneGraphInvalidated, this, &Table::handleSceneGraphInvalidated);
+        if (lcRendererPerf().isDebugEnabled())
+            connect(window, &QQuickWindow::frameSwapped, this, &Table::handleFrameSwapped);
     }
     m_previousWindow = window;
 }
@@ -1155,6 +1173,8 @@ void Table::createCardTexture()
             texture = window()->createTextureFromImage(m_doubleSizeImage);
         else
             texture = window()->createTextureFromImage(m_cardImage);
+        if (m_cardImage.width() < m_cardSize.width() * 13)
+            texture->setFiltering(QSGTexture::Linear);
         setPendingCardTexture(texture);
         qCDebug(lcTable) << "New card texture ready for card size of" << m_cardSize;
         polish();
@@ -1165,20 +1185,48 @@ void Table::swapCardTexture() {
     if (m_pendingCardTexture) {
         setCardTexture(m_pendingCardTexture);
         m_pendingCardTexture = nullptr;
+        if (m_textureTimer.isValid()) {
+            bool preview = cardTexturePreview();
+            qCDebug(lcRendererPerf) << (preview ? "Preview cards" : "Cards") << "visible"
+                                    << m_textureTimer.elapsed() << "ms after requesting texture";
+            if (!preview)
+                m_textureTimer.invalidate();
+        }
         emit cardTextureUpdated();
+        updateCards();
     }
 }
 
-void Table::handleCardTextureRendered(QImage image, const QSize &size)
+void Table::handleFrameSwapped()
+{
+    if (!m_frameTimer.isValid()) {
+        m_frameTimer.start();
+    } else if (++m_frames == FramesPerPerfReport) {
+        qCDebug(lcRendererPerf) << "Average frame time" << m_frameTimer.restart() / double(m_frames)
+                                << "ms while drawing" << m_drawnCards.count() << "cards";
+        m_frames = 0;
+    }
+}
+
+void Table::handleCardTextureRendered(QImage image, const QSize &size, bool cached)
 {
     QSize expectedSize(m_cardSize.width() * 13, m_cardSize.height() * 5);
     if (expectedSize == size) {
         m_cardImage = image;
-        m_cardSizeInTexture = m_cardSize;
+        m_cardTextureCached = cached;
+        // Smaller than requested when this is a preview, mask is below the cards
+        m_cardSizeInTexture = QSizeF(image.width() / 13.0, image.height() / 10.0);
         createCardTexture();
     }
 }
 
+// Card colors are only uniforms, the texture stays the same
+void Table::handleCardColorsChanged(QVector<QColor> colors)
+{
+    m_cardColors = colors;
+    updateCards();
+}
+
 void Table::handleDoubleSizeTextureRendered(QImage image, const QSize &size)
 {
     QSize expectedSize(m_cardSize.width() * 13, m_cardSize.height() * 5);
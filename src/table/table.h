@@ -18,6 +18,7 @@
 #ifndef TABLE_H
 #define TABLE_H
 
+#include <QAtomicInt>
 #include <QColor>
 #include <QImage>
 #include <QPointF>
@@ -36,7 +37,8 @@ class QAnimationGroup;
 class QCommandLineParser;
 class QSGTexture;
 class QQuickWindow;
-class SlotNode;
+class CardBatchNode;
+class SlotBatchNode;
 class Table : public QQuickItem, public CountableId
 {
     Q_OBJECT
@@ -93,6 +95,8 @@ public:
     void resetBackgroundColor();
     bool transparentBackground() const;
     bool doubleResolution() const;
+    bool cardTextureCached() const;
+    bool cardTexturePreview() const;
     void setDoubleResolution(bool doubleResolution);
     bool animationPlaying() const;
     bool animationPaused() const;
@@ -122,6 +126,7 @@ public:
     Q_INVOKABLE void cancelDrag();
 
     void setDirtyCardSize();
+    void updateCards();
     void disableActions(bool disabled);
 
     typedef QVector<Slot *>::iterator iterator;
@@ -138,7 +143,8 @@ public:
         SlotSize = 0x20,
         SlotCount = 0x40,
         HiddenSlots = 0x80,
-        Filthy = 0xff
+        Cards = 0x100,
+        Filthy = 0x1ff
     };
     Q_DECLARE_FLAGS(DirtyFlags, Dirty)
 
@@ -163,8 +169,9 @@ private slots:
     void connectWindowSignals(QQuickWindow *window);
     void createCardTexture();
     void swapCardTexture();
-    void handleCardTextureRendered(QImage image, const QSize &size);
+    void handleCardTextureRendered(QImage image, const QSize &size, bool cached);
     void handleDoubleSizeTextureRendered(QImage image, const QSize &size);
+    void handleCardColorsChanged(QVector<QColor> colors);
     void handleSizeChanged();
     void handleSceneGraphInvalidated();
     void handleSetExpansionToDown(int id, double expansion);
@@ -174,6 +181,7 @@ private slots:
     void handleHeightChanged(double height);
     void handleEngineFailure();
     void handleGameContinued();
+    void handleFrameSwapped();
 
 private:
     void updateCardSize();
@@ -183,13 +191,14 @@ private:
     void setCardTexture(QSGTexture *texture);
     void setPendingCardTexture(QSGTexture *texture);
     void deleteTexture(QSGTexture *texture);
+    bool fitsTexture(const QSize &size) const;
     void createWinAnimation();
     void resetCardPositions();
 
     static QRectF getSlotOutline(Slot *slot);
-    static void setMaterialForSlotNode(SlotNode *node);
-    static void setGeometryForSlotNode(SlotNode *node, Slot *slot);
-    void setHighlightForSlotNode(SlotNode *node, Slot *slot);
+    void setSlotInBatch(SlotBatchNode *node, int index);
+    void updateCardBatchNode(CardBatchNode *node);
+    void collectCards(QQuickItem *item);
     QRectF getBoundingRect(const QList<Card *> &cards);
     QList<Slot *> getSlotsFor(const QRectF &rect, Slot *source);
     Slot *findSlotAtPoint(const QPointF point) const;
@@ -209,6 +218,8 @@ private:
     bool m_dirtyCardSize;
     QColor m_backgroundColor;
     bool m_doubleResolution;
+    bool m_cardTextureCached;
+    QVector<QColor> m_cardColors;
 
     Slot *m_highlightedSlot;
     QColor m_highlightColor;
@@ -224,9 +235,15 @@ private:
     QSGTexture *m_pendingCardTexture;
     QImage m_cardImage;
     QImage m_doubleSizeImage;
+    QAtomicInt m_maxTextureSize; // Set on the render thread, 0 until known
     QQuickWindow *m_previousWindow;
     QAnimationGroup *m_animation;
     bool m_animate;
+
+    QVector<Card *> m_drawnCards;
+    QElapsedTimer m_frameTimer;
+    QElapsedTimer m_textureTimer;
+    int m_frames;
 };
 
 QDebug operator<<(QDebug debug, const Table *table);
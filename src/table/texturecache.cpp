@@ -0,0 +1,170 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include "logging.h"
+#include "texturecache.h"
+
+namespace {
+
+const QString DirectoryName = QStringLiteral("textures");
+const QString FileTemplate = QStringLiteral("%1-%2x%3.texture");
+const QString FilePattern = QStringLiteral("*.texture");
+const QImage::Format TextureFormat = QImage::Format_ARGB32_Premultiplied;
+const quint32 Magic = 0x50445458; // PDTX
+const quint32 Version = 2;
+// Enough for both orientations in normal and double size
+const int MaximumEntries = 8;
+const int MaximumColors = 8;
+
+struct Header {
+    quint32 magic;
+    quint32 version;
+    quint32 width;
+    quint32 height;
+    quint32 bytesPerLine;
+    quint32 format;
+    quint32 colorCount;
+    quint32 reserved;
+    QRgb colors[MaximumColors];
+};
+
+// Keeps pixels aligned after the header
+static_assert(sizeof(Header) == 64, "Texture cache header must be 64 bytes");
+
+void unmap(void *file)
+{
+    delete static_cast<QFile *>(file);
+}
+
+} // namespace
+
+TextureCache::TextureCache()
+    : m_directory(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath(DirectoryName))
+{
+}
+
+void TextureCache::setSource(const QString &path)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(Version));
+    QFile file(path);
+    if (file.open(QIODevice::ReadOnly))
+        hash.addData(&file);
+    else
+        qCWarning(lcRenderer) << "Can not read" << path << "for texture cache:" << file.errorString();
+    m_key = hash.result().toHex();
+}
+
+QString TextureCache::filePath(const QSize &size) const
+{
+    return QDir(m_directory).filePath(FileTemplate.arg(QString::fromLatin1(m_key))
+                                      .arg(size.width()).arg(size.height()));
+}
+
+// Returns a null image on a miss
+QImage TextureCache::load(const QSize &size, QVector<QColor> *colors) const
+{
+    if (m_key.isEmpty())
+        return QImage();
+
+    QFile *file = new QFile(filePath(size));
+    if (!file->open(QIODevice::ReadOnly)) {
+        delete file;
+        return QImage();
+    }
+
+    Header header;
+    if (file->read(reinterpret_cast<char *>(&header), sizeof(header)) != sizeof(header)
+            || header.magic != Magic || header.version != Version
+            || header.width != quint32(size.width()) || header.height != quint32(size.height())
+            || header.format != quint32(TextureFormat) || header.colorCount > quint32(MaximumColors)
+            || header.bytesPerLine < header.width * 4 || header.bytesPerLine % 4 != 0
+            || file->size() != qint64(sizeof(header)) + qint64(header.bytesPerLine) * header.height) {
+        qCWarning(lcRenderer) << "Invalid texture in cache:" << file->fileName();
+        file->remove();
+        delete file;
+        return QImage();
+    }
+
+    if (colors) {
+        colors->clear();
+        for (quint32 i = 0; i < header.colorCount; i++)
+            colors->append(QColor::fromRgba(header.colors[i]));
+    }
+
+    // Private mapping so that nothing is written back if the image is modified
+    uchar *data = file->map(0, file->size(), QFileDevice::MapPrivateOption);
+    if (!data) {
+        qCWarning(lcRenderer) << "Can not map texture from cache:" << file->errorString();
+        delete file;
+        return QImage();
+    }
+
+    // The file is closed and unmapped when the image is no longer used
+    return QImage(data + sizeof(header), header.width, header.height, header.bytesPerLine,
+                  TextureFormat, unmap, file);
+}
+
+bool TextureCache::store(const QImage &image, const QVector<QColor> &colors)
+{
+    if (m_key.isEmpty() || image.format() != TextureFormat || colors.count() > MaximumColors)
+        return false;
+
+    if (!QDir().mkpath(m_directory)) {
+        qCWarning(lcRenderer) << "Can not create texture cache directory" << m_directory;
+        return false;
+    }
+
+    Header header = {
+        Magic, Version,
+        quint32(image.width()), quint32(image.height()),
+        quint32(image.bytesPerLine()), quint32(TextureFormat),
+        quint32(colors.count()), 0, {}
+    };
+    for (int i = 0; i < colors.count(); i++)
+        header.colors[i] = colors.at(i).rgba();
+    QSaveFile file(filePath(image.size()));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(lcRenderer) << "Can not write texture to cache:" << file.errorString();
+        return false;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(image.constBits()), image.byteCount());
+    if (!file.commit()) {
+        qCWarning(lcRenderer) << "Can not write texture to cache:" << file.errorString();
+        return false;
+    }
+
+    prune();
+    return true;
+}
+
+// Removes least recently written textures
+void TextureCache::prune()
+{
+    QDir directory(m_directory);
+    const QFileInfoList entries = directory.entryInfoList({ FilePattern }, QDir::Files, QDir::Time);
+    for (int i = MaximumEntries; i < entries.count(); i++) {
+        qCDebug(lcRenderer) << "Removing" << entries.at(i).fileName() << "from texture cache";
+        directory.remove(entries.at(i).fileName());
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ * Patience Deck is a collection of patience games.
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <QByteArray>
+#include <QColor>
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+/*
+ * Cache of rendered card textures on disk.
+ *
+ * Textures are stored as raw premultiplied pixels after a small header so
+ * that they can be memory mapped directly into an image. The header also
+ * holds a few colors that belong to the texture. Entries are keyed by the
+ * contents of the SVG file and texture size, so any change to those renders
+ * a new texture. The files are only meant to be read by the same build on
+ * the same device.
+ */
+class TextureCache
+{
+public:
+    TextureCache();
+
+    void setSource(const QString &path);
+    QImage load(const QSize &size, QVector<QColor> *colors = nullptr) const;
+    bool store(const QImage &image, const QVector<QColor> &colors);
+
+private:
+    QString filePath(const QSize &size) const;
+    void prune();
+
+    QString m_directory;
+    QByteArray m_key;
+};
+
+#endif // TEXTURECACHE_H
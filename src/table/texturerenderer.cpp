@@ -18,9 +18,6 @@
 #include <QColor>
 #include <QCommandLineParser>
 #include <QElapsedTimer>
-#include <QPainter>
-#include <QSvgRenderer>
-#include <QXmlStreamReader>
 #include "constants.h"
 #include "logging.h"
 #include "perftimer.h"
@@ -36,6 +33,9 @@ const QString OptimizedStyle = QStringLiteral("optimized");
 const QString SimplifiedStyle = QStringLiteral("simplified");
 const QString FileTemplate = QStringLiteral("%1/anglo%2.svg");
 const QString DefaultColors = QStringLiteral("default");
+// Preview is drawn at a quarter of the resolution when cards are at least this wide
+const int PreviewDivisor = 4;
+const int PreviewMinimumCardWidth = 64;
 const QVector<QString> ColorClasses = {
     QStringLiteral("back"),
     QStringLiteral("club"),
@@ -44,24 +44,57 @@ const QVector<QString> ColorClasses = {
     QStringLiteral("spade")
 };
 
+QHash<QString, QString> allColors(const QColor &color)
+{
+    QHash<QString, QString> colors;
+    for (const QString &className : ColorClasses)
+        colors.insert(className, color.name(QColor::HexRgb));
+    return colors;
+}
+
+/*
+ * Stacks the sheet drawn with black card colors on top of a mask of where
+ * card colors end up. Drawing is linear in color, so the difference to the
+ * sheet drawn with white card colors is how much of the color is visible.
+ */
+QImage stackWithMask(const QImage &black, const QImage &white)
+{
+    QImage image(black.width(), black.height() * 2, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < black.height(); y++) {
+        auto *blackLine = reinterpret_cast<const QRgb *>(black.constScanLine(y));
+        auto *whiteLine = reinterpret_cast<const QRgb *>(white.constScanLine(y));
+        auto *baseLine = reinterpret_cast<QRgb *>(image.scanLine(y));
+        auto *maskLine = reinterpret_cast<QRgb *>(image.scanLine(black.height() + y));
+        for (int x = 0; x < black.width(); x++) {
+            int mask = qBound(0, qGreen(whiteLine[x]) - qGreen(blackLine[x]), 255);
+            baseLine[x] = blackLine[x];
+            maskLine[x] = qRgba(mask, mask, mask, mask);
+        }
+    }
+    return image;
+}
+
 } // namespace
 
+int TextureRenderer::s_threads = 0;
+
 TextureRenderer::TextureRenderer(QObject *parent)
     : QObject(parent)
     , m_document(nullptr)
-    , m_renderer(nullptr)
+    , m_documentLoaded(false)
     , m_cardStyleConf(Constants::ConfPath + CardStyleConf)
     , m_cardColorConf(Constants::ConfPath + CardColorConf)
     , m_drawDoubleSize(false)
 {
+    qRegisterMetaType<QVector<QColor>>();
     connect(&m_cardStyleConf, &MGConfItem::valueChanged, this, [&] {
         qCDebug(lcRenderer) << "Card style changed, rendering new card texture";
         resetDocument();
         loadDocument();
     });
     connect(&m_cardColorConf, &MGConfItem::valueChanged, this, [&] {
-        qCDebug(lcRenderer) << "Card colors changed, rendering new card texture";
-        loadDocument();
+        qCDebug(lcRenderer) << "Card colors changed";
+        emit cardColorsChanged(getCardColors());
     });
 }
 
@@ -70,11 +103,14 @@ void TextureRenderer::addArguments(QCommandLineParser *parser)
     parser->addOptions({
         {{"c", "cards"}, "Set card style", "regular|optimized|simplified"},
         {{"C", "colors"}, "Set card colors", "default|back,club,diamond,heart,spade"},
+        {"render-threads", "Number of threads for drawing card textures", "count",
+         QString::number(CardRasterizer::idealThreadCount())},
     });
 }
 
 void TextureRenderer::setArguments(QCommandLineParser *parser)
 {
+    s_threads = parser->value("render-threads").toInt();
     if (parser->isSet("cards")) {
         MGConfItem cardsConf(Constants::ConfPath + CardStyleConf);
         QString value = parser->value("cards");
@@ -140,54 +176,107 @@ QHash<QString, QString> TextureRenderer::getColors() const
     return colors;
 }
 
+// Configured colors in the order of ColorClasses, defaults for the rest
+QVector<QColor> TextureRenderer::getCardColors() const
+{
+    QHash<QString, QString> colors = getColors();
+    QVector<QColor> cardColors;
+    for (int i = 0; i < ColorClasses.count(); i++) {
+        if (colors.contains(ColorClasses.at(i)))
+            cardColors.append(QColor(colors.value(ColorClasses.at(i))));
+        else
+            cardColors.append(m_defaultColors.value(i, QColor(Qt::black)));
+    }
+    return cardColors;
+}
+
+// The document itself is parsed only when a texture is not found in cache
 void TextureRenderer::loadDocument()
 {
     measurePerf();
+    QString path = FileTemplate.arg(Constants::DataDirectory).arg(getVariant());
     if (!m_document)
-        m_document = new SvgDocument(FileTemplate.arg(Constants::DataDirectory).arg(getVariant()));
-    m_document->load(getColors());
-    emit documentLoaded();
-    resetRenderer();
+        m_document = new SvgDocument(path);
+    m_cache.setSource(path);
+    m_documentLoaded = false;
     renderTexture(m_size, m_drawDoubleSize);
 }
 
-QSvgRenderer *TextureRenderer::renderer()
-{
-    if (!m_renderer) {
-        QXmlStreamReader reader(m_document);
-        m_renderer = new QSvgRenderer(&reader, this);
+/*
+ * Card colors are not drawn into the texture. It has the sheet drawn with
+ * black card colors and a mask below it, and they are tinted when drawn.
+ */
+QImage TextureRenderer::drawTexture(const QSize &size, bool store) {
+    if (!m_documentLoaded) {
+        m_document->load(allColors(Qt::white));
+        m_whiteRasterizer.setDocument(m_document->data());
+        m_document->load(allColors(Qt::black));
+        m_rasterizer.setDocument(m_document->data());
+        QHash<QString, QString> originals = m_document->originalColours();
+        m_defaultColors.clear();
+        for (const QString &className : ColorClasses)
+            m_defaultColors.append(QColor(originals.value(className)));
+        m_documentLoaded = true;
+        emit documentLoaded();
     }
-    return m_renderer;
+    int threads = s_threads > 0 ? s_threads : CardRasterizer::idealThreadCount();
+    QImage image = stackWithMask(m_rasterizer.rasterize(size, threads),
+                                 m_whiteRasterizer.rasterize(size, threads));
+    qCDebug(lcRenderer) << "Drew new texture of size" << size << "with" << threads << "threads";
+    if (store)
+        m_cache.store(image, m_defaultColors);
+    return image;
 }
 
-void TextureRenderer::resetRenderer()
-{
-    if (m_renderer) {
-        m_renderer->deleteLater();
-        m_renderer = nullptr;
+// Returns a null image when the texture is not in cache
+QImage TextureRenderer::cachedTexture(const QSize &size) {
+    // Mask doubles the height of the texture
+    QVector<QColor> defaultColors;
+    QImage image = m_cache.load(QSize(size.width(), size.height() * 2), &defaultColors);
+    if (!image.isNull()) {
+        if (defaultColors.count() == ColorClasses.count()) {
+            m_defaultColors = defaultColors;
+        } else {
+            qCWarning(lcRenderer) << "Texture in cache has wrong number of colors";
+            return QImage();
+        }
+        qCDebug(lcRenderer) << "Loaded texture of size" << size << "from cache";
     }
-}
-
-QImage TextureRenderer::drawTexture(const QSize &size) {
-    QImage image(size, QImage::Format_ARGB32_Premultiplied);
-    QPainter painter(&image);
-    painter.setCompositionMode(QPainter::CompositionMode_Source);
-    painter.fillRect(0, 0, size.width(), size.height(), Qt::transparent);
-    painter.setRenderHint(QPainter::Antialiasing);
-    renderer()->render(&painter);
-    qCDebug(lcRenderer) << "Drew new texture of size" << size;
     return image;
 }
 
+/*
+ * Textures that are not in cache are first drawn at lower resolution.
+ * That is published as a normal texture of the requested size so that
+ * cards appear right away, and the full resolution texture replaces it.
+ */
 void TextureRenderer::renderTexture(const QSize &size, bool drawDoubleSize)
 {
     m_drawDoubleSize = drawDoubleSize;
     if (m_document && size.isValid()) {
         emit textureRenderingStarted();
         m_size = size;
-        emit textureRendered(drawTexture(size), size);
-        if (drawDoubleSize)
-            emit doubleSizeTextureRendered(drawTexture(size * 2), size);
+        QImage image = cachedTexture(size);
+        bool cached = !image.isNull();
+        if (!cached) {
+            QSize cardSize(size.width() / 13, size.height() / 5);
+            if (cardSize.width() >= PreviewMinimumCardWidth) {
+                cardSize /= PreviewDivisor;
+                QSize previewSize(cardSize.width() * 13, cardSize.height() * 5);
+                QImage preview = drawTexture(previewSize, false);
+                emit cardColorsChanged(getCardColors());
+                emit textureRendered(preview, size, false);
+            }
+            image = drawTexture(size, true);
+        }
+        emit cardColorsChanged(getCardColors());
+        emit textureRendered(image, size, cached);
+        if (drawDoubleSize) {
+            QImage doubleSizeImage = cachedTexture(size * 2);
+            if (doubleSizeImage.isNull())
+                doubleSizeImage = drawTexture(size * 2, true);
+            emit doubleSizeTextureRendered(doubleSizeImage, size);
+        }
     }
 }
 
@@ -203,10 +292,15 @@ void TextureRenderer::measurePerf()
             quint64 time = timer->nsecsElapsed() / 1000000;
             qCDebug(lcRendererPerf) << "Texture drawing started at" << time << "ms";
         });
-        connect(this, &TextureRenderer::textureRendered, timer, [timer] {
+        connect(this, &TextureRenderer::textureRendered, timer,
+                [timer](QImage image, const QSize &size, bool cached) {
             quint64 time = timer->nsecsElapsed() / 1000000;
-            qCDebug(lcRendererPerf) << "Texture drawn in" << time << "ms";
-            timer->deleteLater();
+            if (image.size() != size) {
+                qCDebug(lcRendererPerf) << "Preview texture drawn in" << time << "ms";
+            } else {
+                qCDebug(lcRendererPerf) << "Texture" << (cached ? "loaded from cache" : "drawn") << "in" << time << "ms";
+                timer->deleteLater();
+            }
         });
         timer->start();
     }
@@ -19,12 +19,15 @@
 #define TEXTURERENDERER_H
 
 #include <MGConfItem>
+#include <QColor>
 #include <QImage>
 #include <QObject>
 #include <QSize>
+#include <QVector>
+#include "cardrasterizer.h"
+#include "texturecache.h"
 
 class QCommandLineParser;
-class QSvgRenderer;
 class SvgDocument;
 class TextureRenderer : public QObject
 {
@@ -41,8 +44,9 @@ public slots:
     void renderTexture(const QSize &size, bool drawDoubleSize);
 
 signals:
-    void textureRendered(QImage image, const QSize &size);
+    void textureRendered(QImage image, const QSize &size, bool cached);
     void doubleSizeTextureRendered(QImage image, const QSize &size);
+    void cardColorsChanged(QVector<QColor> colors);
     // These are only for measuring performance
     void documentLoaded();
     void textureRenderingStarted();
@@ -50,18 +54,24 @@ signals:
 private:
     QString getVariant() const;
     QHash<QString, QString> getColors() const;
+    QVector<QColor> getCardColors() const;
     void resetDocument();
-    QSvgRenderer *renderer();
-    void resetRenderer();
-    QImage drawTexture(const QSize &size);
+    QImage drawTexture(const QSize &size, bool store);
+    QImage cachedTexture(const QSize &size);
     void measurePerf();
 
     SvgDocument *m_document;
-    QSvgRenderer *m_renderer;
+    CardRasterizer m_rasterizer;
+    CardRasterizer m_whiteRasterizer;
+    TextureCache m_cache;
+    QVector<QColor> m_defaultColors;
+    bool m_documentLoaded;
     MGConfItem m_cardStyleConf;
     MGConfItem m_cardColorConf;
     QSize m_size;
     bool m_drawDoubleSize;
+
+    static int s_threads;
 };
 
 #endif // TEXTURERENDERER_H
@@ -15,6 +15,7 @@
 # CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 import argparse
+import os
 import re
 import shlex
 import subprocess
@@ -57,12 +58,12 @@ def read_saved_states(filename):
                     expected_errors = int(comment.group("errors"))
             yield parser.parse_args(shlex.split(parts[0])[1:]), code, expected_errors
 
-def run(test, expected_result, expected_errors):
+def run(test, expected_result, expected_errors, env=None):
     print(f"Testing with {test.game} (seed {test.seed})...", end="")
     sys.stdout.flush()
     command = ["patience-deck", "--test", "--game", test.game, "--seed", test.seed,
                "--moves", test.moves, "--time", "60", "--options", test.options]
-    result = subprocess.run(command, timeout=TIMEOUT, capture_output=True)
+    result = subprocess.run(command, timeout=TIMEOUT, capture_output=True, env=env)
     errors = []
     for line in filter(lambda l: l.startswith(b'[W] ') or l.startswith(b'[C] '), result.stderr.split(b'\n')):
         errors.append(line.decode('UTF-8'))
@@ -79,12 +80,17 @@ def run(test, expected_result, expected_errors):
 def main():
     parser = argparse.ArgumentParser()
     parser.add_argument('filename')
+    parser.add_argument('--native-api', action='store_true',
+                        help="Use native replacements instead of api.scm helpers")
     args = parser.parse_args()
+    env = None
+    if args.native_api:
+        env = dict(os.environ, PATIENCE_DECK_SCHEME_API="native")
     count = 0
     successful = 0
     for test, expected_result, expected_errors in read_saved_states(args.filename):
         count += 1
-        if run(test, expected_result, expected_errors):
+        if run(test, expected_result, expected_errors, env):
             successful += 1
     if count == successful:
         print(f"All {count} tests passed!")
@@ -0,0 +1,225 @@
+/*
+ * Tests for Patience Deck game archive
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QTemporaryDir>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "archive.h"
+
+#define ASSERT_TRUE(test) do { \
+    if (!(test)) { \
+        cout << "assertion (" << #test << ") is true failed" << endl; \
+        return false; \
+    } \
+} while (0)
+#define ASSERT_FALSE(test) do { \
+    if (test) { \
+        cout << "assertion (" << #test << ") is false failed" << endl; \
+        return false; \
+    } \
+} while (0)
+#define ASSERT_SAME(a, b) do { \
+    if ((a) != (b)) { \
+        cout << "assertion (" << #a << " == " << #b << ") failed" << endl; \
+        return false; \
+    } \
+} while (0)
+#define SUCCESS() do { return true; } while (0)
+
+namespace {
+    using std::cout;
+    using std::endl;
+    using std::function;
+    using std::get;
+    using std::string;
+    using std::tuple;
+    using std::unitbuf;
+    using std::vector;
+
+    const int GameCount = 500;
+
+    ArchiveEntry game(int n)
+    {
+        ArchiveEntry entry;
+        entry.gameFile = n % 3 ? QStringLiteral("klondike.scm") : QStringLiteral("odd\tname.scm");
+        entry.seed = 4000000000u - n;
+        entry.options = n % 2 ? QStringLiteral("1;3") : QString();
+        entry.time = n * 1000;
+        entry.result = static_cast<ArchiveEntry::Result>(n % 3);
+        entry.moves = n % 5 ? QStringLiteral("1:AQID+/%1==").arg(QString(n % 50, 'x')) : QString();
+        return entry;
+    }
+
+    bool same(const ArchiveEntry &a, const ArchiveEntry &b)
+    {
+        return a.gameFile == b.gameFile && a.seed == b.seed && a.options == b.options
+            && a.time == b.time && a.result == b.result && a.moves == b.moves;
+    }
+
+    bool writeGames(const QString &path, int count)
+    {
+        ArchiveWriter writer(path);
+        for (int n = 0; n < count; n++) {
+            if (!writer.write(game(n)))
+                return false;
+        }
+        return true;
+    }
+} // namespace
+
+bool test_roundtrip()
+{
+    QTemporaryDir dir;
+    QString path = dir.path() + QStringLiteral("/games.archive");
+    ASSERT_TRUE(writeGames(path, 10));
+    ArchiveReader reader(path);
+    ArchiveEntry entry;
+    for (int n = 0; n < 10; n++) {
+        ASSERT_TRUE(reader.next(entry));
+        ASSERT_TRUE(same(entry, game(n)));
+    }
+    ASSERT_FALSE(reader.next(entry));
+    SUCCESS();
+}
+
+bool test_append()
+{
+    QTemporaryDir dir;
+    QString path = dir.path() + QStringLiteral("/games.archive");
+    ASSERT_TRUE(writeGames(path, 3));
+    {
+        ArchiveWriter writer(path);
+        ASSERT_TRUE(writer.write(game(3)));
+    }
+    ArchiveReader reader(path);
+    ArchiveEntry entry;
+    int count = 0;
+    while (reader.next(entry))
+        ASSERT_TRUE(same(entry, game(count++)));
+    ASSERT_SAME(count, 4);
+    SUCCESS();
+}
+
+bool test_arguments()
+{
+    ArchiveEntry entry = game(1);
+    QStringList arguments = entry.arguments();
+    ASSERT_TRUE(arguments.contains(QStringLiteral("--moves")));
+    ASSERT_SAME(arguments.at(arguments.indexOf(QStringLiteral("--options")) + 1), QStringLiteral("1;3"));
+    ASSERT_FALSE(game(0).arguments().contains(QStringLiteral("--moves")));
+    SUCCESS();
+}
+
+bool test_splits()
+{
+    QTemporaryDir dir;
+    QString path = dir.path() + QStringLiteral("/games.archive");
+    ASSERT_TRUE(writeGames(path, GameCount));
+    qint64 size = QFileInfo(path).size();
+    for (int splits : { 1, 2, 3, 7, 16, 64 }) {
+        QSet<quint32> seeds;
+        int count = 0;
+        for (int split = 0; split < splits; split++) {
+            ArchiveReader reader(path, size * split / splits, size * (split + 1) / splits);
+            ArchiveEntry entry;
+            while (reader.next(entry)) {
+                seeds.insert(entry.seed);
+                count++;
+            }
+        }
+        // Every game is read exactly once
+        ASSERT_SAME(count, GameCount);
+        ASSERT_SAME(seeds.count(), GameCount);
+    }
+    SUCCESS();
+}
+
+bool test_torn_tail()
+{
+    QTemporaryDir dir;
+    QString path = dir.path() + QStringLiteral("/games.archive");
+    ASSERT_TRUE(writeGames(path, 2));
+    {
+        QFile file(path);
+        ASSERT_TRUE(file.open(QIODevice::WriteOnly | QIODevice::Append));
+        file.write(game(2).toLine().left(10));
+    }
+    ArchiveReader reader(path);
+    ArchiveEntry entry;
+    ASSERT_TRUE(reader.next(entry));
+    ASSERT_TRUE(reader.next(entry));
+    ASSERT_FALSE(reader.next(entry));
+    SUCCESS();
+}
+
+bool test_invalid_line()
+{
+    QTemporaryDir dir;
+    QString path = dir.path() + QStringLiteral("/games.archive");
+    ASSERT_TRUE(writeGames(path, 1));
+    {
+        QFile file(path);
+        ASSERT_TRUE(file.open(QIODevice::WriteOnly | QIODevice::Append));
+        file.write("klondike.scm\tnot a seed\t\t0\twon\t\n");
+    }
+    {
+        ArchiveWriter writer(path);
+        ASSERT_TRUE(writer.write(game(1)));
+    }
+    ArchiveReader reader(path);
+    ArchiveEntry entry;
+    ASSERT_TRUE(reader.next(entry));
+    ASSERT_TRUE(same(entry, game(0)));
+    ASSERT_TRUE(reader.next(entry));
+    ASSERT_TRUE(same(entry, game(1)));
+    SUCCESS();
+}
+
+vector<tuple<string, function<bool()>>> tests = {
+    { "archive/roundtrip", test_roundtrip },
+    { "archive/append", test_append },
+    { "archive/arguments", test_arguments },
+    { "archive/splits", test_splits },
+    { "archive/torn_tail", test_torn_tail },
+    { "archive/invalid_line", test_invalid_line },
+};
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    cout << unitbuf;
+
+    uint count = 0;
+    for (auto test : tests) {
+        string name = get<0>(test);
+        cout << "Test '" << name << "' ";
+        bool success = get<1>(test)();
+        if (success)
+            cout << "succeeded" << endl;
+        count += success;
+    }
+
+    cout << count << "/" << tests.size() << " tests succeeded" << endl;
+    return tests.size() - count;
+}
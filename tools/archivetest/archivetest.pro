@@ -0,0 +1,8 @@
+TEMPLATE = app
+TARGET = archivetest
+
+QT = core
+
+include(../../src/engine/engine.pri)
+
+SOURCES = archivetest.cpp
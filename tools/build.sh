@@ -28,6 +28,7 @@ clean() {
         -name Makefile -o \
         -name '*.list' -o \
         -name '*.o' -o \
+        -name '*.a' -o \
         -name '*patience-deck.qm' -o \
         -name '*patience-deck-*.qm' -o \
         -name '*patience-deck' -o \
@@ -16,6 +16,7 @@
  */
 
 #include "checker.h"
+#include "engineinternals.h"
 
 EngineChecker::EngineChecker(QObject *parent)
     : QObject(parent)
@@ -112,6 +113,7 @@ void EngineChecker::handleMoveEnded()
 {
     ++m_move;
 
+    m_queue.coalesce();
     for (auto it = m_queue.begin(); it != m_queue.end(); ++it) {
         if (!handleQueued(*it)) {
             if ((*it).replaces)
@@ -123,6 +125,8 @@ void EngineChecker::handleMoveEnded()
 
     m_queue.clear();
 
+    compare();
+
     emit queueFinished();
 }
 
@@ -205,10 +209,31 @@ bool EngineChecker::handleQueued(const Action &action)
     return handled;
 }
 
+// Checks that applying the queue gave the same cards as the engine has
+void EngineChecker::compare()
+{
+    const auto &engineSlots = EngineInternals::instance()->m_cardSlots;
+    for (auto it = m_slots.constBegin(); it != m_slots.constEnd(); ++it) {
+        if (it.key() >= engineSlots.count())
+            continue;
+        const CardBuffer &expected = engineSlots.at(it.key());
+        const CardList &cards = it.value();
+        for (int index = 0; index < qMax(expected.count(), cards.count()); index++) {
+            CardData card = index < cards.count() ? cards.at(index) : CardData();
+            CardData data = index < expected.count() ? expected.at(index) : CardData();
+            if (card != data) {
+                fail(Error::Mismatch, Action(Engine::InsertionAction, it.key(), index, data), card);
+                break;
+            }
+        }
+    }
+}
+
 void EngineChecker::fail(Error::Reason reason, const Action &action, const CardData &data)
 {
     bool signal = !failed();
     m_errors.push_back(Error(reason, action, data));
+    emit errorFound(m_errors.back());
     if (signal)
         emit failedChanged();
 }
@@ -264,6 +289,9 @@ QDebug operator<<(QDebug debug, const EngineChecker::Error &error)
     case EngineChecker::Error::MissingCards:
         debug.nospace() << "Not enough cards to take from: " << error.action;
         break;
+    case EngineChecker::Error::Mismatch:
+        debug.nospace() << "Card differs from engine for: " << error.action << "," << error.data;
+        break;
     }
     return debug.space();
 }
@@ -30,6 +30,22 @@ class EngineChecker : public QObject
     Q_PROPERTY(bool failed READ failed NOTIFY failedChanged)
 
 public:
+    struct Error {
+        enum Reason {
+            NoReason,
+            WrongCard,
+            DoubleRequeue,
+            BadIndex,
+            BadSlot,
+            MissingCards,
+            Mismatch,
+        } reason;
+        Action action;
+        CardData data;
+
+        Error(Reason reason, const Action &action, const CardData &data);
+    };
+
     explicit EngineChecker(QObject *parent = nullptr);
 
     bool failed() const;
@@ -40,6 +56,7 @@ public:
 
 signals:
     void failedChanged();
+    void errorFound(const EngineChecker::Error &error);
     void queued();
     void queueFinished();
 
@@ -51,26 +68,12 @@ private slots:
     void handleAction(Engine::ActionTypeFlags action, int slot, int index, const CardData &data);
 
 private:
-    struct Error {
-        enum Reason {
-            NoReason,
-            WrongCard,
-            DoubleRequeue,
-            BadIndex,
-            BadSlot,
-            MissingCards,
-        } reason;
-        Action action;
-        CardData data;
-
-        Error(Reason reason, const Action &action, const CardData &data);
-    };
-
     friend QDebug operator<<(QDebug debug, const Error &error);
 
     void handleImmediately(Engine::ActionType action, int slotId, int index, const CardData &data);
     bool handleQueued(const Action &action);
     void handleMoveEnded();
+    void compare();
     void fail(Error::Reason reason, const Action &action, const CardData &data);
 
     int m_move;
@@ -213,7 +213,7 @@ int EngineHelper::findSlotByType(Slots type, bool emptyRequired) const
 CardList EngineHelper::getCards(int slot, const CardData &first)
 {
     auto engine = EngineInternals::instance();
-    CardList cards = engine->m_cardSlots[slot];
+    CardList cards = CardList::fromVector(engine->m_cardSlots[slot]);
     int i = cards.indexOf(first);
     return cards.mid(i);
 }
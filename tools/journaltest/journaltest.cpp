@@ -0,0 +1,303 @@
+/*
+ * Tests for Patience Deck state journal
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QScopedPointer>
+#include <QTemporaryDir>
+#include <QThread>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "journalstorage.h"
+#include "storage.h"
+
+#define ASSERT_TRUE(test) do { \
+    if (!(test)) { \
+        cout << "assertion (" << #test << ") is true failed" << endl; \
+        return false; \
+    } \
+} while (0)
+#define ASSERT_FALSE(test) do { \
+    if (test) { \
+        cout << "assertion (" << #test << ") is false failed" << endl; \
+        return false; \
+    } \
+} while (0)
+#define ASSERT_SAME(a, b) do { \
+    if ((a) != (b)) { \
+        cout << "assertion (" << #a << " == " << #b << ") failed" << endl; \
+        return false; \
+    } \
+} while (0)
+#define SUCCESS() do { return true; } while (0)
+
+namespace {
+    using std::cout;
+    using std::endl;
+    using std::function;
+    using std::get;
+    using std::mt19937;
+    using std::string;
+    using std::tuple;
+    using std::unitbuf;
+    using std::vector;
+
+    const int KillRounds = 20;
+    const int Chunks = 4;
+
+    QString movesKey(int n)
+    {
+        return QStringLiteral("/moves/%1").arg(n % Chunks);
+    }
+
+    QString movesValue(int n)
+    {
+        return QStringLiteral("chunk+%1/%2==").arg(n).arg(QString(n % 97, 'x'));
+    }
+
+    JournalStorage *openJournal(const QString &path, JournalStorage::SyncPolicy policy = JournalStorage::SyncOnRequest)
+    {
+        return new JournalStorage(new MemoryStorage(), path, policy);
+    }
+
+    // Writes a move chunk before the state that refers to it, like Recorder does
+    int writer(const QString &path)
+    {
+        QScopedPointer<JournalStorage> storage(openJournal(path, JournalStorage::SyncEveryBatch));
+        for (int n = 1; ; n++) {
+            storage->set(movesKey(n), movesValue(n));
+            storage->set(QStringLiteral("/state"), QString::number(n));
+            if (n % 50 == 0)
+                storage->sync();
+            QThread::usleep(200);
+        }
+        return 0;
+    }
+} // namespace
+
+bool test_roundtrip()
+{
+    QTemporaryDir dir;
+    QString path = dir.path() + QStringLiteral("/state.journal");
+    {
+        QScopedPointer<JournalStorage> storage(openJournal(path));
+        storage->set("/state", "klondike.scm;42;1;1000;2");
+        storage->set("/moves/0", "AQID+/==");
+        storage->set("/moves/1", "with\ttab and\nnewline");
+        storage->set("/options/klondike", "1;2");
+    }
+    QScopedPointer<JournalStorage> storage(openJournal(path));
+    ASSERT_SAME(storage->value("/state").toString(), QStringLiteral("klondike.scm;42;1;1000;2"));
+    ASSERT_SAME(storage->value("/moves/0").toString(), QStringLiteral("AQID+/=="));
+    ASSERT_SAME(storage->value("/moves/1").toString(), QStringLiteral("with\ttab and\nnewline"));
+    // Other keys go to backing storage which is not persisted here
+    ASSERT_FALSE(storage->value("/options/klondike").isValid());
+    SUCCESS();
+}
+
+bool test_removal()
+{
+    QTemporaryDir dir;
+    QString path = dir.path() + QStringLiteral("/state.journal");
+    {
+        QScopedPointer<JournalStorage> storage(openJournal(path));
+        storage->set("/moves/0", "a");
+        storage->set("/moves/1", "b");
+        storage->sync();
+        storage->set("/moves/1", QVariant());
+    }
+    QScopedPointer<JournalStorage> storage(openJournal(path));
+    ASSERT_SAME(storage->value("/moves/0").toString(), QStringLiteral("a"));
+    ASSERT_FALSE(storage->value("/moves/1").isValid());
+    SUCCESS();
+}
+
+bool test_torn_tail()
+{
+    QTemporaryDir dir;
+    QString path = dir.path() + QStringLiteral("/state.journal");
+    {
+        QScopedPointer<JournalStorage> storage(openJournal(path));
+        storage->set("/state", "good");
+    }
+    qint64 size = QFileInfo(path).size();
+    {
+        QFile file(path);
+        ASSERT_TRUE(file.open(QIODevice::WriteOnly | QIODevice::Append));
+        file.write("+/state\tbad");
+    }
+    {
+        QScopedPointer<JournalStorage> storage(openJournal(path));
+        ASSERT_SAME(storage->value("/state").toString(), QStringLiteral("good"));
+    }
+    ASSERT_SAME(QFileInfo(path).size(), size);
+    SUCCESS();
+}
+
+bool test_corrupt_entry()
+{
+    QTemporaryDir dir;
+    QString path = dir.path() + QStringLiteral("/state.journal");
+    {
+        QScopedPointer<JournalStorage> storage(openJournal(path));
+        storage->set("/state", "good");
+    }
+    {
+        QFile file(path);
+        ASSERT_TRUE(file.open(QIODevice::WriteOnly | QIODevice::Append));
+        file.write("+/state\tbad\t0\n");
+    }
+    QScopedPointer<JournalStorage> storage(openJournal(path));
+    ASSERT_SAME(storage->value("/state").toString(), QStringLiteral("good"));
+    SUCCESS();
+}
+
+bool test_migrate()
+{
+    QTemporaryDir dir;
+    QString path = dir.path() + QStringLiteral("/state.journal");
+    MemoryStorage *backing = new MemoryStorage();
+    backing->set("/state", "klondike.scm;42;1;1000;2");
+    backing->set("/moves/0", "AA==");
+    backing->set("/moves/1", "AQ==");
+    {
+        QScopedPointer<JournalStorage> storage(new JournalStorage(backing, path));
+        ASSERT_FALSE(backing->value("/state").isValid());
+        ASSERT_FALSE(backing->value("/moves/0").isValid());
+        ASSERT_SAME(backing->value("/journal").toString(), path);
+    }
+    QScopedPointer<JournalStorage> storage(openJournal(path));
+    ASSERT_SAME(storage->value("/state").toString(), QStringLiteral("klondike.scm;42;1;1000;2"));
+    ASSERT_SAME(storage->value("/moves/1").toString(), QStringLiteral("AQ=="));
+    SUCCESS();
+}
+
+bool test_migrate_generation()
+{
+    QTemporaryDir dir;
+    QString path = dir.path() + QStringLiteral("/state.journal");
+    MemoryStorage *backing = new MemoryStorage();
+    // State that was rewritten once, with a parked session of another game
+    backing->set("/state", "klondike.scm;42;1;1000;2;1");
+    backing->set("/moves/1-0", "AA==");
+    backing->set("/moves/1-1", "AQ==");
+    backing->set("/sessions", "freecell.scm:20");
+    backing->set("/sessions/freecell", "7;2000;AQID");
+    {
+        QScopedPointer<JournalStorage> storage(new JournalStorage(backing, path));
+        ASSERT_FALSE(backing->value("/state").isValid());
+        ASSERT_FALSE(backing->value("/moves/1-1").isValid());
+        ASSERT_FALSE(backing->value("/sessions/freecell").isValid());
+    }
+    QScopedPointer<JournalStorage> storage(openJournal(path));
+    ASSERT_SAME(storage->value("/state").toString(), QStringLiteral("klondike.scm;42;1;1000;2;1"));
+    ASSERT_SAME(storage->value("/moves/1-0").toString(), QStringLiteral("AA=="));
+    ASSERT_SAME(storage->value("/moves/1-1").toString(), QStringLiteral("AQ=="));
+    ASSERT_SAME(storage->value("/sessions").toString(), QStringLiteral("freecell.scm:20"));
+    ASSERT_SAME(storage->value("/sessions/freecell").toString(), QStringLiteral("7;2000;AQID"));
+    SUCCESS();
+}
+
+bool test_compaction()
+{
+    QTemporaryDir dir;
+    QString path = dir.path() + QStringLiteral("/state.journal");
+    {
+        QScopedPointer<JournalStorage> storage(openJournal(path));
+        for (int n = 1; n <= 2000; n++) {
+            storage->set(movesKey(n), movesValue(n));
+            storage->set("/state", QString::number(n));
+            storage->sync();
+        }
+    }
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+    ASSERT_TRUE(file.readAll().count('\n') < 4000);
+    file.close();
+    QScopedPointer<JournalStorage> storage(openJournal(path));
+    ASSERT_SAME(storage->value("/state").toString(), QStringLiteral("2000"));
+    ASSERT_SAME(storage->value(movesKey(2000)).toString(), movesValue(2000));
+    SUCCESS();
+}
+
+bool test_kill()
+{
+    QTemporaryDir dir;
+    QString path = dir.path() + QStringLiteral("/state.journal");
+    mt19937 generator(42);
+    std::uniform_int_distribution<int> delay(5, 300);
+    int last = 0;
+    for (int round = 0; round < KillRounds; round++) {
+        QProcess process;
+        process.start(QCoreApplication::applicationFilePath(), { "--write", path });
+        ASSERT_TRUE(process.waitForStarted());
+        QThread::msleep(delay(generator));
+        process.kill();
+        process.waitForFinished();
+
+        QScopedPointer<JournalStorage> storage(openJournal(path));
+        auto state = storage->value("/state");
+        if (!state.isValid())
+            continue;
+        bool ok = false;
+        int n = state.toInt(&ok);
+        ASSERT_TRUE(ok);
+        ASSERT_SAME(storage->value(movesKey(n)).toString(), movesValue(n));
+        last = n;
+    }
+    ASSERT_TRUE(last > 0);
+    SUCCESS();
+}
+
+vector<tuple<string, function<bool()>>> tests = {
+    { "journal/roundtrip", test_roundtrip },
+    { "journal/removal", test_removal },
+    { "journal/torn_tail", test_torn_tail },
+    { "journal/corrupt_entry", test_corrupt_entry },
+    { "journal/migrate", test_migrate },
+    { "journal/migrate_generation", test_migrate_generation },
+    { "journal/compaction", test_compaction },
+    { "journal/kill", test_kill },
+};
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    if (argc == 3 && QByteArray(argv[1]) == "--write")
+        return writer(QString::fromLocal8Bit(argv[2]));
+
+    cout << unitbuf;
+
+    uint count = 0;
+    for (auto test : tests) {
+        string name = get<0>(test);
+        cout << "Test '" << name << "' ";
+        bool success = get<1>(test)();
+        if (success)
+            cout << "succeeded" << endl;
+        count += success;
+    }
+
+    cout << count << "/" << tests.size() << " tests succeeded" << endl;
+    return tests.size() - count;
+}
@@ -0,0 +1,8 @@
+TEMPLATE = app
+TARGET = journaltest
+
+QT = core
+
+include(../../src/engine/engine.pri)
+
+SOURCES = journaltest.cpp
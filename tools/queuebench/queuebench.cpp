@@ -0,0 +1,169 @@
+/*
+ * Benchmark for Patience Deck action queue
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <vector>
+#include "queue.h"
+
+namespace {
+    using std::cout;
+    using std::endl;
+    using std::vector;
+
+    const int Decks = 2;
+    const int SlotCount = 10;
+    const int WarmupMoves = 1000;
+    const int Moves = 100000;
+
+    long allocations = 0;
+
+    using BenchQueue = Queue<CardData *>;
+    using Table = vector<vector<CardData *>>;
+
+    bool handleQueued(BenchQueue &queue, Table &table, const Action &action)
+    {
+        vector<CardData *> &slot = table[action.slot];
+        switch (action.type) {
+        case Engine::InsertionAction:
+            {
+                if (!action.replaces)
+                    queue.incrementQueued(action.slot, action.index);
+                CardData *card = queue.take(action);
+                if (action.replaces)
+                    slot[action.index] = card;
+                else
+                    slot.insert(slot.begin() + action.index, card);
+                return card;
+            }
+        case Engine::RemovalAction:
+            {
+                CardData *card = slot[action.index];
+                slot.erase(slot.begin() + action.index);
+                queue.decrementQueued(action.slot, action.index, action.data);
+                if (card)
+                    queue.store(card);
+                return true;
+            }
+        default:
+            return true;
+        }
+    }
+
+    // Moves cards from top of one slot to another like the engine reports them
+    void move(BenchQueue &queue, Table &table, std::mt19937 &generator)
+    {
+        std::uniform_int_distribution<int> slotDistribution(0, SlotCount - 1);
+        int from = slotDistribution(generator);
+        while (table[from].empty())
+            from = slotDistribution(generator);
+        int to = slotDistribution(generator);
+        while (to == from)
+            to = slotDistribution(generator);
+
+        int count = std::uniform_int_distribution<int>(1, std::min<int>(3, table[from].size()))(generator);
+        int first = table[from].size() - count;
+        // Insertions come first every other move so that they must wait for removals
+        bool insertFirst = generator() % 2;
+        for (int pass = 0; pass < 2; pass++) {
+            if ((pass == 0) == insertFirst) {
+                for (int i = 0; i < count; i++)
+                    queue.queue(Engine::InsertionAction, to, table[to].size() + i, *table[from][first + i]);
+            } else {
+                for (int i = count - 1; i >= 0; i--)
+                    queue.queue(Engine::RemovalAction, from, first + i, *table[from][first + i]);
+            }
+        }
+
+        queue.coalesce();
+        for (auto it = queue.begin(); it != queue.end(); ++it) {
+            if (!handleQueued(queue, table, *it))
+                it.requeue();
+        }
+        queue.clear();
+    }
+} // namespace
+
+void *operator new(std::size_t size)
+{
+    allocations++;
+    if (void *pointer = std::malloc(size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    vector<CardData> cards;
+    for (int deck = 0; deck < Decks; deck++) {
+        for (int suit = SuitClubs; suit <= SuitSpade; suit++) {
+            for (int rank = RankAce; rank <= RankKing; rank++)
+                cards.push_back(CardData(static_cast<Suit>(suit), static_cast<Rank>(rank), true));
+        }
+    }
+
+    BenchQueue queue;
+    Table table(SlotCount);
+    for (int slot = 0; slot < SlotCount; slot++) {
+        queue.addSlot(slot);
+        table[slot].reserve(cards.size());
+    }
+    for (int i = 0; i < int(cards.size()); i++)
+        table[i % SlotCount].push_back(&cards[i]);
+
+    std::mt19937 generator(1);
+    for (int i = 0; i < WarmupMoves; i++)
+        move(queue, table, generator);
+
+    allocations = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < Moves; i++)
+        move(queue, table, generator);
+    qint64 elapsed = timer.nsecsElapsed();
+
+    int total = 0;
+    for (const auto &slot : table) {
+        for (CardData *card : slot)
+            total += card != nullptr;
+    }
+    total += queue.cardCount();
+
+    cout << "Moves: " << elapsed / Moves << " ns per move, "
+         << double(allocations) / Moves << " allocations per move" << endl;
+    if (total != int(cards.size())) {
+        cout << "Lost cards: " << cards.size() - total << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,8 @@
+TEMPLATE = app
+TARGET = queuebench
+
+QT = core
+
+include(../../src/engine/engine.pri)
+
+SOURCES = queuebench.cpp
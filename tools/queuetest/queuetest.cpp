@@ -0,0 +1,646 @@
+/*
+ * Tests for Patience Deck action queue
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "queue.h"
+
+#define ASSERT_TRUE(test) do { \
+    if (!(test)) { \
+        cout << "assertion (" << #test << ") is true failed" << endl; \
+        return false; \
+    } \
+} while (0)
+#define ASSERT_FALSE(test) do { \
+    if (test) { \
+        cout << "assertion (" << #test << ") is false failed" << endl; \
+        return false; \
+    } \
+} while (0)
+#define ASSERT_SAME(a, b) do { \
+    if ((a) != (b)) { \
+        cout << "assertion (" << #a << " == " << #b << ") failed" << endl; \
+        return false; \
+    } \
+} while (0)
+#define SUCCESS() do { return true; } while (0)
+
+namespace {
+    using std::cout;
+    using std::endl;
+    using std::function;
+    using std::get;
+    using std::string;
+    using std::tuple;
+    using std::unitbuf;
+    using std::vector;
+
+    using TestQueue = Queue<CardData *>;
+
+    // Cards are compared by identity, so every copy lives in its own place
+    vector<CardData> makeCards(int decks)
+    {
+        vector<CardData> cards;
+        for (int deck = 0; deck < decks; deck++) {
+            for (int suit = SuitClubs; suit <= SuitSpade; suit++) {
+                for (int rank = RankAce; rank <= RankKing; rank++)
+                    cards.push_back(CardData(static_cast<Suit>(suit), static_cast<Rank>(rank), true));
+            }
+        }
+        return cards;
+    }
+
+    Action insertion(int slot, int index, const CardData &data)
+    {
+        return Action(Engine::InsertionAction, slot, index, data);
+    }
+
+    // Iterates the queue and returns (slot, index) of each action
+    vector<tuple<int, int>> actions(TestQueue &queue)
+    {
+        vector<tuple<int, int>> result;
+        for (auto it = queue.begin(); it != queue.end(); ++it)
+            result.push_back(tuple<int, int>((*it).slot, (*it).index));
+        return result;
+    }
+
+    int recentCount(TestQueue &queue)
+    {
+        int count = 0;
+        for (auto it = queue.beginRecent(); it != queue.endRecent(); ++it)
+            count++;
+        return count;
+    }
+
+    const CardData AceOfSpades(SuitSpade, RankAce, true);
+    const CardData TwoOfHearts(SuitHeart, RankTwo, true);
+
+    const int SlotCount = 8;
+    const int Moves = 2000;
+
+    using Cards = vector<CardData>;
+
+    // Applies queued actions to its table like Manager does
+    class Table
+    {
+    public:
+        Table(const vector<Cards> &slots, bool coalesce)
+            : m_slots(slots.size())
+            , m_coalesce(coalesce)
+        {
+            for (const Cards &slot : slots)
+                m_cards.insert(m_cards.end(), slot.begin(), slot.end());
+            int i = 0;
+            for (int slot = 0; slot < int(slots.size()); slot++) {
+                m_queue.addSlot(slot);
+                for (int j = 0; j < int(slots[slot].size()); j++)
+                    m_slots[slot].push_back(&m_cards[i++]);
+            }
+        }
+
+        void queue(Engine::ActionType type, int slot, int index, const CardData &data)
+        {
+            m_queue.queue(type, slot, index, data);
+        }
+
+        int moveEnded()
+        {
+            int coalesced = m_coalesce ? m_queue.coalesce() : 0;
+            for (auto it = m_queue.begin(); it != m_queue.end(); ++it) {
+                if (!handleQueued(*it))
+                    it.requeue();
+            }
+            m_queue.clear();
+            return coalesced;
+        }
+
+        bool matches(const vector<Cards> &slots) const
+        {
+            for (int slot = 0; slot < int(slots.size()); slot++) {
+                if (m_slots[slot].size() != slots[slot].size())
+                    return false;
+                for (int i = 0; i < int(slots[slot].size()); i++) {
+                    const CardData *card = m_slots[slot][i];
+                    if (!card || !card->equalValue(slots[slot][i]) || card->show != slots[slot][i].show)
+                        return false;
+                }
+            }
+            return true;
+        }
+
+    private:
+        bool handleQueued(const Action &action)
+        {
+            vector<CardData *> &slot = m_slots[action.slot];
+            switch (action.type) {
+            case Engine::InsertionAction:
+                {
+                    if (!action.replaces)
+                        m_queue.incrementQueued(action.slot, action.index);
+                    CardData *card = m_queue.take(action);
+                    if (card)
+                        card->show = action.data.show;
+                    if (action.replaces)
+                        slot[action.index] = card;
+                    else
+                        slot.insert(slot.begin() + action.index, card);
+                    return card;
+                }
+            case Engine::RemovalAction:
+                {
+                    CardData *card = slot[action.index];
+                    slot.erase(slot.begin() + action.index);
+                    m_queue.decrementQueued(action.slot, action.index, action.data);
+                    if (card)
+                        m_queue.store(card);
+                    return true;
+                }
+            case Engine::FlippingAction:
+                if (slot[action.index])
+                    slot[action.index]->show = action.data.show;
+                else
+                    m_queue.flipQueued(action.slot, action.index, action.data);
+                return true;
+            case Engine::ClearingAction:
+                for (CardData *card : slot) {
+                    if (card)
+                        m_queue.store(card);
+                }
+                slot.clear();
+                m_queue.clearQueued(action.slot);
+                return true;
+            default:
+                return true;
+            }
+        }
+
+        vector<CardData> m_cards;
+        vector<vector<CardData *>> m_slots;
+        TestQueue m_queue;
+        bool m_coalesce;
+    };
+
+    /*
+     * Sets cards like the engine does. Only up to keep cards are kept at
+     * the bottom and at the top so that scripts that set the same cards
+     * again can be imitated.
+     */
+    void setCards(vector<Cards> &slots, vector<Table *> tables, int id, const Cards &cards, int keep)
+    {
+        Cards &slot = slots[id];
+        auto emit = [&tables, id](Engine::ActionType type, int index, const CardData &data) {
+            for (Table *table : tables)
+                table->queue(type, id, index, data);
+        };
+        if (cards.empty()) {
+            if (!slot.empty())
+                emit(Engine::ClearingAction, -1, CardData());
+            slot.clear();
+            return;
+        }
+        int oldCount = slot.size();
+        int newCount = cards.size();
+        int limit = std::min(std::min(oldCount, newCount), keep);
+        int prefix = 0;
+        while (prefix < limit && slot[prefix].equalValue(cards[prefix]))
+            prefix++;
+        int suffix = 0;
+        while (suffix < limit - prefix && slot[oldCount - 1 - suffix].equalValue(cards[newCount - 1 - suffix]))
+            suffix++;
+        auto flip = [&](int i) {
+            if (slot[i].show != cards[i].show) {
+                emit(Engine::FlippingAction, i, cards[i]);
+                slot[i].show = cards[i].show;
+            }
+        };
+        for (int i = 0; i < prefix; i++)
+            flip(i);
+        for (int i = oldCount - suffix - 1; i >= prefix; i--)
+            emit(Engine::RemovalAction, i, slot[i]);
+        slot.erase(slot.begin() + prefix, slot.begin() + oldCount - suffix);
+        for (int i = prefix; i < newCount - suffix; i++) {
+            emit(Engine::InsertionAction, i, cards[i]);
+            slot.insert(slot.begin() + i, cards[i]);
+        }
+        for (int i = newCount - suffix; i < newCount; i++)
+            flip(i);
+    }
+} // namespace
+
+bool test_queue_empty()
+{
+    TestQueue queue;
+    queue.addSlot(0);
+    queue.addSlot(1);
+    ASSERT_FALSE(queue.begin() != queue.end());
+    ASSERT_SAME(queue.actionCount(), 0);
+    ASSERT_FALSE(queue.beginStored() != queue.endStored());
+    ASSERT_FALSE(queue.beginRecent() != queue.endRecent());
+    SUCCESS();
+}
+
+bool test_queue_order()
+{
+    TestQueue queue;
+    for (int slot = 0; slot < 4; slot++)
+        queue.addSlot(slot);
+    queue.queue(Engine::RemovalAction, 3, 0, AceOfSpades);
+    queue.queue(Engine::InsertionAction, 1, 0, AceOfSpades);
+    queue.queue(Engine::InsertionAction, 0, 1, TwoOfHearts);
+    queue.requeue(insertion(2, 5, TwoOfHearts));
+    queue.requeue(insertion(0, 7, TwoOfHearts));
+    queue.requeue(insertion(2, 6, TwoOfHearts));
+    // Actions first in order, then later actions by slot
+    vector<tuple<int, int>> expected = { { 3, 0 }, { 1, 0 }, { 0, 1 }, { 0, 7 }, { 2, 5 }, { 2, 6 } };
+    ASSERT_TRUE(actions(queue) == expected);
+    ASSERT_SAME(queue.actionCount(), 6);
+    SUCCESS();
+}
+
+bool test_queue_requeue()
+{
+    TestQueue queue;
+    queue.addSlot(0);
+    queue.addSlot(1);
+    queue.queue(Engine::InsertionAction, 1, 0, AceOfSpades);
+    queue.queue(Engine::RemovalAction, 0, 0, TwoOfHearts);
+    queue.queue(Engine::InsertionAction, 0, 2, TwoOfHearts);
+    int seen = 0;
+    int replaced = 0;
+    for (auto it = queue.begin(); it != queue.end(); ++it) {
+        seen++;
+        if ((*it).replaces) {
+            replaced++;
+            // Later actions can not be queued again
+            ASSERT_FALSE(it.requeue());
+        } else if ((*it).type == Engine::InsertionAction) {
+            ASSERT_TRUE(it.requeue());
+        } else {
+            ASSERT_FALSE(it.requeue());
+        }
+    }
+    ASSERT_SAME(seen, 5);
+    ASSERT_SAME(replaced, 2);
+    queue.clear();
+    ASSERT_SAME(queue.actionCount(), 0);
+    ASSERT_FALSE(queue.begin() != queue.end());
+    SUCCESS();
+}
+
+bool test_queue_increment()
+{
+    TestQueue queue;
+    queue.addSlot(0);
+    queue.requeue(insertion(0, 1, AceOfSpades));
+    queue.requeue(insertion(0, 3, TwoOfHearts));
+    queue.incrementQueued(0, 2);
+    vector<tuple<int, int>> expected = { { 0, 1 }, { 0, 4 } };
+    ASSERT_TRUE(actions(queue) == expected);
+    // Unknown slots are ignored
+    queue.incrementQueued(5, 0);
+    ASSERT_TRUE(actions(queue) == expected);
+    SUCCESS();
+}
+
+bool test_queue_decrement()
+{
+    TestQueue queue;
+    queue.addSlot(0);
+    queue.addSlot(1);
+    queue.requeue(insertion(0, 1, AceOfSpades));
+    queue.requeue(insertion(0, 2, TwoOfHearts));
+    queue.requeue(insertion(0, 4, AceOfSpades));
+    queue.requeue(insertion(1, 2, AceOfSpades));
+    queue.decrementQueued(0, 2, TwoOfHearts);
+    vector<tuple<int, int>> expected = { { 0, 1 }, { 0, 3 }, { 1, 2 } };
+    ASSERT_TRUE(actions(queue) == expected);
+    queue.decrementQueued(0, 0, TwoOfHearts);
+    expected = { { 0, 0 }, { 0, 2 }, { 1, 2 } };
+    ASSERT_TRUE(actions(queue) == expected);
+    SUCCESS();
+}
+
+bool test_queue_flip()
+{
+    TestQueue queue;
+    queue.addSlot(0);
+    CardData hidden = AceOfSpades;
+    hidden.show = false;
+    queue.requeue(insertion(0, 1, hidden));
+    queue.flipQueued(0, 1, AceOfSpades);
+    ASSERT_TRUE((*queue.begin()).data.show);
+    SUCCESS();
+}
+
+bool test_queue_clear_slot()
+{
+    TestQueue queue;
+    queue.addSlot(0);
+    queue.addSlot(1);
+    queue.requeue(insertion(0, 1, AceOfSpades));
+    queue.requeue(insertion(1, 1, AceOfSpades));
+    queue.clearQueued(0);
+    vector<tuple<int, int>> expected = { { 1, 1 } };
+    ASSERT_TRUE(actions(queue) == expected);
+    SUCCESS();
+}
+
+bool test_store_take_latest()
+{
+    vector<CardData> cards = makeCards(3);
+    TestQueue queue;
+    for (CardData &card : cards)
+        queue.store(&card);
+    ASSERT_SAME(queue.cardCount(), 3 * 52);
+    // The copy that was stored last comes out first
+    Action action = insertion(0, 0, AceOfSpades);
+    ASSERT_SAME(queue.take(action), &cards[2 * 52 + 39]);
+    ASSERT_SAME(queue.take(action), &cards[52 + 39]);
+    ASSERT_SAME(queue.take(action), &cards[39]);
+    ASSERT_SAME(queue.take(action), nullptr);
+    ASSERT_SAME(queue.cardCount(), 3 * 51);
+    SUCCESS();
+}
+
+bool test_store_invalid()
+{
+    TestQueue queue;
+    CardData invalid;
+    queue.store(&invalid);
+    ASSERT_SAME(queue.cardCount(), 0);
+    ASSERT_SAME(queue.take(Action(Engine::ClearingAction, 0, 0, invalid)), nullptr);
+    SUCCESS();
+}
+
+bool test_store_recent()
+{
+    vector<CardData> cards = makeCards(2);
+    TestQueue queue;
+    for (int i = 0; i < 10; i++)
+        queue.store(&cards[i]);
+    ASSERT_SAME(recentCount(queue), 10);
+    queue.clear();
+    // Clearing the queue keeps the cards but forgets that they were stored recently
+    ASSERT_SAME(queue.cardCount(), 10);
+    ASSERT_SAME(recentCount(queue), 0);
+    queue.store(&cards[52]);
+    queue.store(&cards[60]);
+    ASSERT_SAME(recentCount(queue), 2);
+    ASSERT_SAME(*queue.beginRecent(), &cards[52]);
+    ASSERT_SAME(queue.take(insertion(0, 0, cards[52])), &cards[52]);
+    ASSERT_SAME(recentCount(queue), 1);
+    ASSERT_SAME(queue.take(insertion(0, 0, cards[0])), &cards[0]);
+    ASSERT_SAME(recentCount(queue), 1);
+    SUCCESS();
+}
+
+bool test_store_take_all()
+{
+    vector<CardData> cards = makeCards(4);
+    TestQueue queue;
+    for (CardData &card : cards)
+        queue.store(&card);
+    QList<CardData *> taken = queue.takeAll();
+    ASSERT_SAME(taken.count(), int(cards.size()));
+    for (CardData &card : cards)
+        ASSERT_TRUE(taken.contains(&card));
+    ASSERT_SAME(queue.cardCount(), 0);
+    ASSERT_FALSE(queue.beginStored() != queue.endStored());
+    ASSERT_SAME(queue.take(insertion(0, 0, AceOfSpades)), nullptr);
+    SUCCESS();
+}
+
+bool test_store_iterate()
+{
+    vector<CardData> cards = makeCards(3);
+    TestQueue queue;
+    for (CardData &card : cards)
+        queue.store(&card);
+    for (int i = 0; i < 52; i++)
+        queue.take(insertion(0, 0, cards[i]));
+    vector<CardData *> seen;
+    for (auto it = queue.beginStored(); it != queue.endStored(); ++it)
+        seen.push_back(*it);
+    ASSERT_SAME(seen.size(), 2 * 52u);
+    for (CardData *card : seen)
+        ASSERT_TRUE(card >= &cards[0] && card < &cards[0] + cards.size());
+    SUCCESS();
+}
+
+bool test_queue_coalesce_pairs()
+{
+    TestQueue queue;
+    queue.addSlot(0);
+    queue.addSlot(1);
+    CardData hidden = AceOfSpades;
+    hidden.show = false;
+    queue.queue(Engine::RemovalAction, 0, 3, AceOfSpades);
+    queue.queue(Engine::InsertionAction, 1, 0, TwoOfHearts);
+    queue.queue(Engine::InsertionAction, 0, 3, hidden);
+    queue.queue(Engine::FlippingAction, 1, 0, TwoOfHearts);
+    queue.queue(Engine::FlippingAction, 1, 0, TwoOfHearts);
+    // Removal and insertion of the same card become a flip, flips fold into the insertion
+    ASSERT_SAME(queue.coalesce(), 3);
+    ASSERT_SAME(queue.actionCount(), 2);
+    ASSERT_SAME((*queue.begin()).type, Engine::InsertionAction);
+    ASSERT_SAME((*++queue.begin()).type, Engine::FlippingAction);
+    ASSERT_FALSE((*++queue.begin()).data.show);
+    SUCCESS();
+}
+
+// Removing or inserting a card shifts the cards above it, so their flips block coalescing
+bool test_queue_coalesce_flip_above()
+{
+    CardData a(SuitClubs, RankAce, true);
+    CardData b(SuitClubs, RankTwo, true);
+    CardData c(SuitClubs, RankThree, true);
+    CardData d(SuitClubs, RankFour, true);
+    CardData hiddenD = d;
+    hiddenD.show = false;
+    vector<Cards> initial = { { a, b, c, d } };
+    vector<Cards> expected = { { a, b, c, hiddenD } };
+    Table plain(initial, false);
+    Table coalesced(initial, true);
+    for (Table *table : { &plain, &coalesced }) {
+        table->queue(Engine::RemovalAction, 0, 1, b);
+        table->queue(Engine::FlippingAction, 0, 2, hiddenD);
+        table->queue(Engine::InsertionAction, 0, 1, b);
+    }
+    plain.moveEnded();
+    ASSERT_SAME(coalesced.moveEnded(), 0);
+    ASSERT_TRUE(plain.matches(expected));
+    ASSERT_TRUE(coalesced.matches(expected));
+
+    TestQueue queue;
+    queue.addSlot(0);
+    queue.queue(Engine::InsertionAction, 0, 1, b);
+    queue.queue(Engine::FlippingAction, 0, 3, hiddenD);
+    queue.queue(Engine::RemovalAction, 0, 1, b);
+    ASSERT_SAME(queue.coalesce(), 0);
+    queue.clear();
+    // Flips below are not affected
+    queue.queue(Engine::RemovalAction, 0, 2, c);
+    queue.queue(Engine::FlippingAction, 0, 1, b);
+    queue.queue(Engine::InsertionAction, 0, 2, c);
+    ASSERT_SAME(queue.coalesce(), 2);
+    SUCCESS();
+}
+
+bool test_queue_coalesce_blocked()
+{
+    TestQueue queue;
+    queue.addSlot(0);
+    queue.addSlot(1);
+    // The insertion to slot 1 takes the removed card, so nothing cancels
+    queue.queue(Engine::RemovalAction, 0, 3, AceOfSpades);
+    queue.queue(Engine::InsertionAction, 1, 0, AceOfSpades);
+    queue.queue(Engine::InsertionAction, 0, 3, AceOfSpades);
+    ASSERT_SAME(queue.coalesce(), 0);
+    queue.clear();
+    queue.queue(Engine::RemovalAction, 0, 3, AceOfSpades);
+    queue.queue(Engine::ClearingAction, 1, -1, CardData());
+    queue.queue(Engine::InsertionAction, 0, 3, AceOfSpades);
+    ASSERT_SAME(queue.coalesce(), 0);
+    SUCCESS();
+}
+
+// Plays random moves and checks that coalescing doesn't change the table
+bool test_queue_coalesce_random()
+{
+    std::mt19937 generator(7);
+    vector<Cards> slots(SlotCount);
+    for (int deck = 0; deck < 2; deck++) {
+        for (int suit = SuitClubs; suit <= SuitSpade; suit++) {
+            for (int rank = RankAce; rank <= RankKing; rank++)
+                slots[generator() % SlotCount].push_back(CardData(static_cast<Suit>(suit), static_cast<Rank>(rank), generator() % 2));
+        }
+    }
+    Table plain(slots, false);
+    Table coalesced(slots, true);
+    vector<Table *> tables = { &plain, &coalesced };
+    int dropped = 0;
+    for (int move = 0; move < Moves; move++) {
+        int steps = 1 + generator() % 4;
+        for (int step = 0; step < steps; step++) {
+            int from = generator() % SlotCount;
+            int to = generator() % SlotCount;
+            Cards cards = slots[from];
+            switch (generator() % 5) {
+            case 0:
+                if (!cards.empty() && from != to) {
+                    int count = 1 + generator() % std::min<int>(3, cards.size());
+                    Cards moved(cards.end() - count, cards.end());
+                    cards.resize(cards.size() - count);
+                    Cards target = slots[to];
+                    target.insert(target.end(), moved.begin(), moved.end());
+                    // Inserting first makes the insertions wait for the cards
+                    bool insertFirst = generator() % 2;
+                    if (insertFirst)
+                        setCards(slots, tables, to, target, target.size());
+                    setCards(slots, tables, from, cards, cards.size());
+                    if (!insertFirst)
+                        setCards(slots, tables, to, target, target.size());
+                }
+                break;
+            case 1:
+                if (!cards.empty())
+                    cards.back().show = !cards.back().show;
+                setCards(slots, tables, from, cards, cards.size());
+                break;
+            case 2:
+                if (!cards.empty() && generator() % 2)
+                    cards.back().show = !cards.back().show;
+                setCards(slots, tables, from, cards, generator() % (cards.size() + 1));
+                break;
+            case 3:
+                if (from != to && generator() % 4 == 0) {
+                    Cards target = slots[to];
+                    target.insert(target.end(), cards.begin(), cards.end());
+                    setCards(slots, tables, from, Cards(), 0);
+                    setCards(slots, tables, to, target, target.size());
+                }
+                break;
+            case 4:
+                if (cards.size() > 1) {
+                    // Take a card from under others, flip some of them and maybe put it back
+                    int index = generator() % (cards.size() - 1);
+                    CardData card = cards[index];
+                    cards.erase(cards.begin() + index);
+                    for (int i = index; i < int(cards.size()); i++) {
+                        if (generator() % 2)
+                            cards[i].show = !cards[i].show;
+                    }
+                    setCards(slots, tables, from, cards, cards.size());
+                    if (generator() % 2) {
+                        cards.insert(cards.begin() + index, card);
+                        setCards(slots, tables, from, cards, cards.size());
+                    }
+                }
+                break;
+            }
+        }
+        plain.moveEnded();
+        dropped += coalesced.moveEnded();
+        ASSERT_TRUE(plain.matches(slots));
+        ASSERT_TRUE(coalesced.matches(slots));
+    }
+    ASSERT_TRUE(dropped > 0);
+    SUCCESS();
+}
+
+vector<tuple<string, function<bool()>>> tests = {
+    { "queue/empty", test_queue_empty },
+    { "queue/order", test_queue_order },
+    { "queue/requeue", test_queue_requeue },
+    { "queue/increment", test_queue_increment },
+    { "queue/decrement", test_queue_decrement },
+    { "queue/flip", test_queue_flip },
+    { "queue/clear_slot", test_queue_clear_slot },
+    { "queue/coalesce_pairs", test_queue_coalesce_pairs },
+    { "queue/coalesce_flip_above", test_queue_coalesce_flip_above },
+    { "queue/coalesce_blocked", test_queue_coalesce_blocked },
+    { "queue/coalesce_random", test_queue_coalesce_random },
+    { "store/take_latest", test_store_take_latest },
+    { "store/invalid", test_store_invalid },
+    { "store/recent", test_store_recent },
+    { "store/take_all", test_store_take_all },
+    { "store/iterate", test_store_iterate },
+};
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    cout << unitbuf;
+
+    uint count = 0;
+    for (auto test : tests) {
+        string name = get<0>(test);
+        cout << "Test '" << name << "' ";
+        bool success = get<1>(test)();
+        if (success)
+            cout << "succeeded" << endl;
+        count += success;
+    }
+
+    cout << count << "/" << tests.size() << " tests succeeded" << endl;
+    return tests.size() - count;
+}
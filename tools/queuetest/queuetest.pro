@@ -0,0 +1,8 @@
+TEMPLATE = app
+TARGET = queuetest
+
+QT = core
+
+include(../../src/engine/engine.pri)
+
+SOURCES = queuetest.cpp
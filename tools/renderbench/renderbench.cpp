@@ -0,0 +1,118 @@
+/*
+ * Benchmark for drawing Patience Deck card textures
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <iostream>
+#include "cardrasterizer.h"
+#include "svgdocument.h"
+
+namespace {
+    using std::cout;
+    using std::endl;
+
+    const QSize CardBaseSize(79, 123);
+    const int Rounds = 3;
+    const QHash<QString, QString> Colors = {
+        { QStringLiteral("back"), QStringLiteral("#204a87") },
+        { QStringLiteral("club"), QStringLiteral("#4e9a06") },
+        { QStringLiteral("diamond"), QStringLiteral("#ce5c00") },
+        { QStringLiteral("heart"), QStringLiteral("#a40000") },
+        { QStringLiteral("spade"), QStringLiteral("#2e3436") },
+    };
+
+    // Best of a few rounds of loading and recoloring the document
+    qint64 measureLoad(SvgDocument &document)
+    {
+        qint64 best = -1;
+        for (int round = 0; round < Rounds; round++) {
+            QElapsedTimer timer;
+            timer.start();
+            document.load(Colors);
+            qint64 elapsed = timer.nsecsElapsed() / 1000;
+            if (best < 0 || elapsed < best)
+                best = elapsed;
+        }
+        return best;
+    }
+
+    // Best of a few rounds, every round parses the document again like a cold start
+    qint64 measure(const QByteArray &document, const QSize &size, int threads, QImage &image)
+    {
+        qint64 best = -1;
+        for (int round = 0; round < Rounds; round++) {
+            CardRasterizer rasterizer;
+            rasterizer.setDocument(document);
+            QElapsedTimer timer;
+            timer.start();
+            image = rasterizer.rasterize(size, threads);
+            qint64 elapsed = timer.nsecsElapsed() / 1000;
+            if (best < 0 || elapsed < best)
+                best = elapsed;
+        }
+        return best;
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOptions({
+        {{"t", "threads"}, "Maximum number of threads", "count",
+         QString::number(CardRasterizer::idealThreadCount())},
+        {{"s", "scale"}, "Card size as a multiple of 79x123", "scale", "2"},
+    });
+    parser.addPositionalArgument("svg", "Card style documents to draw", "svg...");
+    parser.process(app);
+
+    int maxThreads = parser.value("threads").toInt();
+    qreal scale = parser.value("scale").toDouble();
+    QSize cardSize = CardBaseSize * qMax(scale, 0.1);
+    QSize size(cardSize.width() * 13, cardSize.height() * 5);
+
+    for (const QString &path : parser.positionalArguments()) {
+        if (!QFile::exists(path)) {
+            cout << "Can not open " << path.toStdString() << endl;
+            return 1;
+        }
+        SvgDocument svgDocument(path);
+        qint64 loading = measureLoad(svgDocument);
+        QByteArray document = svgDocument.data();
+
+        cout << QFileInfo(path).fileName().toStdString() << ", "
+             << size.width() << "x" << size.height() << ":" << endl;
+        cout << "  loading with colors: " << loading / 1000.0 << " ms" << endl;
+        QImage reference;
+        qint64 serial = measure(document, size, 1, reference);
+        for (int threads = 1; threads <= maxThreads; threads++) {
+            QImage image;
+            qint64 elapsed = threads == 1 ? serial : measure(document, size, threads, image);
+            cout << "  " << threads << " threads: " << elapsed / 1000 << " ms, "
+                 << "speedup " << double(serial) / elapsed;
+            if (threads > 1 && image != reference)
+                cout << ", output differs from 1 thread!";
+            cout << endl;
+        }
+    }
+
+    return 0;
+}
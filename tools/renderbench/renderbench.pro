@@ -0,0 +1,11 @@
+TEMPLATE = app
+TARGET = renderbench
+
+QT = core gui svg
+
+include(../../src/engine/engine.pri)
+
+INCLUDEPATH += ../../src/table
+
+HEADERS = ../../src/table/cardrasterizer.h ../../src/table/svgdocument.h
+SOURCES = renderbench.cpp ../../src/table/cardrasterizer.cpp ../../src/table/svgdocument.cpp
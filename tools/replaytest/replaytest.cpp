@@ -0,0 +1,530 @@
+/*
+ * Replay regression tests for Patience Deck engine
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+#include <iostream>
+#include "archive.h"
+#include "checker.h"
+#include "engine.h"
+#include "recorder.h"
+#include "storage.h"
+
+/*
+ * Runs the saved games of tests/games.test like tests/tester.py does but
+ * without starting the whole application for every test. Engine is a
+ * singleton with global Guile state, so tests are split between worker
+ * processes, one per core, and every worker replays its share of tests
+ * one after another in the same engine. Actions of the engine are also
+ * applied to a queue by EngineChecker like the table does, and any
+ * difference to the engine's cards fails the test.
+ *
+ * With --archive the games of an archive are replayed instead and checked
+ * against their recorded results. Every worker streams its own byte range
+ * of the archive so it is never loaded whole.
+ *
+ * With --check-switch the archive entry of a deal that is left by switching
+ * to another game is checked instead.
+ */
+
+namespace {
+    using std::cout;
+    using std::endl;
+
+    const QStringList Results = {
+        QStringLiteral("WON"),   // 0
+        QStringLiteral("INVAL"), // 1
+        QStringLiteral("LOST"),  // 2
+        QStringLiteral("STUCK"), // 3
+        QStringLiteral("NEW"),   // 4
+        QStringLiteral("OTHER"), // 5
+    };
+
+    enum Result {
+        Won = 0,
+        Invalid = 1,
+        Lost = 2,
+        Stuck = 3,
+        New = 4,
+        Other = 5,
+    };
+
+    // Time to wait for game over after the game has started
+    const int SettleDelay = 50;
+    const int TestTimeout = 5 * 60 * 1000;
+    const QString RecordedTime = QStringLiteral("60");
+
+    struct Test {
+        QStringList arguments;
+        QString game;
+        QString seed;
+        int result;
+        int errors;
+    };
+
+    struct Report {
+        Test test;
+        int result = -1;
+        QStringList errors;
+        QStringList checks;
+    };
+
+    qint64 s_current = -1;
+
+    QString resultText(int code)
+    {
+        if (code >= 0 && code < Results.count())
+            return Results.at(code);
+        return QStringLiteral("UNKNOWN(%1)").arg(code);
+    }
+
+    // Splits a command line like shlex.split does for the lines of games.test
+    QStringList splitArguments(const QString &line)
+    {
+        QStringList arguments;
+        QString current;
+        bool inArgument = false;
+        QChar quote;
+        for (const QChar c : line) {
+            if (!quote.isNull()) {
+                if (c == quote)
+                    quote = QChar();
+                else
+                    current.append(c);
+            } else if (c == '\'' || c == '"') {
+                quote = c;
+                inArgument = true;
+            } else if (c.isSpace()) {
+                if (inArgument)
+                    arguments.append(current);
+                current.clear();
+                inArgument = false;
+            } else {
+                current.append(c);
+                inArgument = true;
+            }
+        }
+        if (inArgument)
+            arguments.append(current);
+        return arguments;
+    }
+
+    QVector<Test> readTests(const QString &path)
+    {
+        QVector<Test> tests;
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            qCritical() << "Can not open" << path << file.errorString();
+            return tests;
+        }
+
+        QRegularExpression comment("(WON|INVAL|LOST|STUCK|NEW|OTHER)(?:, errors (\\d+))?");
+        while (!file.atEnd()) {
+            QString line = QString::fromUtf8(file.readLine());
+            if (line.startsWith('#') || line.trimmed().isEmpty())
+                continue;
+            int sep = line.indexOf('#');
+            Test test;
+            test.result = Won;
+            test.errors = 0;
+            auto match = comment.match(sep >= 0 ? line.mid(sep + 1) : QString());
+            if (match.hasMatch()) {
+                test.result = Results.indexOf(match.captured(1));
+                test.errors = match.captured(2).toInt();
+            }
+            // Replace the program name of the command line
+            test.arguments = splitArguments(line.left(sep));
+            if (!test.arguments.isEmpty())
+                test.arguments.removeFirst();
+            test.arguments.prepend(QCoreApplication::applicationFilePath());
+            test.arguments << QStringLiteral("--time") << RecordedTime;
+
+            QCommandLineParser parser;
+            Recorder::addArguments(&parser);
+            parser.parse(test.arguments);
+            test.game = parser.value("game");
+            test.seed = parser.value("seed");
+            tests.append(test);
+        }
+        return tests;
+    }
+
+    void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+    {
+        if (type != QtWarningMsg && type != QtCriticalMsg && type != QtFatalMsg)
+            return;
+        QString text = QStringLiteral("[%1] %2: %3")
+            .arg(type == QtWarningMsg ? 'W' : type == QtCriticalMsg ? 'C' : 'F')
+            .arg(context.category).arg(message).simplified();
+        cout << "ERROR " << s_current << " " << qPrintable(text) << endl;
+        if (type == QtFatalMsg)
+            abort();
+    }
+
+    // Replays one saved game and returns what tester.py would get as exit code
+    int replay(const QStringList &arguments)
+    {
+        auto engine = Engine::instance();
+        engine->reset();
+        auto storage = new MemoryStorage();
+        engine->setStorage(storage);
+
+        QCommandLineParser parser;
+        Recorder::addArguments(&parser);
+        if (!parser.parse(arguments)) {
+            qWarning() << "Invalid arguments:" << parser.errorText();
+            return Invalid;
+        }
+        Recorder::setArguments(&parser, storage);
+
+        enum State {
+            LoadingState,
+            RestoringState,
+            RestartingState,
+            StartingState,
+            RunningState,
+            GameOverState,
+            WonState,
+        } state = LoadingState;
+
+        QEventLoop loop;
+        QObject context;
+        QObject::connect(engine, &Engine::restoreStarted, &context, [&] {
+            state = RestoringState;
+        });
+        QObject::connect(engine, &Engine::restoreCompleted, &context, [&](bool restored, bool success) {
+            if (restored && !success)
+                state = RestartingState;
+            else if (!restored)
+                loop.exit(Other);
+        });
+        QObject::connect(engine, &Engine::gameStarted, &context, [&] {
+            state = state == RestoringState ? RunningState : StartingState;
+            QTimer::singleShot(SettleDelay, &context, [&] {
+                switch (state) {
+                case StartingState:
+                    loop.exit(New);
+                    break;
+                case RunningState:
+                    loop.exit(Stuck);
+                    break;
+                case GameOverState:
+                    loop.exit(Lost);
+                    break;
+                case WonState:
+                    loop.exit(Won);
+                    break;
+                default:
+                    loop.exit(Other);
+                    break;
+                }
+            });
+        });
+        QObject::connect(engine, &Engine::gameOver, &context, [&](bool won) {
+            state = won ? WonState : GameOverState;
+        });
+        QTimer::singleShot(TestTimeout, &context, [&] {
+            qWarning() << "Test timed out";
+            loop.exit(Other);
+        });
+
+        engine->restoreSavedState();
+        return loop.exec();
+    }
+
+    int toResult(ArchiveEntry::Result result)
+    {
+        switch (result) {
+        case ArchiveEntry::Won:
+            return Won;
+        case ArchiveEntry::Lost:
+            return Lost;
+        default:
+            return Stuck;
+        }
+    }
+
+    void runTest(qint64 key, const Test &test)
+    {
+        s_current = key;
+        cout << "TEST " << key << " " << test.result << " " << test.errors << " "
+             << qPrintable(test.game) << " " << qPrintable(test.seed) << endl;
+        int result = replay(test.arguments);
+        cout << "RESULT " << key << " " << result << endl;
+    }
+
+    // Errors that mean the queue would show different cards than the engine has
+    void reportCheck(const EngineChecker::Error &error)
+    {
+        switch (error.reason) {
+        case EngineChecker::Error::WrongCard:
+        case EngineChecker::Error::BadIndex:
+        case EngineChecker::Error::Mismatch:
+            {
+                QString text;
+                QDebug(&text) << error;
+                cout << "CHECK " << s_current << " " << qPrintable(text.simplified()) << endl;
+                break;
+            }
+        default:
+            break;
+        }
+    }
+
+    int worker(const QString &path, bool archive, int shard, int shards, const QString &gamesDirectory)
+    {
+        qputenv("GUILE_AUTO_COMPILE", "0");
+        qInstallMessageHandler(messageHandler);
+        if (gamesDirectory.isEmpty())
+            Engine::instance()->init();
+        else
+            Engine::instance()->initWithDirectory(gamesDirectory);
+        EngineChecker checker;
+        QObject::connect(&checker, &EngineChecker::errorFound, &reportCheck);
+
+        if (!archive) {
+            auto tests = readTests(path);
+            for (int i = shard; i < tests.count(); i += shards)
+                runTest(i, tests.at(i));
+            return 0;
+        }
+
+        qint64 size = QFileInfo(path).size();
+        ArchiveReader reader(path, size * shard / shards, size * (shard + 1) / shards);
+        if (!reader.isOpen())
+            return 1;
+        ArchiveEntry entry;
+        while (reader.next(entry)) {
+            Test test;
+            test.arguments = QStringList(QCoreApplication::applicationFilePath()) + entry.arguments();
+            test.game = entry.gameFile;
+            test.seed = QString::number(entry.seed);
+            test.result = toResult(entry.result);
+            test.errors = 0;
+            runTest(reader.position(), test);
+        }
+        return 0;
+    }
+
+    // Deal that was replaced and then left for another game must keep its own game file
+    int checkSwitch(const QString &gamesDirectory)
+    {
+        const QString first = QStringLiteral("klondike.scm");
+        const QString second = QStringLiteral("freecell.scm");
+
+        qputenv("GUILE_AUTO_COMPILE", "0");
+        auto engine = Engine::instance();
+        if (gamesDirectory.isEmpty())
+            engine->init();
+        else
+            engine->initWithDirectory(gamesDirectory);
+        auto storage = new MemoryStorage();
+        engine->setStorage(storage);
+
+        QTemporaryDir directory;
+        QString path = directory.path() + QStringLiteral("/games.archive");
+        QCommandLineParser parser;
+        Recorder::addArguments(&parser);
+        parser.parse({ QCoreApplication::applicationFilePath(), QStringLiteral("--archive"), path });
+        Recorder::setArguments(&parser, storage);
+
+        engine->load(first);
+        engine->start();
+        quint32 seed = engine->seed();
+        // A new deal keeps the first one as the previous game
+        engine->start();
+        engine->load(second);
+        engine->forgetPreviousGame();
+
+        ArchiveReader reader(path);
+        ArchiveEntry entry;
+        int count = 0;
+        bool success = true;
+        while (reader.next(entry)) {
+            count++;
+            if (entry.gameFile != first || entry.seed != seed || entry.result != ArchiveEntry::Unfinished) {
+                cout << "Archived " << qPrintable(entry.gameFile) << " with seed " << entry.seed
+                     << ", expected " << qPrintable(first) << " with seed " << seed << endl;
+                success = false;
+            }
+        }
+        if (count != 1) {
+            cout << "Archived " << count << " games, expected 1" << endl;
+            success = false;
+        }
+        cout << "Switching games " << (success ? "succeeded" : "FAILED") << endl;
+        return success ? 0 : 1;
+    }
+
+    int run(const QString &path, bool archive, int jobs, const QString &gamesDirectory)
+    {
+        if (!archive) {
+            int count = readTests(path).count();
+            if (count == 0)
+                return 1;
+            jobs = qMin(jobs, count);
+        }
+        jobs = qMax(1, jobs);
+
+        QElapsedTimer timer;
+        timer.start();
+        // Collect output as it comes so that workers never block on a full pipe
+        QEventLoop loop;
+        QVector<QByteArray> outputs(jobs);
+        int running = jobs;
+        QVector<QProcess *> workers;
+        for (int i = 0; i < jobs; i++) {
+            QStringList arguments = { "--worker", QStringLiteral("%1/%2").arg(i).arg(jobs) };
+            if (!gamesDirectory.isEmpty())
+                arguments << "--games" << gamesDirectory;
+            if (archive)
+                arguments << "--archive";
+            arguments << path;
+            QProcess *process = new QProcess(&loop);
+            process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+            QObject::connect(process, &QProcess::readyReadStandardOutput, &loop, [&outputs, process, i] {
+                outputs[i].append(process->readAllStandardOutput());
+            });
+            QObject::connect(process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+                             &loop, [&loop, &running] {
+                if (--running == 0)
+                    loop.quit();
+            });
+            QObject::connect(process, &QProcess::errorOccurred, &loop, [&loop, &running](QProcess::ProcessError error) {
+                if (error == QProcess::FailedToStart && --running == 0)
+                    loop.quit();
+            });
+            process->start(QCoreApplication::applicationFilePath(), arguments);
+            workers.append(process);
+        }
+        loop.exec();
+
+        // Only results are kept, tests themselves stay in the workers
+        QMap<qint64, Report> reports;
+        bool workersFailed = false;
+        for (int i = 0; i < jobs; i++) {
+            QProcess *process = workers.at(i);
+            outputs[i].append(process->readAllStandardOutput());
+            if (process->exitStatus() != QProcess::NormalExit || process->exitCode() != 0) {
+                cout << "Worker " << i << " failed" << endl;
+                workersFailed = true;
+            }
+            for (const QByteArray &line : outputs.at(i).split('\n')) {
+                QList<QByteArray> parts = line.split(' ');
+                if (parts.count() < 3)
+                    continue;
+                qint64 key = parts.at(1).toLongLong();
+                if (parts.at(0) == "TEST" && parts.count() == 6) {
+                    Report &report = reports[key];
+                    report.test.result = parts.at(2).toInt();
+                    report.test.errors = parts.at(3).toInt();
+                    report.test.game = QString::fromUtf8(parts.at(4));
+                    report.test.seed = QString::fromUtf8(parts.at(5));
+                } else if (parts.at(0) == "RESULT" && reports.contains(key)) {
+                    reports[key].result = parts.at(2).toInt();
+                } else if (parts.at(0) == "ERROR" && reports.contains(key)) {
+                    reports[key].errors.append(QString::fromUtf8(line.mid(parts.at(0).size() + parts.at(1).size() + 2)));
+                } else if (parts.at(0) == "CHECK" && reports.contains(key)) {
+                    reports[key].checks.append(QString::fromUtf8(line.mid(parts.at(0).size() + parts.at(1).size() + 2)));
+                }
+            }
+        }
+
+        int successful = 0;
+        for (const Report &report : reports) {
+            const Test &test = report.test;
+            cout << "Testing with " << qPrintable(test.game) << " (seed " << qPrintable(test.seed) << ")...";
+            if (report.result < 0) {
+                cout << " FAILED, worker did not finish the test" << endl;
+            } else if (!report.checks.isEmpty()) {
+                cout << " FAILED, queue differs from engine"
+                     << ", result " << qPrintable(resultText(report.result)) << endl;
+            } else if (report.result == test.result && report.errors.count() == test.errors) {
+                if (test.errors == 0)
+                    cout << " succeeded";
+                else
+                    cout << " succeeded with " << test.errors << " expected errors";
+                cout << ", result " << qPrintable(resultText(report.result)) << endl;
+                successful++;
+            } else {
+                cout << " FAILED with " << report.errors.count() << " errors"
+                     << ", result " << qPrintable(resultText(report.result))
+                     << ", expected " << qPrintable(resultText(test.result)) << endl;
+            }
+            for (const QString &error : report.errors)
+                cout << "--> " << qPrintable(error) << endl;
+            for (const QString &check : report.checks)
+                cout << "--> " << qPrintable(check) << endl;
+        }
+
+        int count = reports.count();
+        cout << "Ran " << count << " tests in " << jobs << " workers in "
+             << timer.elapsed() / 1000.0 << " s" << endl;
+        if (successful == count && !workersFailed) {
+            cout << "All " << count << " tests passed!" << endl;
+            return 0;
+        }
+        cout << "Failure: " << successful << "/" << count << " tests passed, failed "
+             << count - successful << endl;
+        return 1;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays saved games of Patience Deck in parallel.");
+    parser.addHelpOption();
+    parser.addOptions({
+        {{"j", "jobs"}, "Number of worker processes", "count", QString::number(QThread::idealThreadCount())},
+        {"games", "Directory to load games from", "directory"},
+        {"archive", "Replay the games of an archive instead of a test file"},
+        {"worker", "Run tests of a shard, used internally", "shard/count"},
+        {"check-switch", "Check archiving a game that is left by switching games"},
+    });
+    parser.addPositionalArgument("file", "File of saved games, e.g. tests/games.test, or an archive");
+    parser.process(app);
+
+    if (parser.isSet("check-switch"))
+        return checkSwitch(parser.value("games"));
+
+    if (parser.positionalArguments().count() != 1)
+        parser.showHelp(1);
+    QString path = parser.positionalArguments().first();
+
+    if (parser.isSet("worker")) {
+        QStringList shard = parser.value("worker").split('/');
+        if (shard.count() != 2 || shard.at(1).toInt() <= 0)
+            parser.showHelp(1);
+        return worker(path, parser.isSet("archive"), shard.at(0).toInt(), shard.at(1).toInt(),
+                      parser.value("games"));
+    }
+    return run(path, parser.isSet("archive"), parser.value("jobs").toInt(), parser.value("games"));
+}
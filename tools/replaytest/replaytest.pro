@@ -0,0 +1,15 @@
+TEMPLATE = app
+TARGET = replaytest
+
+QT = core
+
+include(../../src/engine/engine.pri)
+
+INCLUDEPATH += ../exerciser/src
+
+SOURCES = \
+    replaytest.cpp \
+    ../exerciser/src/checker.cpp
+
+HEADERS = \
+    ../exerciser/src/checker.h
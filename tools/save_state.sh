@@ -23,11 +23,51 @@ fi
 shift
 COMMENT="$*"
 
-STATE=$(dconf read /site/tomin/apps/PatienceDeck/state | tr -d \')
+CONF=/site/tomin/apps/PatienceDeck
+TAB=$(printf '\t')
+JOURNAL=$(dconf read "$CONF/journal" | tr -d \')
+
+# Game state lives in the journal file if there is one, latest entry wins
+read_state() {
+    if [ "$JOURNAL" != "" ];
+    then
+        grep -a "^[+-]$1$TAB" "$JOURNAL" | tail -n 1 | grep '^+' | cut -f2
+    else
+        dconf read "$CONF$1" | tr -d \'
+    fi
+}
+
+STATE=$(read_state /state)
 GAME="${STATE%%;*}"
 SEED=$(echo "$STATE" | cut -d\; -f2)
-MOVES="${STATE##*;}"
-OPTIONS=$(dconf read "/site/tomin/apps/PatienceDeck/options/${GAME%.scm}" | tr -d \')
+VERSION=$(echo "$STATE" | cut -d\; -f3)
+if [ "$VERSION" = "1" ];
+then
+    # Binary move log is split into chunks stored in separate keys
+    CHUNKS=$(echo "$STATE" | cut -d\; -f5)
+    # Rewritten logs alternate between key generations, 0 uses the old keys
+    GENERATION=$(echo "$STATE" | cut -d\; -f6)
+    if [ "$GENERATION" != "" ] && [ "$GENERATION" != "0" ];
+    then
+        PREFIX="/moves/$GENERATION-"
+    else
+        PREFIX="/moves/"
+    fi
+    MOVES="1:"
+    i=0
+    while [ "$i" -lt "$CHUNKS" ];
+    do
+        if [ "$i" -gt 0 ];
+        then
+            MOVES="$MOVES,"
+        fi
+        MOVES="$MOVES$(read_state "$PREFIX$i")"
+        i=$((i + 1))
+    done
+else
+    MOVES="${STATE##*;}"
+fi
+OPTIONS=$(dconf read "$CONF/options/${GAME%.scm}" | tr -d \')
 
 COMMAND="patience-deck --game '$GAME' --seed $SEED --moves '$MOVES'"
 if [ "$OPTIONS" != "" ];
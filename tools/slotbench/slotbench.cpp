@@ -0,0 +1,96 @@
+/*
+ * Benchmark for Patience Deck slot diffing
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <functional>
+#include <iostream>
+#include <libguile.h>
+#include "engine.h"
+#include "engineinternals.h"
+
+namespace {
+    using std::cout;
+    using std::endl;
+    using std::function;
+
+    const int Rounds = 10000;
+
+    CardBuffer makeStack(int count, int shown)
+    {
+        CardBuffer cards;
+        cards.reserve(count);
+        for (int i = 0; i < count; i++) {
+            cards.append(CardData(static_cast<Suit>(i / 13 % 4),
+                                  static_cast<Rank>(i % 13 + 1),
+                                  i >= count - shown));
+        }
+        return cards;
+    }
+
+    int actions = 0;
+
+    void run(const char *name, int slot, const CardBuffer &first, const CardBuffer &second)
+    {
+        auto engine = EngineInternals::instance();
+        engine->setCards(slot, first);
+        actions = 0;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < Rounds; i++) {
+            engine->setCards(slot, second);
+            engine->setCards(slot, first);
+        }
+        qint64 elapsed = timer.nsecsElapsed();
+        cout << name << ": " << elapsed / (2 * Rounds) << " ns per call, "
+             << actions / (2 * Rounds) << " actions per call" << endl;
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    scm_init_guile();
+    QObject::connect(Engine::instance(), &Engine::action, [] { actions++; });
+
+    auto engine = EngineInternals::instance();
+    engine->addSlot(0, CardBuffer(), TableauSlot, 0, 0, -1, true, false);
+    engine->addSlot(1, CardBuffer(), StockSlot, 0, 0, 0, false, false);
+
+    CardBuffer tableau = makeStack(52, 20);
+    CardBuffer longer = tableau;
+    longer.append(CardData(SuitSpade, RankAce, true));
+    run("Tableau, add top card", 0, tableau, longer);
+
+    CardBuffer flipped = tableau;
+    flipped.last().show = false;
+    run("Tableau, flip top card", 0, tableau, flipped);
+
+    CardBuffer moved = tableau.mid(0, tableau.count() - 13);
+    run("Tableau, move 13 cards", 0, tableau, moved);
+
+    run("Tableau, no change", 0, tableau, tableau);
+
+    CardBuffer stock = makeStack(104, 0);
+    CardBuffer dealt = stock.mid(0, stock.count() - 10);
+    run("Stock, deal 10 cards", 1, stock, dealt);
+
+    CardBuffer single = stock.mid(0, 1);
+    run("Stock, refill", 1, single, stock);
+
+    return 0;
+}
@@ -0,0 +1,8 @@
+TEMPLATE = app
+TARGET = slotbench
+
+QT = core
+
+include(../../src/engine/engine.pri)
+
+SOURCES = slotbench.cpp
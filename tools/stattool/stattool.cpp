@@ -0,0 +1,108 @@
+/*
+ * Tool for Patience Deck statistics
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <iostream>
+#include <random>
+#include "statistics.h"
+
+namespace {
+    using std::cout;
+    using std::endl;
+
+    const int GameCount = 80;
+
+    void print(const Statistics &statistics)
+    {
+        for (const QString &game : statistics.games()) {
+            auto aggregate = statistics.aggregate(game);
+            cout << qPrintable(game) << ": played " << aggregate.played
+                 << ", won " << aggregate.won << " (" << int(aggregate.winRate() * 100) << "%)"
+                 << ", best streak " << aggregate.bestStreak
+                 << ", best time " << aggregate.bestTime / 1000 << " s"
+                 << ", average moves " << aggregate.averageMoves() << endl;
+        }
+    }
+
+    int benchmark(int count)
+    {
+        QTemporaryDir dir;
+        Statistics statistics(dir.path());
+        std::mt19937 generator(42);
+        std::uniform_int_distribution<int> game(0, GameCount - 1);
+        std::bernoulli_distribution won(0.3);
+        std::uniform_int_distribution<int> time(30 * 1000, 30 * 60 * 1000);
+        std::uniform_int_distribution<int> moves(20, 400);
+
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < count; i++) {
+            statistics.record(QStringLiteral("game-%1.scm").arg(game(generator)),
+                              generator(), won(generator), time(generator), moves(generator));
+        }
+        qint64 elapsed = timer.nsecsElapsed();
+        cout << "Recorded " << count << " games in " << elapsed / 1000000 << " ms, "
+             << elapsed / count / 1000 << " us per game" << endl;
+
+        timer.restart();
+        quint64 played = 0;
+        for (int i = 0; i < count; i++)
+            played += statistics.aggregate(QStringLiteral("game-%1.scm").arg(i % GameCount)).played;
+        elapsed = timer.nsecsElapsed();
+        cout << "Read " << count << " aggregates in " << elapsed / 1000000 << " ms, "
+             << elapsed / count << " ns per read" << endl;
+        if (played == 0)
+            return 1;
+
+        timer.restart();
+        if (!statistics.rebuild())
+            return 1;
+        cout << "Rebuilt statistics in " << timer.elapsed() << " ms" << endl;
+        return 0;
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Inspect, rebuild or benchmark Patience Deck statistics.");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"rebuild", "Rebuild statistics from their log"},
+        {"benchmark", "Benchmark recording the given number of games", "count"},
+    });
+    parser.addPositionalArgument("directory", "Directory with statistics");
+    parser.process(app);
+
+    if (parser.isSet("benchmark"))
+        return benchmark(qMax(1, parser.value("benchmark").toInt()));
+
+    if (parser.positionalArguments().isEmpty())
+        parser.showHelp(1);
+
+    Statistics statistics(parser.positionalArguments().first());
+    if (parser.isSet("rebuild") && !statistics.rebuild()) {
+        cout << "Failed to rebuild " << qPrintable(statistics.path()) << endl;
+        return 1;
+    }
+    print(statistics);
+    return 0;
+}
@@ -0,0 +1,8 @@
+TEMPLATE = app
+TARGET = stattool
+
+QT = core
+
+include(../../src/engine/engine.pri)
+
+SOURCES = stattool.cpp
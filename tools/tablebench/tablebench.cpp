@@ -0,0 +1,416 @@
+/*
+ * Benchmark for drawing cards on Patience Deck table
+
+ * Copyright (C) 2023 Tomi Leppänen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QImage>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QPainter>
+#include <QQuickItem>
+#include <QQuickWindow>
+#include <QSGSimpleRectNode>
+#include <QSGSimpleTextureNode>
+#include <QSurfaceFormat>
+#include <atomic>
+#include <iostream>
+#include "cardbatch.h"
+
+namespace {
+    using std::cout;
+    using std::endl;
+
+    const QSize CardSize(79, 123);
+    const int Columns = 13;
+    const int Rows = 5;
+    const int WarmupFrames = 30;
+    const int TableauColumns = 8;
+    const QColor HighlightColor(0, 0, 255, 64);
+    const QColor CheckSheetColor(51, 51, 51);
+    const QVector<QColor> CardColors = { Qt::darkBlue, Qt::darkGreen, Qt::darkYellow, Qt::darkRed, Qt::black };
+    const int CheckTolerance = 3;
+
+    // Card faces in the upper half and the color mask in the lower half like in Table
+    QImage makeTexture()
+    {
+        QImage image(CardSize.width() * Columns, CardSize.height() * Rows * 2, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        for (int row = 0; row < Rows; row++) {
+            for (int column = 0; column < Columns; column++) {
+                QRect rect(QPoint(column * CardSize.width(), row * CardSize.height()), CardSize);
+                painter.fillRect(rect.adjusted(1, 1, -1, -1), Qt::white);
+                painter.fillRect(rect.adjusted(8, 8, -8, -8).translated(0, Rows * CardSize.height()), Qt::black);
+            }
+        }
+        return image;
+    }
+
+    // Dark grey sheet for every color class with the mask inset from the edges
+    QImage makeCheckTexture()
+    {
+        QImage image(CardSize.width() * CardBatchNode::ColorCount, CardSize.height() * 2, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        for (int column = 0; column < CardBatchNode::ColorCount; column++) {
+            QRect rect(QPoint(column * CardSize.width(), 0), CardSize);
+            painter.fillRect(rect, CheckSheetColor);
+            painter.fillRect(rect.adjusted(8, 8, -8, -8).translated(0, CardSize.height()), Qt::black);
+        }
+        return image;
+    }
+
+    // Owns the texture shared by the card nodes below it
+    class TextureNode : public QSGNode
+    {
+    public:
+        explicit TextureNode(QSGTexture *texture) : texture(texture) {}
+        ~TextureNode() { delete texture; }
+
+        QSGTexture *texture;
+    };
+
+    /*
+     * Draws cards either with one texture node and an optional highlight node
+     * per card, like cards painted themselves, or with one CardBatchNode like
+     * Table does. Cards move on every frame, so their geometry is updated
+     * every time like during animations.
+     */
+    class Cards : public QQuickItem
+    {
+    public:
+        Cards(bool batched, int count, int highlightInterval, QQuickItem *parent)
+            : QQuickItem(parent)
+            , m_batched(batched)
+            , m_count(count)
+            , m_highlightInterval(highlightInterval)
+            , m_frame(0)
+            , m_nodes(0)
+            , m_syncTime(0)
+            , m_image(makeTexture())
+        {
+            setFlag(QQuickItem::ItemHasContents);
+        }
+
+        void advance()
+        {
+            m_frame++;
+            update();
+        }
+
+        int nodes() const
+        {
+            return m_nodes;
+        }
+
+        // Time spent in updatePaintNode in nanoseconds
+        qint64 takeSyncTime()
+        {
+            return m_syncTime.exchange(0);
+        }
+
+        QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *) override
+        {
+            QElapsedTimer timer;
+            timer.start();
+
+            auto *node = static_cast<TextureNode *>(oldNode);
+            if (!node)
+                node = new TextureNode(window()->createTextureFromImage(m_image));
+            if (m_batched)
+                updateBatch(node);
+            else
+                updateNodes(node);
+
+            m_syncTime += timer.nsecsElapsed();
+            return node;
+        }
+
+    private:
+        QRectF cardRect(int index) const
+        {
+            int column = index % TableauColumns;
+            int row = index / TableauColumns;
+            qreal offset = m_frame % 60;
+            return QRectF(column * (CardSize.width() + 10) + offset, row * CardSize.height() / 4 + offset,
+                          CardSize.width(), CardSize.height());
+        }
+
+        QRect sourceRect(int index) const
+        {
+            int column = index % Columns;
+            int row = index / Columns % Rows;
+            return QRect(QPoint(column * CardSize.width(), row * CardSize.height()), CardSize);
+        }
+
+        bool highlighted(int index) const
+        {
+            return m_highlightInterval > 0 && index % m_highlightInterval == 0;
+        }
+
+        void updateNodes(TextureNode *node)
+        {
+            if (!node->firstChild()) {
+                for (int i = 0; i < m_count; i++) {
+                    auto *card = new QSGSimpleTextureNode();
+                    card->setTexture(node->texture);
+                    card->setSourceRect(sourceRect(i));
+                    card->setFlag(QSGNode::OwnedByParent);
+                    node->appendChildNode(card);
+                    m_nodes++;
+                }
+            }
+            int i = 0;
+            for (QSGNode *child = node->firstChild(); child; child = child->nextSibling(), i++) {
+                auto *card = static_cast<QSGSimpleTextureNode *>(child);
+                QRectF rect = cardRect(i);
+                card->setRect(rect);
+                // Highlight toggles on every other frame like when dragging over slots
+                bool highlight = highlighted(i) && m_frame % 2;
+                if (highlight && card->childCount() == 0) {
+                    auto *highlightNode = new QSGSimpleRectNode(rect, HighlightColor);
+                    highlightNode->setFlag(QSGNode::OwnedByParent);
+                    card->appendChildNode(highlightNode);
+                    m_nodes++;
+                } else if (!highlight && card->childCount() > 0) {
+                    card->removeAllChildNodes();
+                    m_nodes--;
+                } else if (highlight) {
+                    static_cast<QSGSimpleRectNode *>(card->firstChild())->setRect(rect);
+                }
+            }
+        }
+
+        void updateBatch(TextureNode *node)
+        {
+            auto *batch = static_cast<CardBatchNode *>(node->firstChild());
+            if (!batch) {
+                batch = new CardBatchNode();
+                batch->setFlag(QSGNode::OwnedByParent);
+                batch->setTexture(node->texture);
+                batch->setColors(CardColors);
+                node->appendChildNode(batch);
+                m_nodes = 1;
+            }
+            batch->setCount(m_count);
+            for (int i = 0; i < m_count; i++) {
+                bool highlight = highlighted(i) && m_frame % 2;
+                batch->setCard(i, cardRect(i), sourceRect(i), i / Columns % Rows,
+                               highlight ? HighlightColor : QColor(Qt::transparent));
+            }
+            batch->commit();
+        }
+
+        const bool m_batched;
+        const int m_count;
+        const int m_highlightInterval;
+        int m_frame;
+        std::atomic<int> m_nodes;
+        std::atomic<qint64> m_syncTime;
+        QImage m_image;
+    };
+
+    /*
+     * Draws one card of every color class and one tinted card with
+     * CardBatchNode to check the result of its shader. The last card uses
+     * the first color class.
+     */
+    class CheckCards : public QQuickItem
+    {
+    public:
+        explicit CheckCards(QQuickItem *parent)
+            : QQuickItem(parent)
+            , m_image(makeCheckTexture())
+        {
+            setFlag(QQuickItem::ItemHasContents);
+        }
+
+        static int count()
+        {
+            return CardBatchNode::ColorCount + 1;
+        }
+
+        static int colorClass(int index)
+        {
+            return index % CardBatchNode::ColorCount;
+        }
+
+        static QColor tint(int index)
+        {
+            return index == CardBatchNode::ColorCount ? HighlightColor : QColor(Qt::transparent);
+        }
+
+        static QRect cardRect(int index)
+        {
+            return QRect(QPoint(10 + index * (CardSize.width() + 10), 10), CardSize);
+        }
+
+        QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *) override
+        {
+            if (oldNode)
+                return oldNode;
+            auto *node = new TextureNode(window()->createTextureFromImage(m_image));
+            auto *batch = new CardBatchNode();
+            batch->setFlag(QSGNode::OwnedByParent);
+            batch->setTexture(node->texture);
+            batch->setColors(CardColors);
+            batch->setCount(count());
+            for (int i = 0; i < count(); i++) {
+                QRect source(QPoint(colorClass(i) * CardSize.width(), 0), CardSize);
+                batch->setCard(i, cardRect(i), source, colorClass(i), tint(i));
+            }
+            batch->commit();
+            node->appendChildNode(batch);
+            return node;
+        }
+
+    private:
+        QImage m_image;
+    };
+
+    // Same blending as the shader: card color over the sheet, then the tint
+    QColor expectedColor(int index, bool masked)
+    {
+        QColor tint = CheckCards::tint(index);
+        QColor color = CardColors[CheckCards::colorClass(index)];
+        qreal sheet[] = { CheckSheetColor.redF(), CheckSheetColor.greenF(), CheckSheetColor.blueF() };
+        qreal card[] = { color.redF(), color.greenF(), color.blueF() };
+        qreal tinted[] = { tint.redF(), tint.greenF(), tint.blueF() };
+        qreal channels[3];
+        for (int i = 0; i < 3; i++) {
+            qreal value = sheet[i] + (masked ? card[i] : 0);
+            channels[i] = qBound(0.0, value * (1 - tint.alphaF()) + tinted[i] * tint.alphaF(), 1.0);
+        }
+        return QColor::fromRgbF(channels[0], channels[1], channels[2]);
+    }
+
+    bool closeTo(const QColor &a, const QColor &b)
+    {
+        return qAbs(a.red() - b.red()) <= CheckTolerance
+            && qAbs(a.green() - b.green()) <= CheckTolerance
+            && qAbs(a.blue() - b.blue()) <= CheckTolerance;
+    }
+
+    // Compares the center of every card, where the mask is, and a point near its edge
+    int checkImage(const QImage &image)
+    {
+        int failures = 0;
+        for (int i = 0; i < CheckCards::count(); i++) {
+            QRect rect = CheckCards::cardRect(i);
+            const QPoint points[] = { rect.center(), rect.topLeft() + QPoint(3, 3) };
+            for (const QPoint &point : points) {
+                bool masked = point == rect.center();
+                QColor expected = expectedColor(i, masked);
+                QColor actual = image.pixelColor(point);
+                if (!closeTo(actual, expected)) {
+                    qWarning() << "Card" << i << (masked ? "center" : "edge") << "is" << actual.name()
+                               << "instead of" << expected.name();
+                    failures++;
+                }
+            }
+        }
+        return failures;
+    }
+} // namespace
+
+/*
+ * With --check cards of every color class are drawn once and compared with
+ * the expected colors. Run it with LIBGL_ALWAYS_SOFTWARE=1 to check that
+ * the card batch shader works with Mesa software GL.
+ */
+int main(int argc, char *argv[])
+{
+    // Measure how long frames take instead of waiting for vertical sync
+    QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+    format.setSwapInterval(0);
+    QSurfaceFormat::setDefaultFormat(format);
+
+    QGuiApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOptions({
+        {{"c", "cards"}, "Number of cards on the table", "count", "104"},
+        {{"f", "frames"}, "Number of frames to measure", "count", "500"},
+        {{"i", "highlight"}, "Highlight every nth card, 0 for none", "interval", "8"},
+        {"check", "Check colors drawn by the card batch shader instead of measuring"},
+    });
+    parser.process(app);
+
+    if (parser.isSet("check")) {
+        QQuickWindow window;
+        window.resize(1024, 768);
+        new CheckCards(window.contentItem());
+        QByteArray renderer;
+        QObject::connect(&window, &QQuickWindow::sceneGraphInitialized, &window, [&] {
+            renderer = reinterpret_cast<const char *>(QOpenGLContext::currentContext()->functions()->glGetString(GL_RENDERER));
+        }, Qt::DirectConnection);
+        bool checked = false;
+        QObject::connect(&window, &QQuickWindow::frameSwapped, &window, [&] {
+            if (checked)
+                return;
+            checked = true;
+            QImage image = window.grabWindow().convertToFormat(QImage::Format_RGB32);
+            int failures = checkImage(image);
+            cout << renderer.constData() << ": " << (failures ? "failed" : "passed")
+                 << ", " << failures << " wrong pixels" << endl;
+            app.exit(failures ? 1 : 0);
+        }, Qt::QueuedConnection);
+        window.show();
+        return app.exec();
+    }
+
+    int count = qMax(parser.value("cards").toInt(), 1);
+    int frames = qMax(parser.value("frames").toInt(), 1);
+    int highlightInterval = parser.value("highlight").toInt();
+
+    QQuickWindow window;
+    window.resize(1024, 768);
+
+    bool batched = false;
+    int frame = 0;
+    QElapsedTimer timer;
+    Cards *cards = new Cards(batched, count, highlightInterval, window.contentItem());
+
+    QObject::connect(&window, &QQuickWindow::frameSwapped, &window, [&] {
+        frame++;
+        if (frame == WarmupFrames) {
+            cards->takeSyncTime();
+            timer.start();
+        } else if (frame == WarmupFrames + frames) {
+            qint64 elapsed = timer.nsecsElapsed();
+            cout << (batched ? "batch node" : "node per card") << ", " << count << " cards: "
+                 << cards->nodes() << " nodes, "
+                 << elapsed / frames / 1000.0 << " µs per frame, "
+                 << cards->takeSyncTime() / frames / 1000.0 << " µs per sync" << endl;
+            delete cards;
+            if (batched) {
+                app.quit();
+                return;
+            }
+            batched = true;
+            frame = 0;
+            cards = new Cards(batched, count, highlightInterval, window.contentItem());
+        }
+        cards->advance();
+    }, Qt::QueuedConnection);
+
+    window.show();
+    return app.exec();
+}
@@ -0,0 +1,11 @@
+TEMPLATE = app
+TARGET = tablebench
+
+QT = core gui quick
+
+include(../../src/engine/engine.pri)
+
+INCLUDEPATH += ../../src/table
+
+HEADERS = ../../src/table/cardbatch.h
+SOURCES = tablebench.cpp ../../src/table/cardbatch.cpp
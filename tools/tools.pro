@@ -0,0 +1,13 @@
+TEMPLATE = subdirs
+SUBDIRS = archivetest engine exerciser itertest journaltest queuebench queuetest renderbench replaytest slotbench stattool tablebench
+engine.subdir = ../src/engine
+archivetest.depends = engine
+exerciser.depends = engine
+journaltest.depends = engine
+queuebench.depends = engine
+queuetest.depends = engine
+renderbench.depends = engine
+replaytest.depends = engine
+slotbench.depends = engine
+stattool.depends = engine
+tablebench.depends = engine